@@ -0,0 +1,267 @@
+/**
+ * @file AnalyzerMain.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+/*
+ * MidiChordsAnalyzer: run the chord naming over a pile of MIDI files without a DAW.
+ *
+ *   MidiChordsAnalyzer [options] <file or folder> ...
+ *
+ *   --format json|csv     what to write (json is the default)
+ *   --out <folder>        where to write (default: next to each MIDI file)
+ *   --threads <n>         how many files to work on at once (default: one per core)
+ *   --threshold <sec>     short chord threshold (default: the plugin's default)
+ *   --arpeggio <sec>      broken chord window (default: off)
+ *   --spell-by-key        spell the chords for the key
+ *   --no-output           just analyze and report the timing (for measuring)
+ *   --repeat <n>          do everything n times (for measuring)
+ *
+ * Folders are searched (recursively) for .mid and .midi files. Each file gets its own MidiStore, so a bad
+ * file only fails itself. The output for song.mid is song.chords.json (or .csv); with --out, the path of the
+ * file under the folder it was found in is kept so songs with the same name don't clobber each other.
+ *
+ * Since it is the same code that the plugin uses to build its view, this also makes for a repeatable way to
+ * measure that code outside of a DAW.
+ */
+
+#include <juce_core/juce_core.h>
+#include <iostream>
+#include <limits>
+#include "MidiStore.h"
+#include "MidiFileImporter.h"
+#include "ChordTimelineWriter.h"
+#include "WorkerPool.h"
+
+using namespace juce;
+using namespace std;
+
+
+struct AnalyzerOptions
+{
+    bool csv = false;
+    File outputFolder;
+    int threads = SystemStats::getNumCpus();
+    optional<float> threshold;
+    float arpeggioWindow = 0.0f;
+    bool spellByKey = false;
+    bool writeOutput = true;
+    int repeat = 1;
+};
+
+struct InputFile
+{
+    File file;
+    // the folder it was found in (the file itself when it was given directly)
+    File root;
+};
+
+struct FileResult
+{
+    bool ok = false;
+    String error;
+    size_t events = 0;
+    size_t chords = 0;
+};
+
+
+static void printUsage()
+{
+    cerr << "usage: MidiChordsAnalyzer [--format json|csv] [--out <folder>] [--threads <n>] [--threshold <sec>]\n"
+            "                          [--arpeggio <sec>] [--spell-by-key] [--no-output] [--repeat <n>]\n"
+            "                          <file or folder> ...\n";
+}
+
+
+/**
+ * @brief Where the chords for a file go
+ *
+ * @param input
+ * @param options
+ * @return File
+ */
+static File getOutputFile(const InputFile &input, const AnalyzerOptions &options)
+{
+    String name = input.file.getFileNameWithoutExtension() + (options.csv ? ".chords.csv" : ".chords.json");
+    if (options.outputFolder == File())
+        return input.file.getSiblingFile(name);
+
+    File folder = options.outputFolder;
+    if (input.root.isDirectory())
+        folder = folder.getChildFile(input.file.getParentDirectory().getRelativePathFrom(input.root));
+    return folder.getChildFile(name);
+}
+
+
+/**
+ * @brief Import, name and write one file. Nothing is shared with any of the other files.
+ *
+ * @param input
+ * @param options
+ * @return FileResult
+ */
+static FileResult analyzeFile(const InputFile &input, const AnalyzerOptions &options)
+{
+    FileResult result;
+    try
+    {
+        MidiStore store;
+        if (options.threshold.has_value())
+            store.setShortChordThreshold(*options.threshold);
+        store.setArpeggioWindow(options.arpeggioWindow);
+        store.setSpellChordsByKey(options.spellByKey);
+
+        if (!MidiFileImporter::importFile(input.file, store, result.error))
+            return result;
+
+        store.updateStaticView();
+        vector<pair<float, string>> chords = store.getChordsInWindow({0.0f, numeric_limits<float>::max()});
+        result.events = store.getEventTimes().size();
+        result.chords = chords.size();
+
+        if (options.writeOutput)
+        {
+            File output = getOutputFile(input, options);
+            output.getParentDirectory().createDirectory();
+            String text = options.csv ? ChordTimelineWriter::toCsv(chords)
+                                      : ChordTimelineWriter::toJson(store.getName(), chords);
+            if (!output.replaceWithText(text))
+            {
+                result.error = "cannot write " + output.getFullPathName();
+                return result;
+            }
+        }
+        result.ok = true;
+    }
+    catch (const exception &e)
+    {
+        result.error = e.what();
+    }
+    catch (...)
+    {
+        result.error = "unknown error";
+    }
+    return result;
+}
+
+
+/**
+ * @brief Pick up the options and the list of MIDI files from the command line
+ *
+ * @param args
+ * @param options
+ * @param inputs
+ * @return bool      false if the command line doesn't make sense
+ */
+static bool parseArguments(const StringArray &args, AnalyzerOptions &options, vector<InputFile> &inputs)
+{
+    for (int i = 0; i < args.size(); i++)
+    {
+        String arg = args[i];
+        bool hasValue = i + 1 < args.size();
+        if (arg == "--format" && hasValue)
+        {
+            String format = args[++i];
+            if (format != "json" && format != "csv")
+                return false;
+            options.csv = format == "csv";
+        }
+        else if (arg == "--out" && hasValue)
+            options.outputFolder = File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        else if (arg == "--threads" && hasValue)
+            options.threads = jmax(1, args[++i].getIntValue());
+        else if (arg == "--threshold" && hasValue)
+            options.threshold = args[++i].getFloatValue();
+        else if (arg == "--arpeggio" && hasValue)
+            options.arpeggioWindow = args[++i].getFloatValue();
+        else if (arg == "--spell-by-key")
+            options.spellByKey = true;
+        else if (arg == "--no-output")
+            options.writeOutput = false;
+        else if (arg == "--repeat" && hasValue)
+            options.repeat = jmax(1, args[++i].getIntValue());
+        else if (arg.startsWith("-"))
+            return false;
+        else
+        {
+            File path = File::getCurrentWorkingDirectory().getChildFile(arg);
+            if (path.isDirectory())
+            {
+                Array<File> found = path.findChildFiles(File::findFiles, true, "*.mid;*.midi");
+                found.sort();
+                for (const File &file : found)
+                    inputs.push_back({file, path});
+            }
+            else if (path.existsAsFile())
+                inputs.push_back({path, path});
+            else
+            {
+                cerr << "not found: " << arg << "\n";
+                return false;
+            }
+        }
+    }
+    return !inputs.empty();
+}
+
+
+int main(int argc, char *argv[])
+{
+    StringArray args;
+    for (int i = 1; i < argc; i++)
+        args.add(String::fromUTF8(argv[i]));
+
+    AnalyzerOptions options;
+    vector<InputFile> inputs;
+    if (!parseArguments(args, options, inputs))
+    {
+        printUsage();
+        return 2;
+    }
+
+    // The files are spread over the pool (plus this thread). Each one is built with a single thread; with
+    // lots of files that keeps every core busy without the overhead of splitting up each view.
+    WorkerPool pool(jmax(1, options.threads - 1));
+    vector<FileResult> results(inputs.size());
+    CriticalSection outputLock;
+
+    double start = Time::getMillisecondCounterHiRes();
+    for (int pass = 0; pass < options.repeat; pass++)
+    {
+        pool.parallelFor(static_cast<int>(inputs.size()), [&](int index)
+        {
+            size_t i = static_cast<size_t>(index);
+            results[i] = analyzeFile(inputs[i], options);
+            if (!results[i].ok)
+            {
+                const ScopedLock lock(outputLock);
+                cerr << inputs[i].file.getFullPathName() << ": " << results[i].error << "\n";
+            }
+        }, options.threads);
+    }
+    double elapsed = (Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+    size_t failed = 0;
+    size_t events = 0;
+    size_t chords = 0;
+    for (const FileResult &result : results)
+    {
+        failed += result.ok ? 0 : 1;
+        events += result.events;
+        chords += result.chords;
+    }
+
+    double files = static_cast<double>(inputs.size()) * options.repeat;
+    cout << inputs.size() << " files (" << failed << " failed), " << events << " events, " << chords
+         << " chords" << (options.repeat > 1 ? " x " + String(options.repeat) : String()) << "\n";
+    cout << String(elapsed, 3) << " s on " << options.threads << " threads: "
+         << String(files / jmax(elapsed, 1.0e-9), 1) << " files/sec, "
+         << static_cast<int64>(static_cast<double>(events) * options.repeat / jmax(elapsed, 1.0e-9)) << " events/sec\n";
+
+    return failed == 0 ? 0 : 1;
+}
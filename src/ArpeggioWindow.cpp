@@ -0,0 +1,83 @@
+/**
+ * @file ArpeggioWindow.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "ArpeggioWindow.h"
+
+using namespace std;
+
+
+/**
+ * @brief Construct a new arpeggio window
+ *
+ * @param window   how far back a note start still counts (same units as the event positions)
+ */
+ArpeggioWindow::ArpeggioWindow(double window) : windowLength(window), onsets(maxOnsets)
+{
+}
+
+
+/**
+ * @brief Forget all of the recent notes
+ */
+void ArpeggioWindow::reset()
+{
+    firstOnset = 0;
+    onsetCount = 0;
+    counts.fill(0);
+    recent.clear();
+    previousOn.clear();
+    lastPosition = 0.0;
+}
+
+
+/**
+ * @brief Feed the next event through and get the notes that make up the chord at that point
+ *
+ * @param position   time (or beat) of the event. Events are expected in order; going backwards starts over
+ * @param notesOn    the notes that are on as of this event
+ * @return NoteSet   the notes that are on plus the ones that started within the window
+ */
+NoteSet ArpeggioWindow::addEvent(double position, const NoteSet &notesOn)
+{
+    if (position < lastPosition)
+        reset();
+    lastPosition = position;
+
+    // Anything that is on now but wasn't at the last event just started
+    for (int note : notesOn - previousOn)
+    {
+        if (onsetCount == maxOnsets)
+            dropOnset();
+        onsets[(firstOnset + onsetCount) % maxOnsets] = {position, note};
+        onsetCount++;
+        if (counts[static_cast<size_t>(note)]++ == 0)
+            recent.add(note);
+    }
+    previousOn = notesOn;
+
+    while (onsetCount > 0 && onsets[firstOnset].position <= position - windowLength)
+        dropOnset();
+
+    return notesOn | recent;
+}
+
+
+/**
+ * @private
+ * @brief Expire the oldest note start
+ */
+void ArpeggioWindow::dropOnset()
+{
+    int note = onsets[firstOnset].note;
+    if (--counts[static_cast<size_t>(note)] == 0)
+        recent.remove(note);
+    firstOnset = (firstOnset + 1) % maxOnsets;
+    onsetCount--;
+}
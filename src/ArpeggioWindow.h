@@ -0,0 +1,63 @@
+/**
+ * @file ArpeggioWindow.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "NoteSet.h"
+
+using namespace std;
+
+
+/**
+ * @brief Collect the notes of an arpeggio (or any broken chord) so they can be named as one chord.
+ * @details
+ * Normally the chord at an event is just the notes that are on at that moment. With a broken chord there is
+ * only ever one note on, so every note shows up as its own "chord". This keeps every note that started within
+ * a window (of seconds or beats; it doesn't care which) before the event and adds those to the notes that are
+ * still held down.
+ *
+ * The recent note starts are in a ring buffer along with a count per note of how many of them are still in
+ * the window. Each start is added once and expires once, so feeding an event through is a constant amount of
+ * work no matter how dense the arpeggio is or how long the song is.
+ */
+class ArpeggioWindow
+{
+public:
+    ArpeggioWindow(double window);
+
+    NoteSet addEvent(double position, const NoteSet &notesOn);
+    void reset();
+
+private:
+    struct Onset
+    {
+        double position;
+        int note;
+    };
+
+    // room for this many note starts in the window; if it fills up, the oldest ones go early
+    static constexpr size_t maxOnsets = 1024;
+
+    double windowLength;
+    vector<Onset> onsets;
+    size_t firstOnset = 0;
+    size_t onsetCount = 0;
+    // number of starts of each note that are still in the window
+    array<uint16_t, 128> counts {};
+    // the notes with a non-zero count
+    NoteSet recent;
+    NoteSet previousOn;
+    double lastPosition = 0.0;
+
+    void dropOnset();
+};
@@ -0,0 +1,108 @@
+/**
+ * @file ChordChangeFilter.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "ChordChangeFilter.h"
+#include <algorithm>
+
+using namespace std;
+
+
+/**
+ * @brief Construct a new chord change filter
+ *
+ * @param threshold   chords shorter than this (in seconds) are dropped
+ * @param output      the chords that are kept get added to the end of this
+ */
+ChordChangeFilter::ChordChangeFilter(float threshold, ChordVectorType &output) : minLength(threshold), kept(output)
+{
+}
+
+
+/**
+ * @brief The next chord change
+ *
+ * @param time   start of the chord (seconds)
+ * @param name
+ */
+void ChordChangeFilter::add(float time, const string &name)
+{
+    if (!started)
+    {
+        // the very first one is always kept
+        kept.push_back({time, name});
+        started = true;
+        return;
+    }
+
+    if (hasPending)
+    {
+        if (time - pending.first >= minLength)
+        {
+            // long enough
+            kept.push_back(std::move(pending));
+        }
+        else
+        {
+            // Too short, so the pending one goes away. If this one is the same as the chord before that,
+            // then it is really just the continuation of it.
+            hasPending = false;
+            if (kept.back().second == name)
+                return;
+        }
+    }
+    pending = {time, name};
+    hasPending = true;
+}
+
+
+/**
+ * @brief Let the filter know that the time has moved along with no new chord (e.g., the last of the recorded
+ * notes is at this time). If the pending chord has already lasted long enough, it is kept now rather than
+ * waiting for the next change. The chords that are added after this can't start before this time.
+ *
+ * @param time
+ */
+void ChordChangeFilter::advanceTo(float time)
+{
+    advancedTo = std::max(advancedTo, time);
+    if (hasPending && advancedTo - pending.first >= minLength)
+    {
+        kept.push_back(std::move(pending));
+        hasPending = false;
+    }
+}
+
+
+/**
+ * @brief No more chords are coming. The last one is kept no matter how short it is.
+ */
+void ChordChangeFilter::finish()
+{
+    if (hasPending)
+    {
+        kept.push_back(std::move(pending));
+        hasPending = false;
+    }
+}
+
+
+/**
+ * @brief Start over (with an empty output) with a new threshold
+ *
+ * @param threshold   chords shorter than this (in seconds) are dropped
+ */
+void ChordChangeFilter::restart(float threshold)
+{
+    minLength = threshold;
+    kept.clear();
+    hasPending = false;
+    started = false;
+    advancedTo = -numeric_limits<float>::infinity();
+}
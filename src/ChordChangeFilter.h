@@ -0,0 +1,65 @@
+/**
+ * @file ChordChangeFilter.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MidiChordsTypes.h"
+
+using namespace std;
+
+
+/**
+ * @brief Drop the "short" chords (passing notes and the like) from a stream of chord changes as they arrive.
+ * @details
+ * Chord changes go in one at a time, in time order. A chord can't be kept until it is known that it lasts at
+ * least the threshold, so the most recent one waits (it is "pending") until either the next change arrives
+ * or the time moves past its start plus the threshold (advanceTo). That is the only lookahead there is, and
+ * every change is dealt with once, when it arrives.
+ *
+ * MidiStore keeps one of these from one view update to the next, so while recording only the chords that
+ * are new go through it (see MidiStore::updateStaticView). The chords so far are the kept ones plus the
+ * pending one, if there is one; that's the same as what finish would give.
+ *
+ * The rules (the same as the original removeShortChords that went back over the whole view):
+ * - The first chord is always kept, and so is the last one (see finish)
+ * - A chord is kept if the next change is at least the threshold after it
+ * - Otherwise it is dropped, and if the chord after it is the same as the last kept chord, that one is
+ *   dropped too (the two pieces of the same chord are joined back into one)
+ *
+ * The kept chords are appended to the output vector given to the constructor.
+ */
+class ChordChangeFilter
+{
+public:
+    ChordChangeFilter(float threshold, ChordVectorType &output);
+
+    void add(float time, const string &name);
+    void advanceTo(float time);
+    void finish();
+    void restart(float threshold);
+
+    float getThreshold() const { return minLength; }
+    // The latest time given to advanceTo (the next chord can't be before this)
+    float getTime() const { return advancedTo; }
+    // The most recent chord that is still waiting to see if it is long enough (nullptr if there isn't one)
+    const pair<float, string> *getPending() const { return hasPending ? &pending : nullptr; }
+
+private:
+    float minLength;
+    ChordVectorType &kept;
+    pair<float, string> pending;
+    bool hasPending = false;
+    bool started = false;
+    float advancedTo = -numeric_limits<float>::infinity();
+};
@@ -11,10 +11,11 @@
 #include "ChordName.h"
 #include "ChordClipper.h"
 #include "MidiChordsTypes.h"
+#include <algorithm>
 
 using namespace std;
 
-ChordClipper::ChordClipper(MidiStore &ms) : midiState(ms)
+ChordClipper::ChordClipper(MidiStore &ms, PlayheadEstimator::Clock clock) : midiState(ms), playhead(std::move(clock))
 {
 }
 
@@ -27,31 +28,17 @@ ChordClipper::ChordClipper(MidiStore &ms) : midiState(ms)
  */
 void ChordClipper::updateCurrentPosition(int msSinceLastUpdate)
 {
-    // If we have an update that represents the "true" position, then use that. This gets set during
-    // callbacks by the plugin processor. This can happen during playback when it sends the next
-    // bit of playback info to us. But even outside of playback, a click in the track by the user to
-    // move the playhead position results in a call ... sometimes. That is cool because it keeps
-    // the window up to date with respect to what the user is looking at in the track. But I notice
-    // that it does not always update if the track that this plugin is on is not the current one.
-    float lastSeenPosition = static_cast<float>(midiState.getLastEventTimeInSeconds());
-    if (lastSeenPosition != this->mostRecentPlayPosition)
-    {
-        // We have new position info from the DAW. Use it
-        this->mostRecentPlayPosition = lastSeenPosition;
-        this->estimatedPlayPosition = lastSeenPosition;
-    }
-    else
-    {
-        // We do not have new "official" position info, so just keep moving the window along based on
-        // the amount of elapsed time. If we are not currently in playback, then don't change the position.
-        if (midiState.getIsPlaying())
-        {
-            // This is not an atomic add ... but this method is the only one updating this value and I *assume* (yeah yeah) that
-            // update() would not be called concurrently on multiple threads. Worst case is the read and add would be out of
-            // sync and basically reset it to an older value. Next time an actual playhead event occurs, it would be fixed.
-            this->estimatedPlayPosition = this->estimatedPlayPosition + static_cast<float>(msSinceLastUpdate / 1000.0);
-        }
-    }
+    // The "true" position comes from the plugin processor with every audio block. This can happen during
+    // playback when it sends the next bit of playback info to us. But even outside of playback, a click in
+    // the track by the user to move the playhead position results in a call ... sometimes. That is cool
+    // because it keeps the window up to date with respect to what the user is looking at in the track. But
+    // I notice that it does not always update if the track that this plugin is on is not the current one.
+    // In between blocks, the estimator keeps the window moving along smoothly (see PlayheadEstimator).
+    //
+    // This is not an atomic update ... but this method is the only one updating this value and I *assume* (yeah yeah) that
+    // update() would not be called concurrently on multiple threads.
+    double position = this->playhead.update(midiState.getTransport(), msSinceLastUpdate / 1000.0);
+    this->estimatedPlayPosition = static_cast<float>(position);
 }
 
 /**
@@ -70,190 +57,173 @@ void ChordClipper::scrollWheelNudge(float deltaX)
         float width = this->getViewWidthInSeconds();
         float currentPos = this->estimatedPlayPosition;
         this->estimatedPlayPosition = currentPos + deltaX * width;
+        this->playhead.moveTo(this->estimatedPlayPosition);
     }
 
 }
 
 /**
  * @brief Retrieve the measures (bar positions)
+ * @details
+ * The bar lines come from the tempo and time signature map the processor captured during playback, so they
+ * stay right across tempo and meter changes. The cost per paint is a binary search plus the visible bars.
+ * Until something has been captured, the current tempo and time signature are assumed to hold from the
+ * start of the song (which was all this used to do).
  * 
  * @return vector<int, float>   Measure numbers and the positions of the vertical bars in 
  *                              seconds (0 is left-most side of window)
  */
-MeasurePositionType ChordClipper::getMeasuresToDisplay()
+const MeasurePositionType &ChordClipper::getMeasuresToDisplay()
 {
-    optional<int> bpMeasure = midiState.getBPMeasure();
-    optional<double> bpMinute = midiState.getBPMinute();
-    MeasurePositionType bars;
+    refreshMeasureGrid(midiState.getTransport());
+    ViewWindowType viewWindow = getViewWindowSize();
+    double left = viewWindow.first;
 
-    if (!bpMeasure || !bpMinute)
-        // one or both of the values is not available (or is zero, which is as good as not available)
-        return {};
+    // These are reused from frame to frame, so once they are big enough there is no allocation
+    measureGrid.getBarsInWindow(left, left + getViewWidthInSeconds(), gridBars);
+    displayedBars.clear();
+    for (auto &bar : gridBars)
+        displayedBars.push_back({bar.first, static_cast<float>(bar.second - left)});
+    return displayedBars;
+}
 
-    // TODO (or at least think about): This gets called every paint refresh and contains several floating
-    // point divisions. Could potentially save the current state in the class and then just update the 
-    // position by time since last update. Or maybe just save the first two values if the bpm and bpm have
-    // not changed ... but maybe I am overthinking it.
-    ViewWindowType viewWindow = getViewWindowSize();
-    float left = viewWindow.first;
+/**
+ * @brief The tempo map for the bar lines (brought up to date first)
+ * 
+ * @return const TempoMap& 
+ */
+const TempoMap &ChordClipper::getMeasureGrid()
+{
+    refreshMeasureGrid(midiState.getTransport());
+    return measureGrid;
+}
 
-    // Compute seconds per measure
-    // compute the measures per minute:
-    double measuresPerMinute = *bpMinute / *bpMeasure;
-    // Now 60 sec/min / (measure/minute) = seconds / measure
-    double secondsPerMeasure = 60.0 / measuresPerMinute;
-    // 0-based measure number is the floor of left side of window divided by Sec/Measure
-    int measureNumber = static_cast<int>(floor(left / secondsPerMeasure));
-    // Elapsed time of left-most displayable measure bar in the view
-    double timeSinceLastBar = left - measureNumber * secondsPerMeasure;
-    double barPos = secondsPerMeasure - timeSinceLastBar;
-    // 1-based (music measures are not numbered in C ... well not that C)
-    // And then add one more if the bar is not at the left of the view window (can't see the number
-    // of the bar that is currently in view ... it is slightly to the left of the view window)
-    measureNumber++;   
-    if (barPos > 0.0)
-        measureNumber++;
+/**
+ * @brief Keep the copy of the tempo map used for the measure grid current. The store's map is only copied
+ * when it changes. The tempo and time signature from the transport are only looked at while the captured
+ * map doesn't have one (a host automating the tempo, or one whose tempo jitters a bit, would otherwise have
+ * this redo the grid, and everything drawn from it, every frame).
+ * 
+ * @param transport 
+ */
+void ChordClipper::refreshMeasureGrid(const TransportSnapshot &transport)
+{
+    int version = midiState.getTempoMapVersion();
+    bool tempoChanged = !capturedMap.hasTempo() && transport.bpm != measureGridBpm;
+    bool meterChanged = !capturedMap.hasMeter() && (transport.timeSigNumerator != measureGridNumerator ||
+                                                    transport.timeSigDenominator != measureGridDenominator);
+    if (version == measureGridVersion && !tempoChanged && !meterChanged)
+        return;
+    if (version != measureGridVersion)
+        capturedMap = midiState.getTempoMap();
+    measureGridVersion = version;
+    measureGridBpm = transport.bpm;
+    measureGridNumerator = transport.timeSigNumerator;
+    measureGridDenominator = transport.timeSigDenominator;
+    measureGridGeneration++;
 
-    double viewWidth = getViewWidthInSeconds();
-    while (barPos < viewWidth)
-    {
-        bars.push_back({measureNumber, static_cast<float>(barPos)});
-        barPos += secondsPerMeasure;
-        measureNumber++;
-    }
-    return bars;
+    // (a copy into the one that's already there, so the fallback changing doesn't allocate once it has room)
+    measureGrid = capturedMap;
+    // Nothing captured (yet): assume the current values from the start of the song. Zero for either value
+    // is as good as not available, and there just won't be any bars.
+    if (!measureGrid.hasTempo())
+        measureGrid.recordTempo(0.0, 0.0, transport.bpm);
+    if (!measureGrid.hasMeter())
+        measureGrid.recordMeter(0.0, transport.timeSigNumerator,
+                                transport.timeSigDenominator > 0 ? transport.timeSigDenominator : 4);
 }
 
 /**
  * @brief Get the set of displayable chords.
  * @details
- * This retrieves the "viewport" of the current window based on the current playhead position.
- * For each of the chords that falls into that window, it puts into a vector of chords where the
- * floating point time in seconds is the time relative to the window. (e.g., where 0 is the left-most
- * side of the window)
+ * This retrieves the "viewport" of the current window based on the current playhead position: the chords
+ * that fall into that window (plus a bit on each side). Their times are the times in the song; subtract the
+ * window start from them to get where they go in the window (e.g., where 0 is the left-most side of it).
+ * This is called every frame, so it doesn't copy anything (see ChordWindow).
  * 
- * @return vector<pair<float, string>>
+ * @param windowStart   set to the time at the left side of the window
+ * @return ChordWindow
  */
-ChordVectorType ChordClipper::getChordsToDisplay() 
+ChordWindow ChordClipper::getChordWindowToDisplay(float &windowStart)
 {
     // Compute the view window for the chords of interest
     pair<float, float> viewWindow = getViewWindowSize();
-    pair<float, float> newWindow;
-    vector<pair<float, string>> chords;
-    vector<pair<float, string>> newChords;
-    float offset = viewWindow.first;
+    windowStart = viewWindow.first;
 
     // include a couple extra seconds on both ends to smooth out display as things to out of view
     // Probably really only need the first extra two seconds
     viewWindow.first -= 2.0f;
     viewWindow.second += 2.0f;
 
-    // Compute the difference in current buffer and new buffer and update it accordingly
-    newWindow = computeNewWindowSize(viewWindow);
-    newChords = midiState.getChordsInWindow(newWindow);
-    constructDisplayedChords(viewWindow, newChords);
-
-    // need to offset the values to the window. If the window is 50 to 70, and we have events
-    // at 55 and 56, then we want to change them to be 5 and 6 respectively (make their offsets
-    // be relative to the window)
-    chords = this->viewBuffer;
-    for (auto &i : chords) 
-        i.first -= offset;
-
-    return chords;
+    updateViewCache(viewWindow);
+    return ChordWindow(viewSnapshot, cacheBegin, cacheEnd);
 }
 
 /**
- * @brief Add in new chords to the existing list (and remove ones that are off the radar)
+ * @brief Get the set of displayable chords with their times relative to the window. If the window is 50 to
+ * 70, and we have events at 55 and 56, then they come back as 5 and 6.
  * 
- * @param viewWindow 
- * @param newChords 
+ * @return vector<pair<float, string>>
  */
-void ChordClipper::constructDisplayedChords(ViewWindowType viewWindow, ChordVectorType newChords)
+ChordVectorType ChordClipper::getChordsToDisplay() 
 {
-    if (!hasForwardOverlap(viewWindow))
-    {
-        this->viewBuffer = newChords;
-    }
-    else
-    {
-        // If any chords have dropped off the front (left side), remove them
-        for (ChordVectorType::iterator it = this->viewBuffer.begin(); it != this->viewBuffer.end(); )
-        {
-            if (it->first < viewWindow.first) 
-            {
-                it = this->viewBuffer.erase(it);
-            }
-            else
-            {
-                // Reached the end of ones to delete
-                break;
-            }
-        }
-
-        /*
-        for (ChordVectorType::iterator it = newChords.begin(); it != newChords.end(); ++it)
-        {
-            DBG("Appending chord to end: " + it->second);
-        }
-        */
-
-        // add the new ones
-        this->viewBuffer.insert(viewBuffer.end(), newChords.begin(), newChords.end());
-    }
-
-    this->viewBufferSize = viewWindow;
+    float offset;
+    ChordWindow window = getChordWindowToDisplay(offset);
+    ChordVectorType chords;
+    for (const auto &chord : window)
+        chords.push_back({chord.first - offset, chord.second});
+    return chords;
 }
 
-
 /**
- * @brief Compute the window size of the "new" window while scrolling forward
+ * @brief Make sure the cached range covers the needed window
+ * @details
+ * The window mostly slides along a little at a time (playback), but it also goes backwards (scroll wheel,
+ * rewinding in the DAW, a loop going back to its start). Since the snapshot never changes, the ends of the
+ * range can just be walked along to the new edges in whichever direction they moved. That only touches the
+ * chords that came into or went out of view. A jump to somewhere that doesn't overlap at all is a binary
+ * search instead.
  * 
- * @param neededWindow     This is the desired end result window
- * @return ViewWindowType 
+ * The store is only asked for anything when it has a new view of the chords (e.g., new ones were recorded).
+ *
+ * @param neededWindow 
  */
-ViewWindowType ChordClipper::computeNewWindowSize(ViewWindowType neededWindow)
+void ChordClipper::updateViewCache(ViewWindowType neededWindow)
 {
-    if (hasForwardOverlap(neededWindow))
+    // Get the version first: if the view changes right after this, the next frame picks it up
+    int viewVersion = midiState.getViewVersion();
+    bool seek = neededWindow.second < cachedWindow.first || neededWindow.first > cachedWindow.second;
+    if (!viewSnapshot || viewVersion != cachedViewVersion)
     {
-        // All we need to retrieve is anything new between the end of our current buffer
-        // and the requested new end
-        return {this->viewBufferSize.second, neededWindow.second};
+        viewSnapshot = midiState.getViewSnapshot();
+        cachedViewVersion = viewVersion;
+        fetchCount++;
+        seek = true;
     }
-    else 
-    {
-        // just do the full thing
-        return neededWindow;
-    }
-}
 
-/**
- * @brief Determine if the new window overlaps the existing window in a forward moving direction
- * 
- * @param neededWindow 
- * @return bool          true if there is overlap of the type we are interested in, false if not
- */
-bool ChordClipper::hasForwardOverlap(ViewWindowType neededWindow)
-{
-    // Optimizing for forward playback. I could handle all possible overlaps and 
-    // compute the clipped parts for front/back of the window. But the one I care about
-    // is to make it efficient during playback; that's the only time it really matters.
-    // So make this as simple as possible: Just handle the case where it has moved
-    // forward and the rear of the needed window falls in the middle of our 
-    // existing buffer and the front is somewhere in front of that.
-    if (neededWindow.first > this->viewBufferSize.first && 
-        neededWindow.second > this->viewBufferSize.second &&
-        neededWindow.first < this->viewBufferSize.second)
+    const ChordTimeline &chords = *viewSnapshot;
+    size_t count = chords.size();
+    if (seek)
     {
-        return true;
+        cacheBegin = chords.lowerBound(neededWindow.first);
+        cacheEnd = cacheBegin;
     }
     else
     {
-        return false;
+        while (cacheBegin != 0 && chords.getTime(cacheBegin - 1) >= neededWindow.first)
+            --cacheBegin;
+        while (cacheBegin != count && chords.getTime(cacheBegin) < neededWindow.first)
+            ++cacheBegin;
+        cacheEnd = max(cacheEnd, cacheBegin);
     }
-
+    while (cacheEnd != count && chords.getTime(cacheEnd) <= neededWindow.second)
+        ++cacheEnd;
+    while (cacheEnd != cacheBegin && chords.getTime(cacheEnd - 1) > neededWindow.second)
+        --cacheEnd;
+    cachedWindow = neededWindow;
 }
 
+
 /**
  * @brief Retrieve the start/end times (in seconds) of the current view port
  * 
@@ -10,6 +10,8 @@
 
 #pragma once
 #include "MidiStore.h"
+#include "ChordWindow.h"
+#include "PlayheadEstimator.h"
 #include "MidiChordsTypes.h"
 
 using namespace std;
@@ -25,30 +27,57 @@ using namespace std;
 class ChordClipper
 {
 public:
-    ChordClipper(MidiStore&);
+    ChordClipper(MidiStore&, PlayheadEstimator::Clock clock = getMonotonicNanos);
+    ChordWindow getChordWindowToDisplay(float &windowStart);
+    // Copy of the above with the times relative to the left side of the window (e.g., for tests)
     ChordVectorType getChordsToDisplay();
-    MeasurePositionType getMeasuresToDisplay();
+    const MeasurePositionType &getMeasuresToDisplay();
+    // Where the bar lines go for the whole song, and a count that goes up every time that changes
+    const TempoMap &getMeasureGrid();
+    int getMeasureGridGeneration() const { return measureGridGeneration; }
     void updateCurrentPosition(int msSinceLastUpdate);
 
     void scrollWheelNudge(float deltaX);
 
     float getViewWidthInSeconds();
+    pair<float, float> getViewWindowSize();
     float getCurrentNotePosition();
 
+    // For testing: how many times the chords have been fetched from the store
+    int getFetchCount() const { return fetchCount; }
+
 private:
 
-    pair<float, float> viewBufferSize;
-    vector<pair<float, string>> viewBuffer;
+    // The chords in the view window (plus the bit of extra on each side): a range in the snapshot of the
+    // store's view. The ends of it slide along with the window in either direction; see updateViewCache.
+    ChordSnapshot viewSnapshot;
+    size_t cacheBegin = 0;
+    size_t cacheEnd = 0;
+    ViewWindowType cachedWindow = {0.0f, 0.0f};
+    // the store's view version the snapshot came with
+    int cachedViewVersion = -1;
+    int fetchCount = 0;
 
     MidiStore &midiState;
-    pair<float, float> getViewWindowSize();
     bool isEventInWindow(pair<float, float> viewWindow, float eventSeconds, float &relativePosition);
-    pair<float, float> computeNewWindowSize(pair<float, float> neededWindow);
-    bool hasForwardOverlap(ViewWindowType neededWindow);
-    void constructDisplayedChords(ViewWindowType viewWindow, ChordVectorType newChords);
+    void updateViewCache(ViewWindowType neededWindow);
+    void refreshMeasureGrid(const TransportSnapshot &transport);
+
+    // Copy of the store's tempo map for drawing the bar lines, and what it was made from. The transport's
+    // tempo and time signature only matter while the captured map doesn't have them (see refreshMeasureGrid).
+    TempoMap capturedMap;
+    TempoMap measureGrid;
+    int measureGridVersion = -1;
+    double measureGridBpm = 0.0;
+    int measureGridNumerator = 0;
+    int measureGridDenominator = 0;
+    int measureGridGeneration = 0;
+    // the bars in the window (see getMeasuresToDisplay)
+    vector<pair<int, double>> gridBars;
+    MeasurePositionType displayedBars;
 
-    // The time (in seconds) of the most recently seen track time
-    float mostRecentPlayPosition = 0.0;
+    // Follows the host's playhead between audio blocks
+    PlayheadEstimator playhead;
     // This represents where we believe the playhead to be. Tracking this value instead of pestering the audio processor
     // for actual playhead position constantly
     atomic<float> estimatedPlayPosition = 0.0;
@@ -0,0 +1,291 @@
+/**
+ * @file ChordDisplayList.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "ChordDisplayList.h"
+#include "ChordName.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+
+/**
+ * @brief Work out everything to draw for the whole song
+ *
+ * @param chords     the view of the chords
+ * @param measures   where the bar lines go (e.g., ChordClipper::getMeasureGrid)
+ * @param settings   width, zoom, font size, etc.
+ * @param measure    gives the width of a piece of chord text
+ * @return shared_ptr<const ChordDisplayList>
+ */
+shared_ptr<const ChordDisplayList> ChordDisplayList::build(const ChordSnapshot &chords, const TempoMap &measures,
+                                                           const DisplaySettings &settings, const TextMeasure &measure)
+{
+    auto list = make_shared<ChordDisplayList>();
+    list->settings = settings;
+    list->chords = chords;
+    map<string, uint32_t> lookup;
+    list->addMeasures(measures, lookup);
+    if (chords != nullptr)
+        list->addChords(measure, lookup);
+    return list;
+}
+
+
+/**
+ * @brief The first command at or after x
+ *
+ * @param commands   one of the (sorted) lists
+ * @param x
+ * @return size_t
+ */
+size_t ChordDisplayList::findFirst(const vector<DisplayCommand> &commands, float x)
+{
+    auto byX = [](const DisplayCommand &command, float value) { return command.x < value; };
+    return static_cast<size_t>(lower_bound(commands.begin(), commands.end(), x, byX) - commands.begin());
+}
+
+
+/**
+ * @private
+ * @brief The same text is only kept once (there are a lot of C chords in most songs)
+ *
+ * @param text
+ * @param lookup
+ * @return uint32_t
+ */
+uint32_t ChordDisplayList::addText(const string &text, map<string, uint32_t> &lookup)
+{
+    auto found = lookup.find(text);
+    if (found != lookup.end())
+        return found->second;
+    uint32_t index = static_cast<uint32_t>(texts.size());
+    texts.push_back(text);
+    lookup.insert({text, index});
+    return index;
+}
+
+
+/**
+ * @private
+ * @brief The bar lines with their numbers, and a short line at each beat in between
+ *
+ * @param measures
+ * @param lookup
+ */
+void ChordDisplayList::addMeasures(const TempoMap &measures, map<string, uint32_t> &lookup)
+{
+    if (!measures.hasTempo() || !measures.hasMeter() || settings.measuresEnd <= 0.0)
+        return;
+
+    float ratio = settings.getPixelsPerSecond();
+    vector<pair<int, double>> bars;
+    // From a window's width before the start of the song: at the start, the window starts before 0 (the
+    // playhead isn't at the left side), and the first meter just keeps going back there. This is the whole
+    // song, not a window on the screen, so there's no limit on the number of bars
+    measures.getBarsInWindow(-static_cast<double>(settings.viewSeconds), settings.measuresEnd, bars,
+                             numeric_limits<size_t>::max());
+    const vector<TempoMap::MeterPoint> &meters = measures.getMeterPoints();
+    auto byPpq = [](double ppq, const TempoMap::MeterPoint &meter) { return ppq < meter.ppq; };
+    for (const auto &bar : bars)
+    {
+        float x = static_cast<float>(bar.second) * ratio;
+        measureCommands.push_back({x, DisplayCommand::barLine, 0, 0});
+        measureCommands.push_back({x + measureNumberOffset, DisplayCommand::measureNumber, 0,
+                                   addText(to_string(bar.first), lookup)});
+
+        // The beats of the meter the bar is in (the small bit added is for rounding in the seconds to PPQ trip)
+        double ppq = measures.secondsToPpq(bar.second);
+        // (before the first one, the first one just keeps going back)
+        auto meter = upper_bound(meters.begin(), meters.end(), ppq + 1.0e-6, byPpq);
+        if (meter != meters.begin())
+            --meter;
+        double beat = 4.0 / meter->denominator;
+        for (int i = 1; i < meter->numerator; i++)
+        {
+            double beatSeconds = measures.ppqToSeconds(ppq + i * beat);
+            measureCommands.push_back({static_cast<float>(beatSeconds) * ratio, DisplayCommand::beatHash, 0, 0});
+        }
+    }
+    stable_sort(measureCommands.begin(), measureCommands.end(),
+                [](const DisplayCommand &a, const DisplayCommand &b) { return a.x < b.x; });
+}
+
+
+/**
+ * @private
+ * @brief The chord names. A name with a flat or sharp in it (if the music symbol font is there) is drawn in
+ * pieces: the symbols in that font and the rest in the chord font. There are only a few different names in
+ * a song, so each one is laid out once and that is used for every time it shows up. Then the names are
+ * spread over rows so they don't run into each other (see layoutLabels).
+ *
+ * @param measure
+ * @param lookup
+ */
+void ChordDisplayList::addChords(const TextMeasure &measure, map<string, uint32_t> &lookup)
+{
+    struct Piece
+    {
+        float offset;
+        DisplayCommand::Kind kind;
+        uint32_t text;
+    };
+    struct Layout
+    {
+        vector<Piece> pieces;
+        float width;
+    };
+    map<string, Layout> layouts;
+    vector<const Layout*> chordLayouts;
+    vector<Label> labels;
+    ChordName cn;
+
+    float ratio = settings.getPixelsPerSecond();
+    chordLayouts.reserve(chords->size());
+    labels.reserve(chords->size());
+    for (size_t i = 0; i < chords->size(); i++)
+    {
+        const string &name = chords->getName(i);
+        auto layout = layouts.find(name);
+        if (layout == layouts.end())
+        {
+            vector<Piece> pieces;
+            float offset = 0.0f;
+            if (!settings.symbolFont || name.find_first_of("b#") == string::npos)
+            {
+                // no sharp/flat so we can just draw it with the default font
+                pieces.push_back({0.0f, DisplayCommand::chordText, addText(name, lookup)});
+                offset = measure(name, false);
+            }
+            else
+            {
+                string part;
+                for (char c : name)
+                {
+                    optional<string> symbol = cn.getUnicodeSymbol(c);
+                    if (symbol == std::nullopt)
+                    {
+                        part += c;
+                        continue;
+                    }
+                    if (!part.empty())
+                    {
+                        pieces.push_back({offset, DisplayCommand::chordText, addText(part, lookup)});
+                        offset += measure(part, false) + symbolSpacer;
+                        part.clear();
+                    }
+                    pieces.push_back({offset, DisplayCommand::symbolText, addText(*symbol, lookup)});
+                    offset += measure(*symbol, true) + symbolSpacer;
+                }
+                if (!part.empty())
+                {
+                    pieces.push_back({offset, DisplayCommand::chordText, addText(part, lookup)});
+                    offset += measure(part, false);
+                }
+            }
+            maxTextWidth = max(maxTextWidth, offset);
+            layout = layouts.insert({name, {std::move(pieces), offset}}).first;
+        }
+
+        float x = chords->getTime(i) * ratio;
+        // The last chord goes on until the end of the song
+        float duration = i + 1 < chords->size() ? chords->getTime(i + 1) - chords->getTime(i) : HUGE_VALF;
+        chordLayouts.push_back(&layout->second);
+        labels.push_back({x, x + layout->second.width, duration, 0});
+    }
+
+    layoutLabels(labels, getRowsThatFit(settings));
+
+    chordCommands.reserve(chords->size());
+    for (size_t i = 0; i < labels.size(); i++)
+    {
+        if (labels[i].row < 0)
+            continue;
+        for (const Piece &piece : chordLayouts[i]->pieces)
+            chordCommands.push_back({labels[i].start + piece.offset, piece.kind, static_cast<uint8_t>(labels[i].row),
+                                     piece.text});
+    }
+    // The pieces of a name that is very close to the next one could end up past the start of it
+    stable_sort(chordCommands.begin(), chordCommands.end(),
+                [](const DisplayCommand &a, const DisplayCommand &b) { return a.x < b.x; });
+}
+
+
+/**
+ * @brief How many rows of chord names fit in the view (at least one, at most maxLabelRows)
+ *
+ * @param settings
+ * @return int
+ */
+int ChordDisplayList::getRowsThatFit(const DisplaySettings &settings)
+{
+    if (settings.fontSize <= 0)
+        return 1;
+    // a little room between the rows, and the top bit is for the measure numbers
+    int rows = static_cast<int>((static_cast<float>(settings.height) - 20.0f) / (static_cast<float>(settings.fontSize) * 1.2f));
+    return max(1, min(rows, maxLabelRows));
+}
+
+
+/**
+ * @private
+ * @brief Spread the chord names over the rows so none of them run into each other.
+ * @details
+ * Going through them in time order, each name goes in the first row where the name before it has ended
+ * (plus a gap). When the rows are all full there, something has to give: the name in the way that ends
+ * soonest is compared to this one, and whichever chord is shorter isn't drawn. So in a busy spot the
+ * chords that last are the ones that get seen, and a quick passing chord is what goes. (That one is still
+ * in the chords, and shows up again when zoomed in far enough.)
+ *
+ * @param labels   where each name starts and ends (pixels); gets the row (or -1 to leave it out)
+ * @param rows     how many rows there are
+ */
+void ChordDisplayList::layoutLabels(vector<Label> &labels, int rows)
+{
+    // The last label in each row
+    vector<size_t> rowLast(static_cast<size_t>(rows), SIZE_MAX);
+    rowCount = 1;
+    culledCount = 0;
+    for (size_t i = 0; i < labels.size(); i++)
+    {
+        Label &label = labels[i];
+        int soonest = 0;
+        float soonestEnd = HUGE_VALF;
+        label.row = -1;
+        for (int row = 0; row < rows; row++)
+        {
+            size_t last = rowLast[static_cast<size_t>(row)];
+            float end = last == SIZE_MAX ? -HUGE_VALF : labels[last].end + labelGap;
+            if (end <= label.start)
+            {
+                label.row = row;
+                break;
+            }
+            if (end < soonestEnd)
+            {
+                soonestEnd = end;
+                soonest = row;
+            }
+        }
+        if (label.row < 0)
+        {
+            // Only the last one in the row is taken out, so the one before it is still clear of this one
+            Label &inTheWay = labels[rowLast[static_cast<size_t>(soonest)]];
+            culledCount++;
+            if (inTheWay.duration >= label.duration)
+                continue;
+            inTheWay.row = -1;
+            label.row = soonest;
+        }
+        rowLast[static_cast<size_t>(label.row)] = i;
+        rowCount = max(rowCount, label.row + 1);
+    }
+}
@@ -0,0 +1,135 @@
+/**
+ * @file ChordDisplayList.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ChordWindow.h"
+#include "TempoMap.h"
+
+using namespace std;
+
+
+// What the display list is made for. A change to any of these needs a new one.
+struct DisplaySettings
+{
+    int width = 0;
+    int height = 0;
+    float viewSeconds = 0.0f;
+    int fontSize = 0;
+    bool symbolFont = false;
+    // the bar lines go this far (seconds)
+    double measuresEnd = 0.0;
+
+    bool operator==(const DisplaySettings &other) const
+    {
+        return width == other.width && height == other.height && viewSeconds == other.viewSeconds && fontSize == other.fontSize &&
+               symbolFont == other.symbolFont && measuresEnd == other.measuresEnd;
+    }
+    bool operator!=(const DisplaySettings &other) const { return !(*this == other); }
+    float getPixelsPerSecond() const { return viewSeconds > 0.0f ? static_cast<float>(width) / viewSeconds : 0.0f; }
+};
+
+
+// One thing to draw. x is in pixels from the start of the song (at the zoom it was made for).
+struct DisplayCommand
+{
+    enum Kind : uint8_t
+    {
+        barLine,
+        beatHash,
+        measureNumber,
+        chordText,
+        // a flat or sharp in the music symbol font
+        symbolText
+    };
+
+    float x;
+    Kind kind;
+    // which row the chord name is in (see ChordDisplayList::layoutLabels)
+    uint8_t row;
+    // which of the texts (for the text kinds)
+    uint32_t text;
+};
+
+
+/**
+ * @brief Everything ChordView draws for the whole song, worked out ahead of time.
+ * @details
+ * Working out where things go (bar lines, beat hashes, where each piece of a chord name goes when the flats
+ * and sharps are in a different font) used to be done in paint, every frame, on the message thread (which
+ * the DAW needs for its own GUI). Now it is done once, on the worker pool, whenever the chords, the measures
+ * or the settings (width, zoom, font size) change. The result is two lists of commands sorted by x in song
+ * coordinates, so paint just finds the first one in the window, moves each one over by the window start
+ * and draws it.
+ *
+ * The text widths come from whoever builds it (ChordView measures with its fonts), so there is nothing
+ * here that depends on JUCE's graphics and it can be tested without a display.
+ */
+class ChordDisplayList
+{
+public:
+    // Width in pixels of some text in the chord font (or the symbol font, if isSymbol)
+    typedef function<float(const string &text, bool isSymbol)> TextMeasure;
+    // Gap between the pieces of a chord name when the symbols are drawn in their own font
+    static constexpr float symbolSpacer = 2.0f;
+    // How far the measure numbers are from the bar line
+    static constexpr float measureNumberOffset = 5.0f;
+    // Space to keep between two chord names in the same row
+    static constexpr float labelGap = 6.0f;
+    // Most rows the chord names are spread over (if the view is tall enough for them)
+    static constexpr int maxLabelRows = 3;
+
+    static shared_ptr<const ChordDisplayList> build(const ChordSnapshot &chords, const TempoMap &measures,
+                                                    const DisplaySettings &settings, const TextMeasure &measure);
+
+    const DisplaySettings &getSettings() const { return settings; }
+    const ChordSnapshot &getChords() const { return chords; }
+    const vector<DisplayCommand> &getMeasureCommands() const { return measureCommands; }
+    const vector<DisplayCommand> &getChordCommands() const { return chordCommands; }
+    const string &getText(uint32_t text) const { return texts[text]; }
+    // The widest piece of chord text, so a label that starts left of the window but reaches into it is found
+    float getMaxTextWidth() const { return maxTextWidth; }
+    // How many rows the chord names ended up in, and how many were left out for lack of room
+    int getRowCount() const { return rowCount; }
+    size_t getCulledCount() const { return culledCount; }
+    static int getRowsThatFit(const DisplaySettings &settings);
+
+    static size_t findFirst(const vector<DisplayCommand> &commands, float x);
+
+private:
+    DisplaySettings settings;
+    ChordSnapshot chords;
+    vector<DisplayCommand> measureCommands;
+    vector<DisplayCommand> chordCommands;
+    vector<string> texts;
+    float maxTextWidth = 0.0f;
+    int rowCount = 1;
+    size_t culledCount = 0;
+
+    // Where a chord name goes: its row, or -1 if it doesn't get drawn
+    struct Label
+    {
+        float start;
+        float end;
+        float duration;
+        int row;
+    };
+    void layoutLabels(vector<Label> &labels, int rows);
+
+    uint32_t addText(const string &text, map<string, uint32_t> &lookup);
+    void addMeasures(const TempoMap &measures, map<string, uint32_t> &lookup);
+    void addChords(const TextMeasure &measure, map<string, uint32_t> &lookup);
+};
@@ -12,6 +12,8 @@
 #include "ChordName.h"
 #include <set>
 #include <algorithm>
+#include <string_view>
+#include <cctype>
 using namespace std;
 
 ChordName::ChordName()
@@ -25,13 +27,45 @@ ChordName::~ChordName()
 /**
  * @brief For a given set of notes, retrieve the chord name
  * 
- * @param vector<int> notes 
+ * @param NoteSet notes 
  * @return string 
  */
-string ChordName::nameChord(vector<int> notes)
+string ChordName::nameChord(const NoteSet &notes)
+{
+    return chordIdToName(chordId(notes));
+}
+
+
+/**
+ * @brief For a given set of notes, figure out the chord (see ChordId)
+ * 
+ * @param NoteSet notes 
+ * @return ChordId    noChord if there are no notes
+ */
+ChordId ChordName::chordId(const NoteSet &notes)
 {
+    ChordId id;
+    nameChords(&notes, &id, 1);
+    return id;
+}
+
+
+/**
+ * @brief For a given set of notes, figure out the chord (see ChordId). This is the original logic that
+ * works through the notes one chord at a time. The lookup table used by everything else (see
+ * relativeChordTable) keeps its answer for every combination of notes it recognizes.
+ * 
+ * @param vector<int> notes 
+ * @param recognized    if given, set to true if the notes matched one of the original lookups exactly (as
+ *                      opposed to falling back on a plain major chord or dropping 2nd/4th/6th notes)
+ * @return ChordId    noChord if there are no notes
+ */
+ChordId ChordName::scalarChordId(vector<int> notes, bool *recognized)
+{
+    if (recognized != nullptr)
+        *recognized = notes.size() > 0;
     if (notes.size() == 0)
-        return "";
+        return noChord;
 
     vector<int> normalized = reduceNotes(notes);
     
@@ -39,14 +73,14 @@ string ChordName::nameChord(vector<int> notes)
     {
     case 1:
         // for a single note, assume the chord is the one note
-        return midiNoteToName(normalized[0]);
+        return makeChordId(normalized[0], normalized[0], 0, false);
     case 2:
-        return twoNoteChordName(normalized);
+        return twoNoteChordId(normalized);
     default:
-        return multiNoteChordName(normalized);
+        return multiNoteChordId(normalized, recognized);
     }
 
-    return "";
+    return noChord;
 }
 
 
@@ -56,20 +90,18 @@ string ChordName::nameChord(vector<int> notes)
  * is the chord name. The interval between that note and the next one is treated as the modifier
  * 
  * @param vector<int> notes 
- * @return string 
+ * @return ChordId 
  */
-string ChordName::twoNoteChordName(vector<int> notes)
+ChordId ChordName::twoNoteChordId(const vector<int> &notes)
 {
     int interval = notes[1] - notes[0];
-    string chord;
     auto   intervalInfo = twoNoteIntervals.find(interval);
     string modifier = "";
 
     if (intervalInfo != twoNoteIntervals.end())
         modifier = intervalInfo->second;
 
-    chord = midiNoteToName(notes[0]) + modifier;
-    return chord;
+    return makeChordId(notes[0], notes[0], qualityIndex(modifier), false);
 }
 
 
@@ -77,11 +109,11 @@ string ChordName::twoNoteChordName(vector<int> notes)
  * @brief Name chords that consist of 3 or more notes
  * 
  * @param vector<int> notes  The normalized vector of midi note values
- * @return string 
+ * @param recognized         if not null, set to false when the notes aren't one of the chords in chordQuality
+ * @return ChordId 
  */
-string ChordName::multiNoteChordName(vector<int> notes)
+ChordId ChordName::multiNoteChordId(vector<int> notes, bool *recognized)
 {
-    string chord;
     string modifier = "";
     bool inversion = false;
     vector<int> notes246;
@@ -90,29 +122,313 @@ string ChordName::multiNoteChordName(vector<int> notes)
     inversion = normalizeNotes(notes);
     notes246 = extract246(notes);
 
-    int interval1 = notes[1] - notes[0];
-    int interval2 = notes[2] - notes[1];
-    int interval3 = 0;
-    if (notes.size() > 3) 
-        interval3 = notes[3] - notes[2];
-
-    tuple<int, int, int> intervalPair = {interval1, interval2, interval3};
+    // Removing the 2/4/6 notes can leave fewer than 3 notes (e.g., CDF). Then there is no quality to find.
+    auto interval = [&notes](size_t i) { return i < notes.size() ? notes[i] - notes[i - 1] : 0; };
+    tuple<int, int, int> intervalPair = {interval(1), interval(2), interval(3)};
     auto quality = chordQuality.find(intervalPair);
     if (quality != chordQuality.end()) 
     {
         modifier = quality->second;
     }
+    // The lookup only looks at the first four notes, so anything more than that wasn't really recognized
+    if (recognized != nullptr)
+        *recognized = quality != chordQuality.end() && notes246.empty() && notes.size() <= 4;
+
+    // If it was inverted, treat this as "Chord / Chord" notation. Example is notes CFA (2nd inversion of F maj).
+    // Notate it as F/C
+    return makeChordId(notes[0], origBass, qualityIndex(modifier), inversion);
+}
+
+
+/**
+ * @brief Turn a chord id into its name (e.g., Am/C)
+ * 
+ * @param id 
+ * @return string   empty for noChord
+ */
+string ChordName::chordIdToName(ChordId id)
+{
+    if (id == noChord)
+        return "";
+
+    string chord = spelledNoteNames[(id >> 17) & 1][chordIdRoot(id)] + qualityNames[chordIdQuality(id)];
+    if (chordIdIsSlash(id))
+        chord += "/" + spelledNoteNames[(id >> 18) & 1][chordIdBass(id)];
+    return chord;
+}
+
 
-    chord = midiNoteToName(notes[0]) + modifier;
-    if (inversion) 
+/**
+ * @brief The reverse of chordIdToName: turn a name (e.g., "Am/C", "F#m7", "Bb6/9") back into a chord id
+ * 
+ * @param name 
+ * @return ChordId   noChord if it isn't a name that chordIdToName would produce
+ */
+ChordId ChordName::nameToChordId(const string &name)
+{
+    static const int letterPitches[] = {9, 11, 0, 2, 4, 5, 7};    // A through G
+
+    auto parseNote = [](const string &text, size_t &pos, bool &sharp) -> int
     {
-        // Treat this as "Chord / Chord" notation. Example is notes CFA (2nd inversion of F maj). Notate it as F/C
-        chord += "/" + midiNoteToName(origBass);
+        if (pos >= text.size() || text[pos] < 'A' || text[pos] > 'G')
+            return -1;
+        int pitch = letterPitches[text[pos++] - 'A'];
+        sharp = false;
+        if (pos < text.size() && (text[pos] == 'b' || text[pos] == '#'))
+        {
+            sharp = text[pos] == '#';
+            pitch += sharp ? 1 : 11;
+            pos++;
+        }
+        return pitch % 12;
+    };
+
+    size_t pos = 0;
+    bool rootSharp = false;
+    int root = parseNote(name, pos, rootSharp);
+    if (root < 0)
+        return noChord;
+
+    // "6/9" has a slash in it, so try the whole rest of it as the quality before looking for a bass note
+    string rest = name.substr(pos);
+    auto quality = find(begin(qualityNames), end(qualityNames), rest);
+    if (quality != end(qualityNames))
+        return makeChordId(root, root, static_cast<int>(quality - begin(qualityNames)), false) | (rootSharp ? 1 << 17 : 0);
+
+    size_t slash = rest.rfind('/');
+    if (slash == string::npos)
+        return noChord;
+    quality = find(begin(qualityNames), end(qualityNames), rest.substr(0, slash));
+    size_t bassPos = 0;
+    bool bassSharp = false;
+    string bassName = rest.substr(slash + 1);
+    int bass = parseNote(bassName, bassPos, bassSharp);
+    if (quality == end(qualityNames) || bass < 0 || bassPos != bassName.size())
+        return noChord;
+    return makeChordId(root, bass, static_cast<int>(quality - begin(qualityNames)), true) |
+           (rootSharp ? 1 << 17 : 0) | (bassSharp ? 1 << 18 : 0);
+}
+
+
+/**
+ * @brief Spell a chord for the given key. By default the black notes are all flats (Ab, Bb, etc.). In a
+ * sharp key, the black notes that belong to the key are sharps instead; e.g., the iii chord in E major is
+ * G#m instead of Abm. The spelling is just a couple of bits in the chord id, so this doesn't build any
+ * strings.
+ * 
+ * @param id 
+ * @param key     see KeyDetector (0-11 major, 12-23 minor), or -1 for no key (no change)
+ * @return ChordId 
+ */
+ChordId ChordName::spellForKey(ChordId id, int key)
+{
+    id = chordIdUnspelled(id);
+    if (id == noChord || key < 0 || key >= 24)
+        return id;
+
+    uint16_t sharps = keySpellingTable()[static_cast<size_t>(key)];
+    if (sharps & (1 << chordIdRoot(id)))
+        id |= 1 << 17;
+    if (sharps & (1 << chordIdBass(id)))
+        id |= 1 << 18;
+    return id;
+}
+
+
+/**
+ * @private
+ * @brief For each of the 24 keys, the pitch classes that are written as sharps (bit n for pitch class n).
+ * @details
+ * Built from chordLookup (so this finally gets used). In the sharp keys, the black notes in the scale are
+ * sharps. In a minor key, the raised 7th (the leading tone) is also a sharp if it is a black note (e.g.,
+ * C# in D minor).
+ * 
+ * @return const array<uint16_t, 24>&  indexed the same as KeyDetector's keys (0-11 major, 12-23 minor)
+ */
+const array<uint16_t, 24> &ChordName::keySpellingTable()
+{
+    static const array<uint16_t, 24> table = []
+    {
+        const uint16_t blackNotes = chordIntervals({1, 3, 6, 8, 10});
+        const uint16_t majorScale = chordIntervals({0, 2, 4, 5, 7, 9, 11});
+        const uint16_t minorScale = chordIntervals({0, 2, 3, 5, 7, 8, 10, 11});
+        const int letters[7] = {9, 11, 0, 2, 4, 5, 7};   // a through g
+
+        array<uint16_t, 24> entries {};
+        for (const auto &keyInfo : chordLookup)
+        {
+            const string &name = keyInfo.first;
+            int tonic = letters[(tolower(name[0]) - 'a') % 7];
+            for (size_t i = 1; i < name.size(); i++)
+                tonic += name[i] == '#' ? 1 : -1;
+            tonic = (tonic + 12) % 12;
+            bool isMinor = keyInfo.second.isMinor;
+
+            // the scale of the key, moved up to its tonic
+            uint32_t scale = isMinor ? minorScale : majorScale;
+            scale = ((scale << tonic) | (scale >> (12 - tonic))) & 0xfff;
+            uint32_t sharps = keyInfo.second.isSharp ? (scale & blackNotes) : 0;
+            int leadingTone = (tonic + 11) % 12;
+            if (isMinor && (blackNotes & (1 << leadingTone)))
+                sharps |= 1u << leadingTone;
+            entries[static_cast<size_t>(tonic + (isMinor ? 12 : 0))] = static_cast<uint16_t>(sharps);
+        }
+        return entries;
+    }();
+    return table;
+}
+
+
+/**
+ * @private
+ * @brief Index of a quality name in qualityNames
+ * 
+ * @param quality 
+ * @return int 
+ */
+int ChordName::qualityIndex(const string &quality)
+{
+    auto it = find(begin(qualityNames), end(qualityNames), quality);
+    // Every string in the lookup tables has to be in qualityNames
+    return it == end(qualityNames) ? 0 : static_cast<int>(it - begin(qualityNames));
+}
+
+
+/**
+ * @private
+ * @brief Compile chordTemplates into a table with the same layout as relativeChordTable. This runs at
+ * build time.
+ * @details
+ * Every template (with every combination of its optional notes) is written in at each of the places it
+ * can land: first with the root in the bass, then for each of its inversions (those are slash chords).
+ * The first one to claim an entry keeps it, so the root position always wins over an inversion of
+ * something else and earlier templates win over later ones. Entries that no template covers are 0xffff.
+ * 
+ * @return constexpr array<uint16_t, 2048> 
+ */
+constexpr array<uint16_t, 2048> ChordName::buildTemplateTable()
+{
+    array<uint16_t, 2048> entries {};
+    for (auto &entry : entries)
+        entry = 0xffff;
+
+    for (int inverted = 0; inverted < 2; inverted++)
+    {
+        for (const ChordTemplate &chord : chordTemplates)
+        {
+            // quality index of the template (a plain loop so it can run at compile time)
+            int quality = 0;
+            while (string_view(qualityNames[quality]) != chord.quality)
+                quality++;
+
+            // walk through all the subsets of the optional notes (including none of them)
+            uint32_t optional = chord.optional;
+            for (uint32_t extra = optional;; extra = (extra - 1) & optional)
+            {
+                uint32_t notes = chord.required | extra;
+                for (int bass = 0; bass < 12; bass++)
+                {
+                    if ((notes & (1u << bass)) == 0 || (bass != 0) != (inverted != 0))
+                        continue;
+                    // Only the 3rd, 5th or 7th go in the bass for an inversion. A 2nd/4th/6th (9th/11th/13th)
+                    // in the bass reads as some other chord (the same notes extract246 sets aside)
+                    if (bass == 2 || bass == 5 || bass == 9)
+                        continue;
+                    // rotate the notes so that the bass is at the bottom; the root is then 12 - bass above it
+                    uint32_t relative = ((notes >> bass) | (notes << (12 - bass))) & 0xfff;
+                    uint16_t &entry = entries[relative >> 1];
+                    if (entry == 0xffff)
+                        entry = static_cast<uint16_t>(((12 - bass) % 12) | (quality << 4) | (bass != 0 ? 1 << 12 : 0));
+                }
+                if (extra == 0)
+                    break;
+            }
+        }
     }
+    return entries;
+}
 
-    return chord;
+
+/**
+ * @private
+ * @brief The chord for every combination of pitch classes, relative to a bass note of C.
+ * @details
+ * The chord for a set of notes only depends on which pitch classes are on and which one is the bass. Rotate
+ * the pitch classes so that the bass is at bit 0 and the name is the same (transposed) as it would be for
+ * that set of notes with a C in the bass. Bit 0 is then always set, so the other 11 bits give 2048 entries.
+ * Each entry is the root (relative to the bass) in bits 0-3, the quality in bits 4-11 and the slash flag
+ * in bit 12.
+ * 
+ * The combinations that the original logic (scalarChordId) recognizes keep exactly the name they have
+ * always had. The rest come from the chord templates (which are compiled into a table at build time), and
+ * if none of those fit either, it is back to whatever the original logic came up with.
+ * 
+ * @return const array<uint16_t, 2048>& 
+ */
+const array<uint16_t, 2048> &ChordName::relativeChordTable()
+{
+    static const array<uint16_t, 2048> table = []
+    {
+        static constexpr array<uint16_t, 2048> templateEntries = buildTemplateTable();
+        array<uint16_t, 2048> entries {};
+        ChordName cn;
+        for (int index = 0; index < 2048; index++)
+        {
+            vector<int> notes = {0};
+            for (int pc = 1; pc < 12; pc++)
+            {
+                if (index & (1 << (pc - 1)))
+                    notes.push_back(pc);
+            }
+            bool recognized;
+            ChordId id = cn.scalarChordId(notes, &recognized);
+            uint16_t templateEntry = templateEntries[static_cast<size_t>(index)];
+            if (!recognized && templateEntry != 0xffff)
+                entries[static_cast<size_t>(index)] = templateEntry;
+            else
+                entries[static_cast<size_t>(index)] = static_cast<uint16_t>(chordIdRoot(id) | (chordIdQuality(id) << 4) |
+                                                                            (chordIdIsSlash(id) ? 1 << 12 : 0));
+        }
+        return entries;
+    }();
+    return table;
+}
+
+
+/**
+ * @brief Figure out the chords for a whole bunch of note sets at once (e.g., every event in a track).
+ * @details
+ * There are no per-call allocations or sorting (unlike scalarChordId()): fold
+ * the notes into pitch classes with a few shifts, find the bass note with a count of trailing zeros, rotate
+ * the pitch classes so the bass is at the bottom and look the answer up in relativeChordTable().
+ * 
+ * @param noteSets   the note sets
+ * @param ids        receives the chord id (or noChord) for each of the note sets
+ * @param count      number of note sets
+ */
+void ChordName::nameChords(const NoteSet *noteSets, ChordId *ids, size_t count)
+{
+    const array<uint16_t, 2048> &table = relativeChordTable();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const NoteSet &notes = noteSets[i];
+        if (notes.isEmpty())
+        {
+            ids[i] = noChord;
+            continue;
+        }
+
+        uint32_t classes = notes.pitchClasses();
+        int bass = notes.lowest() % 12;
+
+        uint32_t relative = ((classes >> bass) | (classes << (12 - bass))) & 0xfff;
+        uint16_t entry = table[relative >> 1];
+        ids[i] = makeChordId(bass + (entry & 0xf), bass, (entry >> 4) & 0xff, (entry >> 12) != 0);
+    }
 }
 
+
 /**
  * @brief Put the notes into a single octave to simplify chord quality identification.
  * - Move the notes into a single octave (the semitone interval between the min and max will be <= 11)
@@ -122,7 +438,7 @@ string ChordName::multiNoteChordName(vector<int> notes)
  * @param notes 
  * @return vector<int>   The notes are returned in sorted MIDI order
  */
-vector<int> ChordName::reduceNotes(vector<int> notes) 
+vector<int> ChordName::reduceNotes(const vector<int> &notes) 
 {
     set<int> unique;
     vector<int> normalized;
@@ -135,7 +451,7 @@ vector<int> ChordName::reduceNotes(vector<int> notes)
     int bottomNote = *min_element(notes.begin(), notes.end());
     bottomNote %= 12;
 
-    for (vector<int>::iterator it = notes.begin(); it != notes.end(); ++it) 
+    for (vector<int>::const_iterator it = notes.begin(); it != notes.end(); ++it) 
     {
         int note = *it % 12;
         if (note < bottomNote) 
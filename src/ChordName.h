@@ -13,10 +13,34 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include "NoteSet.h"
 
 using namespace std;
 
 
+/**
+ * @brief Compact form of a chord name: root, bass, quality and whether it is written as a slash chord.
+ * Comparing two of these is the same as comparing the names, and it is cheap to turn one into the name
+ * (see ChordName::chordIdToName). Bits 0-3 are the root pitch class, 4-7 the bass pitch class, 8-15 the index
+ * into ChordName's quality names, and bit 16 is set for a slash chord (e.g., F/C). Bits 17 and 18 are set
+ * when the root and bass (respectively) are spelled as sharps rather than flats (see ChordName::spellForKey).
+ */
+typedef uint32_t ChordId;
+
+/**
+ * @brief Turn a list of intervals (semitones above the root) into a 12 bit pitch class mask
+ */
+constexpr uint16_t chordIntervals(initializer_list<int> semitones)
+{
+    uint16_t mask = 0;
+    for (int semitone : semitones)
+        mask = static_cast<uint16_t>(mask | (1 << semitone));
+    return mask;
+}
+
 struct chordInfo
 {
     bool isSharp;
@@ -34,19 +58,99 @@ public:
     ChordName();
     ~ChordName();
 
-    string nameChord(vector<int> notes);
+    string nameChord(const NoteSet &notes);
+    ChordId chordId(const NoteSet &notes);
+    static void nameChords(const NoteSet *noteSets, ChordId *ids, size_t count);
+    // vector versions of the above (e.g., for tests)
+    string nameChord(const vector<int> &notes) { return nameChord(NoteSet::fromVector(notes)); }
+    ChordId chordId(const vector<int> &notes) { return chordId(NoteSet::fromVector(notes)); }
+    // The original one-chord-at-a-time naming logic. The lookup table used by everything else starts from it
+    ChordId scalarChordId(vector<int> notes, bool *recognized = nullptr);
+    string chordIdToName(ChordId id);
+    static ChordId nameToChordId(const string &name);
     string midiNoteToName(int note);
+
+    static constexpr ChordId noChord = 0xffffffff;
+    static ChordId makeChordId(int root, int bass, int quality, bool slash)
+    {
+        return static_cast<ChordId>((root % 12) | ((bass % 12) << 4) | (quality << 8) | (slash ? 1 << 16 : 0));
+    }
+    static int chordIdRoot(ChordId id) { return static_cast<int>(id & 0xf); }
+    static int chordIdBass(ChordId id) { return static_cast<int>((id >> 4) & 0xf); }
+    static int chordIdQuality(ChordId id) { return static_cast<int>((id >> 8) & 0xff); }
+    static bool chordIdIsSlash(ChordId id) { return (id & (1 << 16)) != 0; }
+    // The chord without any spelling (it is the same chord whether it is written G# or Ab)
+    static ChordId chordIdUnspelled(ChordId id) { return id == noChord ? id : (id & 0x1ffff); }
+    static ChordId spellForKey(ChordId id, int key);
     optional<string> getUnicodeSymbol(char c);
 
     // These "maybe" should be private methods. But 
     bool normalizeNotes(vector<int> &notes);
     vector<int> extract246(vector<int> &notes);
-    vector<int> reduceNotes(vector<int> notes);
+    vector<int> reduceNotes(const vector<int> &notes);
 
 private:
-    string twoNoteChordName(vector<int> notes);
-    string multiNoteChordName(vector<int> notes);
+    /**
+     * @brief One entry in the chord vocabulary: the intervals (in semitones above the root) as a 12 bit
+     * pitch class mask. All of the required ones have to be there; the optional ones (e.g., the 5th) may or
+     * may not be. Anything else and it is not this chord.
+     */
+    struct ChordTemplate
+    {
+        const char *quality;
+        uint16_t required;
+        uint16_t optional;
+    };
+
+    ChordId twoNoteChordId(const vector<int> &notes);
+    ChordId multiNoteChordId(vector<int> notes, bool *recognized);
     bool isSharpKey(string key);
+    static int qualityIndex(const string &quality);
+    static const array<uint16_t, 2048> &relativeChordTable();
+    static constexpr array<uint16_t, 2048> buildTemplateTable();
+    static const array<uint16_t, 24> &keySpellingTable();
+
+    // All the chord "qualities" (the part of the name after the root) that the lookups below produce.
+    // A ChordId stores the index into this. Each name appears once so that equal ids mean equal names.
+    // The first ones are from the original lookups; the extended vocabulary is tacked on after them.
+    inline static constexpr const char *qualityNames[] =
+    {
+        "", "m", "dim", "aug", "7", "M7", "m7", "m7b5", "M7+", "m-7", "2", "4", "6",
+        "m6", "sus2", "sus4", "7sus4", "add9", "madd9", "6/9", "9", "M9", "m9", "11", "m11", "13", "M13", "m13"
+    };
+
+    // The chord vocabulary, in order of preference when a set of notes could be named more than one way
+    // (after preferring the bass note as the root). These are compiled into the lookup table (see
+    // relativeChordTable), so adding to this list doesn't make naming any slower.
+    inline static constexpr ChordTemplate chordTemplates[] =
+    {
+        {"",       chordIntervals({0, 4, 7}),      0},
+        {"m",      chordIntervals({0, 3, 7}),      0},
+        {"dim",    chordIntervals({0, 3, 6}),      0},
+        {"aug",    chordIntervals({0, 4, 8}),      0},
+        {"7",      chordIntervals({0, 4, 10}),     chordIntervals({7})},
+        {"M7",     chordIntervals({0, 4, 11}),     chordIntervals({7})},
+        {"m7",     chordIntervals({0, 3, 10}),     chordIntervals({7})},
+        {"m7b5",   chordIntervals({0, 3, 6, 10}),  0},
+        {"M7+",    chordIntervals({0, 4, 8, 11}),  0},
+        {"m-7",    chordIntervals({0, 3, 11}),     chordIntervals({7})},
+        {"6",      chordIntervals({0, 4, 7, 9}),   0},
+        {"m6",     chordIntervals({0, 3, 7, 9}),   0},
+        {"sus2",   chordIntervals({0, 2, 7}),      0},
+        {"sus4",   chordIntervals({0, 5, 7}),      0},
+        {"7sus4",  chordIntervals({0, 5, 10}),     chordIntervals({7})},
+        {"add9",   chordIntervals({0, 2, 4, 7}),   0},
+        {"madd9",  chordIntervals({0, 2, 3, 7}),   0},
+        {"6/9",    chordIntervals({0, 2, 4, 9}),   chordIntervals({7})},
+        {"9",      chordIntervals({0, 2, 4, 10}),  chordIntervals({7})},
+        {"M9",     chordIntervals({0, 2, 4, 11}),  chordIntervals({7})},
+        {"m9",     chordIntervals({0, 2, 3, 10}),  chordIntervals({7})},
+        {"11",     chordIntervals({0, 2, 5, 10}),  chordIntervals({4, 7})},
+        {"m11",    chordIntervals({0, 3, 5, 10}),  chordIntervals({2, 7})},
+        {"13",     chordIntervals({0, 4, 9, 10}),  chordIntervals({2, 7})},
+        {"M13",    chordIntervals({0, 4, 9, 11}),  chordIntervals({2, 7})},
+        {"m13",    chordIntervals({0, 3, 9, 10}),  chordIntervals({2, 5, 7})},
+    };
 
 
     // one could have semantic arguments about these, but the F# vs Gb one is probably the main one
@@ -117,6 +221,11 @@ private:
         {10, "Bb"},
         {11, "B"},
     };
+    // The note names used in chord names, spelled with flats and with sharps
+    inline static const string spelledNoteNames[2][12] = {
+        {"C", "Db", "D", "Eb", "E", "F", "Gb", "G", "Ab", "A", "Bb", "B"},
+        {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"},
+    };
     inline static const map<string, chordInfo> chordLookup = {
         {"C", {true, false} },
         {"G", {true, false} },
@@ -0,0 +1,168 @@
+/**
+ * @file ChordOverview.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "ChordOverview.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+/**
+ * @brief Catch up with a (possibly) new snapshot of the view
+ *
+ * @param snapshot
+ * @return bool   true if anything changed
+ */
+bool ChordOverview::update(const ChordSnapshot &snapshot)
+{
+    if (snapshot == nullptr || snapshot == source)
+        return false;
+
+    size_t firstChange = source ? findFirstChange(*source, *snapshot) : 0;
+    bool sameChords = source && firstChange == source->size() && firstChange == snapshot->size();
+    source = snapshot;
+    rebuiltBins = 0;
+    if (sameChords)
+        return false;
+
+    // The chord before the first change ends where the change is, so its bins change too
+    size_t firstBin = 0;
+    if (firstChange > 0)
+        firstBin = static_cast<size_t>(snapshot->getTime(firstChange - 1) / binSeconds);
+    rebuild(*snapshot, firstBin);
+    return true;
+}
+
+
+/**
+ * @private
+ * @brief Where two views of the chords start to be different
+ *
+ * @param before
+ * @param after
+ * @return size_t   position of the first chord that isn't the same in both (the shorter size if one is the
+ *                  start of the other)
+ */
+size_t ChordOverview::findFirstChange(const ChordTimeline &before, const ChordTimeline &after)
+{
+    size_t count = min(before.size(), after.size());
+    size_t i = 0;
+    while (i < count && before.getTime(i) == after.getTime(i) && before.getChordId(i) == after.getChordId(i))
+        i++;
+    return i;
+}
+
+
+/**
+ * @private
+ * @brief Work out the bins from firstBin (at level 0) on, at every level
+ *
+ * @param chords
+ * @param firstBin
+ */
+void ChordOverview::rebuild(const ChordTimeline &chords, size_t firstBin)
+{
+    size_t binCount = 0;
+    if (!chords.empty())
+        binCount = static_cast<size_t>(ceil((chords.getTime(chords.size() - 1) + lastChordSeconds) / binSeconds));
+    if (levels.empty())
+        levels.resize(1);
+    vector<Bin> &bins = levels[0];
+    firstBin = min(firstBin, binCount);
+    bins.resize(binCount);
+    fill(bins.begin() + static_cast<long>(firstBin), bins.end(), Bin());
+    rebuiltBins = binCount - firstBin;
+
+    // Each chord lasts until the next one. Give each bin it overlaps the chord, unless another chord
+    // already covers more of that bin.
+    double from = static_cast<double>(firstBin) * binSeconds;
+    size_t i = chords.upperBound(static_cast<float>(from));
+    i = i > 0 ? i - 1 : 0;
+    for (; i < chords.size(); i++)
+    {
+        double start = max(static_cast<double>(chords.getTime(i)), from);
+        double end = i + 1 < chords.size() ? chords.getTime(i + 1) : chords.getTime(i) + lastChordSeconds;
+        if (end <= start)
+            continue;
+        size_t last = min(binCount, static_cast<size_t>(ceil(end / binSeconds)));
+        for (size_t b = static_cast<size_t>(start / binSeconds); b < last; b++)
+        {
+            double binStart = static_cast<double>(b) * binSeconds;
+            float covered = static_cast<float>(min(end, binStart + binSeconds) - max(start, binStart));
+            if (covered > bins[b].coverage)
+                bins[b] = {chords.getChordId(i), covered};
+        }
+    }
+
+    // Each level up from the one below: the chord that covers the most of the two halves
+    size_t level = 1;
+    for (; levels[level - 1].size() > 1; level++)
+    {
+        if (levels.size() <= level)
+            levels.emplace_back();
+        const vector<Bin> &below = levels[level - 1];
+        vector<Bin> &above = levels[level];
+        above.resize((below.size() + 1) / 2);
+        for (size_t b = (firstBin >> level); b < above.size(); b++)
+        {
+            const Bin &left = below[2 * b];
+            Bin right = 2 * b + 1 < below.size() ? below[2 * b + 1] : Bin();
+            if (left.chord == right.chord)
+                above[b] = {left.chord, left.coverage + right.coverage};
+            else
+                above[b] = left.coverage >= right.coverage ? left : right;
+        }
+    }
+    levels.resize(level);
+}
+
+
+/**
+ * @brief The chords to draw for part of the song that is some number of pixels wide. The level used has
+ * bins about a pixel wide (or the finest one, if zoomed in more than that), so this looks at about as many
+ * bins as there are pixels.
+ *
+ * @param start      seconds
+ * @param end        seconds
+ * @param pixels     how wide it is going to be drawn
+ * @param segments   filled in with the chords in time order (the stretches with no chord left out). It is
+ *                   cleared first and can be reused from one call to the next.
+ * @return size_t    how many bins were looked at
+ */
+size_t ChordOverview::getSegments(double start, double end, int pixels, vector<OverviewSegment> &segments) const
+{
+    segments.clear();
+    if (levels.empty() || end <= start || pixels <= 0)
+        return 0;
+
+    double secondsPerPixel = (end - start) / pixels;
+    size_t level = 0;
+    while (level + 1 < levels.size() && binSeconds * static_cast<double>(size_t(1) << level) < secondsPerPixel)
+        level++;
+    const vector<Bin> &bins = levels[level];
+    double width = binSeconds * static_cast<double>(size_t(1) << level);
+
+    size_t first = static_cast<size_t>(max(0.0, start / width));
+    size_t last = min(bins.size(), static_cast<size_t>(ceil(end / width)));
+    for (size_t b = first; b < last; b++)
+    {
+        ChordId chord = bins[b].chord;
+        if (chord == ChordName::noChord)
+            continue;
+        float binStart = static_cast<float>(static_cast<double>(b) * width);
+        float binEnd = static_cast<float>(static_cast<double>(b + 1) * width);
+        if (!segments.empty() && segments.back().chord == chord && segments.back().end == binStart)
+            segments.back().end = binEnd;
+        else
+            segments.push_back({binStart, binEnd, chord});
+    }
+    return last > first ? last - first : 0;
+}
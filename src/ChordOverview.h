@@ -0,0 +1,73 @@
+/**
+ * @file ChordOverview.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include "ChordWindow.h"
+
+using namespace std;
+
+
+// A stretch of the overview where one chord is the one to show (times in seconds)
+struct OverviewSegment
+{
+    float start;
+    float end;
+    ChordId chord;
+};
+
+
+/**
+ * @brief The chords of the whole song at a bunch of different zoom levels (for the overview strip).
+ * @details
+ * The song is cut into bins of binSeconds, and each bin gets the chord that covers the most of it. That is
+ * level 0. Each level above it has bins twice as long, each one made from the two below it, up to a level
+ * with one bin for the whole song. To draw the song (or a part of it) some number of pixels wide, the level
+ * with bins about a pixel wide is used, so the drawing looks at about as many bins as there are pixels, no
+ * matter how many chords there are. A three hour set is about 43K bins at level 0, and all the levels
+ * together are about twice that.
+ *
+ * When the view of the chords changes, it is mostly new chords at the end (recording). Only the bins from
+ * the first chord that changed on are worked out again.
+ */
+class ChordOverview
+{
+public:
+    static constexpr double binSeconds = 0.25;
+    // There is nothing after the last chord to say how long it lasts, so it gets this long
+    static constexpr double lastChordSeconds = 4.0;
+
+    bool update(const ChordSnapshot &snapshot);
+    double getLength() const { return levels.empty() ? 0.0 : static_cast<double>(levels[0].size()) * binSeconds; }
+    int getLevelCount() const { return static_cast<int>(levels.size()); }
+    size_t getBinCount(int level) const { return levels[static_cast<size_t>(level)].size(); }
+    ChordId getBinChord(int level, size_t bin) const { return levels[static_cast<size_t>(level)][bin].chord; }
+    // how many level 0 bins the last update worked out again
+    size_t getRebuiltBinCount() const { return rebuiltBins; }
+
+    size_t getSegments(double start, double end, int pixels, vector<OverviewSegment> &segments) const;
+
+private:
+    struct Bin
+    {
+        ChordId chord = ChordName::noChord;
+        // seconds of the bin that the chord covers
+        float coverage = 0.0f;
+    };
+
+    // levels[0] is the finest
+    vector<vector<Bin>> levels;
+    ChordSnapshot source;
+    size_t rebuiltBins = 0;
+
+    static size_t findFirstChange(const ChordTimeline &before, const ChordTimeline &after);
+    void rebuild(const ChordTimeline &chords, size_t firstBin);
+};
@@ -0,0 +1,170 @@
+/**
+ * @file ChordTimeline.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "ChordTimeline.h"
+#include <cmath>
+#include <limits>
+#include <map>
+
+using namespace std;
+
+
+/**
+ * @brief Lay out the chords (which must be in time order) in columns
+ *
+ * @param chords         time (seconds) and name of each chord
+ * @param indexMinSize   only make the Eytzinger copy of the times if there are at least this many chords
+ */
+ChordTimeline::ChordTimeline(const ChordVectorType &chords, size_t indexMinSize)
+{
+    times.reserve(chords.size());
+    nameIndexes.reserve(chords.size());
+    map<string, uint32_t> nameLookup;
+    for (const auto &chord : chords)
+    {
+        auto found = nameLookup.find(chord.second);
+        if (found == nameLookup.end())
+        {
+            found = nameLookup.insert({chord.second, static_cast<uint32_t>(names.size())}).first;
+            names.push_back(chord.second);
+            nameIds.push_back(ChordName::nameToChordId(chord.second));
+        }
+        times.push_back(chord.first);
+        nameIndexes.push_back(found->second);
+    }
+
+    if (!times.empty() && times.size() >= indexMinSize)
+    {
+        eytzinger.resize(times.size() + 1);
+        eytzingerPositions.resize(times.size() + 1);
+        buildSearchIndex(0, 1);
+    }
+}
+
+
+/**
+ * @private
+ * @brief Fill in the Eytzinger copy of the times. An in-order walk of the (implicit) tree visits the nodes
+ * in sorted order, so the sorted times just get handed out in that order.
+ *
+ * @param position   the next time (in the column) to hand out
+ * @param node       the node of the tree (1 is the root, the children of k are 2k and 2k + 1)
+ * @return size_t    the next time to hand out after this part of the tree
+ */
+size_t ChordTimeline::buildSearchIndex(size_t position, size_t node)
+{
+    if (node < eytzinger.size())
+    {
+        position = buildSearchIndex(position, 2 * node);
+        eytzinger[node] = times[position];
+        eytzingerPositions[node] = static_cast<uint32_t>(position);
+        position = buildSearchIndex(position + 1, 2 * node + 1);
+    }
+    return position;
+}
+
+
+/**
+ * @brief The first chord at or after a time
+ *
+ * @param time
+ * @return size_t   its position (size() if there isn't one)
+ */
+size_t ChordTimeline::lowerBound(float time) const
+{
+    return hasSearchIndex() ? lowerBoundInIndex(time) : lowerBoundInColumn(time);
+}
+
+
+/**
+ * @brief The first chord after a time
+ *
+ * @param time
+ * @return size_t   its position (size() if there isn't one)
+ */
+size_t ChordTimeline::upperBound(float time) const
+{
+    // The first one after time is the first one at or after the very next float
+    return lowerBound(nextafter(time, numeric_limits<float>::infinity()));
+}
+
+
+/**
+ * @brief The same as lowerBound, by a binary search of the time column. The only thing that depends on
+ * the comparison is how far the base moves, which comes out as a conditional move instead of a branch that
+ * gets mispredicted half the time.
+ *
+ * @param time
+ * @return size_t
+ */
+size_t ChordTimeline::lowerBoundInColumn(float time) const
+{
+    size_t count = times.size();
+    if (count == 0)
+        return 0;
+    const float *base = times.data();
+    while (count > 1)
+    {
+        size_t half = count / 2;
+        base = (base[half] < time) ? base + half : base;
+        count -= half;
+    }
+    return static_cast<size_t>(base - times.data()) + (*base < time ? 1 : 0);
+}
+
+
+/**
+ * @brief The same as lowerBound, by going down the Eytzinger copy of the times (which has to be there).
+ * @details
+ * Each step goes to the left (2k) or right (2k + 1) child with no branch. The 16 descendants four levels
+ * down are next to each other (one 64 byte cache line of floats), so they are fetched while the steps in
+ * between are being done. At the end, the node that was the answer is the last one where the search went
+ * left: dropping the trailing right turns (one bits) and then that left turn gets back to it.
+ *
+ * @param time
+ * @return size_t
+ */
+size_t ChordTimeline::lowerBoundInIndex(float time) const
+{
+    const float *tree = eytzinger.data();
+    size_t count = eytzinger.size() - 1;
+    size_t node = 1;
+    while (node <= count)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        if (16 * node < eytzinger.size())
+            __builtin_prefetch(tree + 16 * node);
+#endif
+        node = 2 * node + (tree[node] < time ? 1 : 0);
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    node >>= __builtin_ctzll(~static_cast<unsigned long long>(node)) + 1;
+#else
+    while (node & 1)
+        node >>= 1;
+    node >>= 1;
+#endif
+    return node == 0 ? count : eytzingerPositions[node];
+}
+
+
+/**
+ * @brief Back to time/name pairs (e.g., for the tests or the timeline writer)
+ *
+ * @return ChordVectorType
+ */
+ChordVectorType ChordTimeline::toVector() const
+{
+    ChordVectorType chords;
+    chords.reserve(times.size());
+    for (size_t i = 0; i < times.size(); i++)
+        chords.push_back({times[i], getName(i)});
+    return chords;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file ChordTimeline.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ChordName.h"
+#include "MidiChordsTypes.h"
+
+using namespace std;
+
+
+/**
+ * @brief The (static view of the) chords of a song laid out for looking things up by time.
+ * @details
+ * Instead of a vector of time/name pairs (where searching by time strides over a string header for every
+ * chord), the times are in a column of their own. The names are in a second column as an index into the
+ * handful of distinct names in the song (there are rarely more than a few dozen), along with the ChordId of
+ * each name. For a four hour song at a chord per second the time column is around 56K, which stays in the
+ * L2 cache, where the pairs were well over half a megabyte.
+ *
+ * Finding a time is a binary search on the time column without any branches (the compiler turns the
+ * comparison into a conditional move). There can also be a copy of the times in Eytzinger order (the layout
+ * of a binary heap, with the root first), where the first few levels of every search share the same couple
+ * of cache lines and the next level's children can be prefetched while comparing. In the benchmark (see
+ * chordTimelineTest) the plain search of the column was as fast or faster for everything from four hours of
+ * chords to four million of them, so the Eytzinger copy is only made when asked for.
+ *
+ * Once made, it is never changed (see ChordSnapshot).
+ */
+class ChordTimeline
+{
+public:
+    // Never, by default (see above)
+    static const size_t searchIndexMinSize = SIZE_MAX;
+
+    ChordTimeline() {}
+    explicit ChordTimeline(const ChordVectorType &chords, size_t indexMinSize = searchIndexMinSize);
+
+    size_t size() const { return times.size(); }
+    bool empty() const { return times.empty(); }
+    float getTime(size_t i) const { return times[i]; }
+    const string &getName(size_t i) const { return names[nameIndexes[i]]; }
+    ChordId getChordId(size_t i) const { return nameIds[nameIndexes[i]]; }
+    const vector<float> &getTimes() const { return times; }
+    bool hasSearchIndex() const { return !eytzinger.empty(); }
+
+    size_t lowerBound(float time) const;
+    size_t upperBound(float time) const;
+    size_t lowerBoundInColumn(float time) const;
+    size_t lowerBoundInIndex(float time) const;
+
+    ChordVectorType toVector() const;
+
+private:
+    vector<float> times;
+    vector<uint32_t> nameIndexes;
+    vector<string> names;
+    vector<ChordId> nameIds;
+
+    // The times in Eytzinger order (1 based; 0 is unused) and where each one is in the time column
+    vector<float> eytzinger;
+    vector<uint32_t> eytzingerPositions;
+    size_t buildSearchIndex(size_t position, size_t node);
+};
@@ -0,0 +1,67 @@
+/**
+ * @file ChordTimelineWriter.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "ChordTimelineWriter.h"
+
+using namespace juce;
+using namespace std;
+
+
+/**
+ * @brief The chords as a JSON object
+ * 
+ * @param name     name of the song (usually the file name)
+ * @param chords 
+ * @return String 
+ */
+String ChordTimelineWriter::toJson(const String &name, const vector<pair<float, string>> &chords)
+{
+    String json = "{\"name\": \"" + JSON::escapeString(name) + "\", \"chords\": [";
+    for (size_t i = 0; i < chords.size(); i++)
+    {
+        if (i > 0)
+            json += ",";
+        json += "\n  {\"time\": " + String(chords[i].first, 3) + ", \"chord\": \"" +
+                JSON::escapeString(String(chords[i].second)) + "\"}";
+    }
+    json += chords.empty() ? "]}\n" : "\n]}\n";
+    return json;
+}
+
+
+/**
+ * @brief The chords as CSV with a header line
+ * 
+ * @param chords 
+ * @return String 
+ */
+String ChordTimelineWriter::toCsv(const vector<pair<float, string>> &chords)
+{
+    String csv = "time,chord\n";
+    for (const auto &chord : chords)
+        csv += String(chord.first, 3) + "," + csvField(String(chord.second)) + "\n";
+    return csv;
+}
+
+
+/**
+ * @private
+ * @brief Quote a CSV field if it needs it. None of the chord names have a comma or a quote today, but that
+ * is no reason to write a broken file if one ever does.
+ * 
+ * @param field 
+ * @return String 
+ */
+String ChordTimelineWriter::csvField(const String &field)
+{
+    if (!field.containsAnyOf(",\"\n\r"))
+        return field;
+    return "\"" + field.replace("\"", "\"\"") + "\"";
+}
@@ -0,0 +1,40 @@
+/**
+ * @file ChordTimelineWriter.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace juce;
+using namespace std;
+
+
+/**
+ * @brief Write out a list of chords (time in seconds and name, like the static view) as JSON or CSV.
+ * @details
+ * JSON:
+ *   {"name": "song", "chords": [{"time": 0.0, "chord": "C"}, {"time": 2.0, "chord": "F"}]}
+ * CSV:
+ *   time,chord
+ *   0.000,C
+ *   2.000,F
+ */
+class ChordTimelineWriter
+{
+public:
+    static String toJson(const String &name, const vector<pair<float, string>> &chords);
+    static String toCsv(const vector<pair<float, string>> &chords);
+
+private:
+    static String csvField(const String &field);
+};
@@ -10,6 +10,7 @@
 
 
 #include "ChordView.h"
+#include "FontCache.h"
 #include "ChordName.h"
 #include "ChordClipper.h"
 #include "MidiChordsTypes.h"
@@ -20,7 +21,9 @@ using namespace juce;
 ChordView::ChordView(MidiStore &ms) : chordClipper(ms), midiState(ms)
 {
     setFramesPerSecond(60);
-    this->symbolFontAvailable = this->checkForBravura();
+    // Finding out if the music symbol font is there is slow, so it is done in the background (and only once
+    // for all the editors). Until then the flats and sharps are plain letters.
+    FontCache::getInstance().probeAsync(workerPool);
 }
 
 
@@ -30,6 +33,7 @@ void ChordView::update()
     // in the constructor. You can use it to update counters, animate values, etc.
 
     chordClipper.updateCurrentPosition(getMillisecondsSinceLastUpdate());
+    this->updateDisplayList();
 }
 
 void ChordView::paint(juce::Graphics &g)
@@ -41,173 +45,187 @@ void ChordView::paint(juce::Graphics &g)
     g.setColour(juce::Colours::black);
     // Need to figure out how to make this thing draw its own border
     g.drawRect(getLocalBounds(), 1);
-    MeasurePositionType bars = chordClipper.getMeasuresToDisplay();
-    this->drawMeasures(bars, g);
+
+    // Everything but the "now" marker comes from the display list. If the size or zoom has changed since it
+    // was made, it is stretched to fit until the new one is ready.
+    shared_ptr<const ChordDisplayList> list;
+    {
+        const ScopedLock lock(displayListLock);
+        list = this->displayList;
+    }
+    float ratio = static_cast<float>(getWidth()) / chordClipper.getViewWidthInSeconds();
+    float offset = chordClipper.getViewWindowSize().first * ratio;
+    float scale = 1.0f;
+    if (list && list->getSettings().getPixelsPerSecond() > 0.0f)
+        scale = ratio / list->getSettings().getPixelsPerSecond();
+
+    if (list)
+        this->drawMeasures(*list, offset, scale, g);
 
     // Draw the "now" marker
     int x = static_cast<int>(static_cast<float>(getWidth()) * chordClipper.getCurrentNotePosition() / chordClipper.getViewWidthInSeconds());
     g.setColour(juce::Colours::red);
-    // double thickness ... draw it twice. Maybe there is a better way, but this works
+    g.drawVerticalLine(x - 1, 0, static_cast<float>(getHeight()));
     g.drawVerticalLine(x, 0, static_cast<float>(getHeight()));
     g.drawVerticalLine(x + 1, 0, static_cast<float>(getHeight()));
 
     g.setColour(juce::Colours::black);
-    ChordVectorType chords = chordClipper.getChordsToDisplay();
-    this->drawChords(chords, g);
+    if (list)
+        this->drawChords(*list, offset, scale, g);
 }
 
 
 /**
- * @brief Draw the vertical bars to represent the measures
+ * @brief What the display list needs to be made for right now
  * 
- * @param bars 
- * @param g 
+ * @param chords   the current view of the chords
+ * @return DisplaySettings 
  */
-void ChordView::drawMeasures(MeasurePositionType bars, juce::Graphics &g)
+DisplaySettings ChordView::getDisplaySettings(const ChordSnapshot &chords)
 {
-    auto area = getLocalBounds();
-    juce::Rectangle<float> textBox;
-    textBox = area.toFloat();
-    // Compute width of hash marks between measurers to mark the beats
-    optional<int> bpMeasure = midiState.getBPMeasure();
-    float beatWidth = 1.0;
-    if (bars.size() > 1) 
-        beatWidth = ((bars.begin() + 1)->second - bars.begin()->second) / static_cast<float>(*bpMeasure);
-    
-
-    textBox.setTop(5);
-    float ratio = static_cast<float>(getWidth()) / chordClipper.getViewWidthInSeconds();
-    beatWidth *= ratio;
-    g.setFont(juce::Font(juce::FontOptions{}.withHeight(15.0f)));
-    for (MeasurePositionType::iterator it = bars.begin(); it != bars.end(); ++it)
+    DisplaySettings settings;
+    settings.width = getWidth();
+    settings.height = getHeight();
+    settings.viewSeconds = chordClipper.getViewWidthInSeconds();
+    settings.fontSize = static_cast<int>(midiState.getChordNameSize());
+    if (!this->symbolFontAvailable)
     {
-        float xPos = it->second * ratio;
-        g.drawVerticalLine(static_cast<int>(xPos), 0, static_cast<float>(getHeight()));
-        // hash marks for beats in the measure
-        for (int i = 1; i < *bpMeasure; i++)
-            g.drawVerticalLine(static_cast<int>(xPos + static_cast<float>(i) * beatWidth), 0, 20);
-
-        // draw in measure number
-        textBox.setLeft(xPos + 5);
-        g.drawText(to_string(it->first), textBox, juce::Justification::topLeft);
+        // If the lookup this view started was dropped (another editor that started it first was closed
+        // before it ran), start it again here. It's just a compare and exchange if it's running or done.
+        FontCache::getInstance().probeAsync(workerPool);
+        this->symbolFontAvailable = FontCache::getInstance().hasTypeface("Bravura Text");
     }
-
-    // Hack - draw beat hashes for the first bar where the measure bar is not visible
-    if (bars.begin() != bars.end()) 
-    {
-        float xPos = bars.begin()->second * ratio;
-        for (int i = 1; i < *bpMeasure; i++)
-            g.drawVerticalLine(static_cast<int>(xPos - static_cast<float>(i) * beatWidth), 0, 20);
-    }
-
-
+    settings.symbolFont = this->symbolFontAvailable.value_or(false);
+
+    // The bar lines go a bit past the last chord or the window (whichever is further). It is rounded up to a
+    // whole minute so that playing on past the end of the song only needs a new list once a minute.
+    double end = chordClipper.getViewWindowSize().second;
+    if (!chords->empty())
+        end = jmax(end, static_cast<double>(chords->getTime(chords->size() - 1)));
+    settings.measuresEnd = ceil((end + settings.viewSeconds) / 60.0) * 60.0;
+    return settings;
 }
 
+
 /**
- * @brief Draw the given set of chords onto the graphics area
- * TODO: This really needs a unit test. And that (kind of) requires that I get mocks working
- * 
- * @param chords   map of chords by time relative to the window
- * @param g 
+ * @brief Start building a new display list on the worker pool if anything it depends on has changed (the
+ * chords, the bar lines, the size, zoom or font size). Only one is built at a time; if things change again
+ * while it is being built, the next frame after it is done starts another.
  */
-void ChordView::drawChords(vector<pair<float, string>> chords, juce::Graphics &g)
+void ChordView::updateDisplayList()
 {
-    // map<float, string>::iterator it;
-    auto area = getLocalBounds();
-    juce::Rectangle<float> textBox;
-    textBox = area.toFloat();
-    float spacer = 2.0f;
-    float ratio = textBox.getWidth() / chordClipper.getViewWidthInSeconds();
-    ChordName cn;
-
-    int fontSize = static_cast<int>(midiState.getChordNameSize());
-    g.setFont(juce::Font(juce::FontOptions{}.withHeight(static_cast<float>(fontSize))));
-    Font defaultFont = g.getCurrentFont();
-    defaultFont.setExtraKerningFactor(static_cast<float>(-0.05));
-    Font symbolFont(juce::FontOptions{}.withName("Bravura Text").withHeight(static_cast<float>(fontSize)).withStyle("Regular"));
-
-    for (auto it = chords.begin(); it != chords.end(); ++it)
+    ChordSnapshot chords = midiState.getViewSnapshot();
+    const TempoMap &measures = chordClipper.getMeasureGrid();
+    int measureGeneration = chordClipper.getMeasureGridGeneration();
+    DisplaySettings settings = this->getDisplaySettings(chords);
+    if (this->displayListPending || settings.width <= 0 ||
+        (chords == requestedChords && measureGeneration == requestedMeasureGeneration && settings == requestedSettings))
+        return;
+
+    this->requestedChords = chords;
+    this->requestedMeasureGeneration = measureGeneration;
+    this->requestedSettings = settings;
+    if (settings.fontSize != this->fontSize)
+    {
+        this->fontSize = settings.fontSize;
+        this->chordFont = juce::Font(juce::FontOptions{}.withHeight(static_cast<float>(fontSize)));
+        this->symbolFont = juce::Font(juce::FontOptions{}.withName("Bravura Text").withHeight(static_cast<float>(fontSize)).withStyle("Regular"));
+    }
+
+    // The job gets its own copies of everything (the clipper's measure grid can change while it runs)
+    this->displayListPending = true;
+    workerPool.addJob([this, chords, measures, settings, textFont = this->chordFont, musicFont = this->symbolFont]
     {
-        float leftPos = it->first * ratio;
-        textBox.setLeft(leftPos);
-        if (!this->symbolFontAvailable || !nameHasSymbols(it->second))
+        auto measure = [&](const string &text, bool isSymbol)
         {
-            // no sharp/flat so we can just draw it with the default font
-            g.drawText(it->second, textBox, juce::Justification::centredLeft);
-        }
-        else
+            return juce::GlyphArrangement::getStringWidth(isSymbol ? musicFont : textFont, String(text));
+        };
+        shared_ptr<const ChordDisplayList> list = ChordDisplayList::build(chords, measures, settings, measure);
         {
-            // There is at least one symbol (e.g., a flat) to draw in a separate font. This seems like
-            // a horrible kludge. There has to be a cleaner way to do this, but it is escaping me at the moment.
-            // So loop through and draw the symbols in the bravura font and the others in the default font
-            string sPart = "";
-            for (auto c = it->second.begin(); c != it->second.end(); ++c)
-            {
-                optional<string> symbol = cn.getUnicodeSymbol(*c);
-                if (symbol != std::nullopt)
-                {
-                    if (sPart != "") {
-                        // Draw what we have collected so far
-                        g.drawText(sPart, textBox, juce::Justification::centredLeft);
-                        textBox.setX(textBox.getX() + juce::GlyphArrangement::getStringWidth(defaultFont, sPart) + spacer);
-                        sPart = "";
-                    }
-                    // switch to the symbol font, draw the symbol and switch back
-                    g.setFont(symbolFont);
-                    g.drawText(*symbol, textBox, juce::Justification::centredLeft);
-                    textBox.setX(textBox.getX() + juce::GlyphArrangement::getStringWidth(symbolFont, *symbol) + spacer);
-                    g.setFont(defaultFont);
-                }
-                else
-                {
-                    sPart += {*c};
-                }
-            }
-            // Draw remainder if there is any
-            if (sPart != "") {
-                g.drawText(sPart, textBox, juce::Justification::centredLeft);
-            }
+            const ScopedLock lock(displayListLock);
+            this->displayList = list;
         }
-    }
+        this->displayListPending = false;
+    });
 }
 
 
 /**
- * @brief Determine if a given chord has symbols that need to be mapped to a different
- * font for display purposes
+ * @brief Draw the vertical bars to represent the measures (and the beats in them)
  * 
- * @param string chord 
- * @return bool  true if it has one or more to be mapped, false if not
+ * @param list     display list to draw from
+ * @param offset   where the left side of the window is (in the list's pixels, after scaling)
+ * @param scale    list pixels to window pixels
+ * @param g 
  */
-bool ChordView::nameHasSymbols(string chord)
+void ChordView::drawMeasures(const ChordDisplayList &list, float offset, float scale, juce::Graphics &g)
 {
-    if (chord.find('b') != string::npos || chord.find('#') != string::npos)
-        return true;
-    else
-        return false;
+    const vector<DisplayCommand> &commands = list.getMeasureCommands();
+    float width = static_cast<float>(getWidth());
+    float height = static_cast<float>(getHeight());
+    g.setFont(juce::Font(juce::FontOptions{}.withHeight(15.0f)));
 
+    // Start a little to the left so the number of a bar just out of view is still drawn
+    for (size_t i = ChordDisplayList::findFirst(commands, (offset - 40.0f) / scale); i < commands.size(); i++)
+    {
+        const DisplayCommand &command = commands[i];
+        float x = command.x * scale - offset;
+        if (x > width)
+            break;
+        if (command.kind == DisplayCommand::barLine)
+            g.drawVerticalLine(static_cast<int>(x), 0, height);
+        else if (command.kind == DisplayCommand::beatHash)
+            g.drawVerticalLine(static_cast<int>(x), 0, 20);
+        else if (command.kind == DisplayCommand::measureNumber)
+            g.drawText(list.getText(command.text), juce::Rectangle<float>(x, 5.0f, jmax(0.0f, width - x), height - 5.0f),
+                       juce::Justification::topLeft);
+    }
 }
 
 
 /**
- * @brief Determine if the font that supports the flat/sharp symbols is available. This seems a bad way to do
- * this, but I can't figure out how to simply check for a given font. So readm them all once. This only gets
- * called once each time the plugin editor is loaded, so it doesn't suck too much.
+ * @brief Draw the chord names onto the graphics area
  * 
- * @return bool  return true if bravura text appears to exist
+ * @param list     display list to draw from
+ * @param offset   where the left side of the window is (in the list's pixels, after scaling)
+ * @param scale    list pixels to window pixels
+ * @param g 
  */
-bool ChordView::checkForBravura()
+void ChordView::drawChords(const ChordDisplayList &list, float offset, float scale, juce::Graphics &g)
 {
-    // try to figure out if the Bravura font is installed
-    juce::StringArray fonts = Font::findAllTypefaceNames();
-    for (auto it = fonts.begin(); it != fonts.end(); ++it)
+    const vector<DisplayCommand> &commands = list.getChordCommands();
+    float width = static_cast<float>(getWidth());
+    float height = static_cast<float>(getHeight());
+    g.setFont(this->chordFont);
+    bool inSymbolFont = false;
+
+    // The rows the names were spread over are stacked in the middle (one row is right in the middle, like before)
+    float rowHeight = height / static_cast<float>(ChordDisplayList::getRowsThatFit(list.getSettings()));
+    if (list.getRowCount() > 1)
+        rowHeight = jmin(rowHeight, static_cast<float>(list.getSettings().fontSize) * 1.2f);
+    float top = (height - rowHeight * static_cast<float>(list.getRowCount())) / 2.0f;
+
+    // A name that starts left of the window can still reach into it
+    for (size_t i = ChordDisplayList::findFirst(commands, (offset - list.getMaxTextWidth()) / scale); i < commands.size(); i++)
     {
-        if (*it == "Bravura Text")
-            return true;
+        const DisplayCommand &command = commands[i];
+        float x = command.x * scale - offset;
+        if (x > width)
+            break;
+        // The flats and sharps are in the music symbol font
+        bool isSymbol = command.kind == DisplayCommand::symbolText;
+        if (isSymbol != inSymbolFont)
+        {
+            g.setFont(isSymbol ? this->symbolFont : this->chordFont);
+            inSymbolFont = isSymbol;
+        }
+        float y = top + rowHeight * static_cast<float>(command.row);
+        g.drawText(list.getText(command.text), juce::Rectangle<float>(x, y, jmax(0.0f, width - x), rowHeight),
+                   juce::Justification::centredLeft);
     }
-    return false;
 }
 
+
 void ChordView::resized()
 {
 }
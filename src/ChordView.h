@@ -19,6 +19,8 @@
 
 #include "MidiStore.h"
 #include "ChordClipper.h"
+#include "ChordDisplayList.h"
+#include "WorkerPool.h"
 
 using namespace std;
 
@@ -39,15 +41,36 @@ public:
 
     void mouseWheelMove(const MouseEvent &event, const MouseWheelDetails &wheel) override;
 
+    // start and end (seconds) of what is showing
+    ViewWindowType getViewWindow() { return chordClipper.getViewWindowSize(); }
+    // True while a new display list is being built (e.g., the render tests wait for it before painting)
+    bool isDisplayListPending() const { return displayListPending; }
+
 private:
-    // flag that indicates if the bravura font available (for flat/sharp symbols)
-    bool symbolFontAvailable = false;
+    // is the bravura font available (for flat/sharp symbols)? Not known until the font cache is ready.
+    optional<bool> symbolFontAvailable;
     ChordClipper chordClipper;
     MidiStore &midiState;
-    void drawChords(ChordVectorType chords, juce::Graphics &g);
-    void drawMeasures(MeasurePositionType bars, juce::Graphics &g);
-    bool nameHasSymbols(string chord);
-    bool checkForBravura();
+
+    // What paint draws from. It is built on the worker pool (see updateDisplayList) and swapped in under the lock.
+    shared_ptr<const ChordDisplayList> displayList;
+    CriticalSection displayListLock;
+    atomic<bool> displayListPending {false};
+    // what the most recent one was built from
+    ChordSnapshot requestedChords;
+    int requestedMeasureGeneration = -1;
+    DisplaySettings requestedSettings;
+    int fontSize = 0;
+    juce::Font chordFont {juce::FontOptions{}};
+    juce::Font symbolFont {juce::FontOptions{}};
+
+    void updateDisplayList();
+    DisplaySettings getDisplaySettings(const ChordSnapshot &chords);
+    void drawChords(const ChordDisplayList &list, float offset, float scale, juce::Graphics &g);
+    void drawMeasures(const ChordDisplayList &list, float offset, float scale, juce::Graphics &g);
+
+    // Last, so it goes first: that waits for a display list build that is running (it uses the above)
+    WorkerPool::Client workerPool;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ChordView)
 };
@@ -0,0 +1,86 @@
+/**
+ * @file ChordWindow.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "ChordTimeline.h"
+
+using namespace std;
+
+
+// One version of the static view of the chords. Once made, it is never changed; a new view is a new snapshot.
+typedef shared_ptr<const ChordTimeline> ChordSnapshot;
+
+
+/**
+ * @brief A range of the chords in a snapshot of the view (e.g., the ones in the visible window).
+ * @details
+ * This is just the positions of the first and last (plus one) chords in the snapshot plus a reference to
+ * the snapshot itself, which keeps it alive for as long as the window is around even if the store moves on
+ * to a new view in the meantime. Making one (or copying one) doesn't copy any of the chords and doesn't
+ * allocate anything.
+ *
+ * Going through it gives a Chord for each one: the time and a reference to the name, so it reads like the
+ * time/name pairs it used to be (chord.first, it->second). The times are the absolute times in the song; it
+ * is up to the user to offset them to wherever they go.
+ */
+class ChordWindow
+{
+public:
+    struct Chord
+    {
+        float first;
+        const string &second;
+    };
+
+    class const_iterator
+    {
+    public:
+        // it->first needs something to point at, so the arrow hands back a Chord that does
+        struct Arrow
+        {
+            Chord chord;
+            const Chord *operator->() const { return &chord; }
+        };
+
+        const_iterator(const ChordTimeline *chords, size_t position) : timeline(chords), index(position) {}
+        Chord operator*() const { return {timeline->getTime(index), timeline->getName(index)}; }
+        Arrow operator->() const { return {**this}; }
+        const_iterator &operator++() { ++index; return *this; }
+        const_iterator &operator--() { --index; return *this; }
+        bool operator==(const const_iterator &other) const { return index == other.index; }
+        bool operator!=(const const_iterator &other) const { return index != other.index; }
+
+    private:
+        const ChordTimeline *timeline;
+        size_t index;
+    };
+
+    ChordWindow() {}
+    ChordWindow(ChordSnapshot chords, size_t begin, size_t end)
+        : snapshot(std::move(chords)), first(begin), last(end) {}
+
+    const_iterator begin() const { return const_iterator(snapshot.get(), first); }
+    const_iterator end() const { return const_iterator(snapshot.get(), last); }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    Chord operator[](size_t i) const { return *const_iterator(snapshot.get(), first + i); }
+    // where the window is in the snapshot
+    size_t getFirstIndex() const { return first; }
+    size_t getLastIndex() const { return last; }
+    const ChordSnapshot &getSnapshot() const { return snapshot; }
+
+private:
+    ChordSnapshot snapshot;
+    size_t first = 0;
+    size_t last = 0;
+};
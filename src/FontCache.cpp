@@ -0,0 +1,122 @@
+/**
+ * @file FontCache.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "FontCache.h"
+#include <algorithm>
+
+using namespace std;
+using namespace juce;
+
+
+/**
+ * @brief The one for the whole process (it is shared by all the plugin instances)
+ *
+ * @return FontCache&
+ */
+FontCache &FontCache::getInstance()
+{
+    static FontCache instance;
+    return instance;
+}
+
+
+/**
+ * @brief Start looking up the fonts on the worker pool, unless that has been done (or is being done)
+ * already. If the client goes away before the job gets to run (e.g., the editor was closed right away),
+ * the job is dropped, and the next call starts it again.
+ *
+ * @param client   whose worker pool handle to run it on
+ */
+void FontCache::probeAsync(WorkerPool::Client &client)
+{
+    int expected = notStarted;
+    if (!state.compare_exchange_strong(expected, probing))
+        return;
+
+    // If the job is dropped without running, this goes with it and puts things back to not started
+    struct NotRun
+    {
+        FontCache &cache;
+        bool ran = false;
+        NotRun(FontCache &c) : cache(c) {}
+        ~NotRun()
+        {
+            if (!ran)
+                cache.state = notStarted;
+        }
+    };
+    auto notRun = make_shared<NotRun>(*this);
+    client.addJob([this, notRun]
+    {
+        notRun->ran = true;
+        this->runProbe();
+    });
+}
+
+
+/**
+ * @brief Is the font installed?
+ *
+ * @param name   the typeface name (e.g., "Bravura Text")
+ * @return optional<bool>  nullopt if the fonts haven't been looked up yet
+ */
+optional<bool> FontCache::hasTypeface(const String &name) const
+{
+    if (state != ready)
+        return nullopt;
+    return binary_search(typefaces.begin(), typefaces.end(), name);
+}
+
+
+/**
+ * @brief Wait for the fonts to be looked up (e.g., for tests and benchmarks)
+ *
+ * @param timeoutMs   -1 to wait as long as it takes
+ * @return bool  true if they are ready
+ */
+bool FontCache::waitUntilReady(int timeoutMs) const
+{
+    if (isReady())
+        return true;
+    return readyEvent.wait(timeoutMs) && isReady();
+}
+
+
+/**
+ * @brief For testing: forget what was found so the next probeAsync does it all again
+ *
+ * @param testProbe   where the font names come from (nullptr for the installed fonts)
+ */
+void FontCache::reset(Probe testProbe)
+{
+    // Not while a probe is running (it would write the list out from under us)
+    if (state == probing)
+        readyEvent.wait(-1);
+    this->probe = testProbe;
+    this->typefaces.clear();
+    readyEvent.reset();
+    state = notStarted;
+}
+
+
+/**
+ * @private
+ * @brief Get the names of all the fonts (the slow part) and let everyone know they're ready
+ */
+void FontCache::runProbe()
+{
+    StringArray names = probe ? probe() : Font::findAllTypefaceNames();
+    // Sorted, so a lookup is a binary search
+    names.removeDuplicates(false);
+    names.sort(false);
+    this->typefaces = std::move(names);
+    state = ready;
+    readyEvent.signal();
+}
@@ -0,0 +1,66 @@
+/**
+ * @file FontCache.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <juce_graphics/juce_graphics.h>
+#include <atomic>
+#include <optional>
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+/**
+ * @brief Which fonts are installed, looked up once for the whole process.
+ * @details
+ * The only way I found to tell if a font (e.g., Bravura Text for the flat and sharp symbols) is there is to
+ * get the names of all of them and look. On a machine with thousands of fonts that is slow, and it used to
+ * be done every time an editor was opened, on the message thread. Now the first editor that opens starts
+ * it on the worker pool and every editor after that (in any plugin instance) just looks in the list.
+ *
+ * Until the list is ready, hasTypeface says it doesn't know, and the view draws with what it has (e.g.,
+ * plain "b" and "#" for the flats and sharps).
+ */
+class FontCache
+{
+public:
+    // Gets the names of the installed fonts (Font::findAllTypefaceNames, unless a test says otherwise)
+    typedef function<juce::StringArray()> Probe;
+
+    static FontCache &getInstance();
+
+    void probeAsync(WorkerPool::Client &client);
+    optional<bool> hasTypeface(const juce::String &name) const;
+    bool isReady() const { return state == ready; }
+    bool waitUntilReady(int timeoutMs) const;
+
+    // For testing: forget the fonts (so the next probe is a cold one), and where they come from
+    void reset(Probe probe = nullptr);
+
+private:
+    enum State
+    {
+        notStarted,
+        probing,
+        ready
+    };
+
+    atomic<int> state {notStarted};
+    // Only written before state goes to ready (and by reset), so it is safe to read once ready
+    juce::StringArray typefaces;
+    Probe probe;
+    juce::WaitableEvent readyEvent {true};
+
+    FontCache() = default;
+    void runProbe();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FontCache)
+};
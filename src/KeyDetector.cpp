@@ -0,0 +1,165 @@
+/**
+ * @file KeyDetector.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "KeyDetector.h"
+#include <cmath>
+
+using namespace std;
+
+
+/**
+ * @brief Construct a new key detector
+ *
+ * @param window   how far back (in seconds) the notes count toward the key
+ */
+KeyDetector::KeyDetector(double window) : windowSeconds(window), segments(maxSegments)
+{
+}
+
+
+/**
+ * @brief Forget everything that has been seen
+ */
+void KeyDetector::reset()
+{
+    firstSegment = 0;
+    segmentCount = 0;
+    currentClasses = 0;
+    hasCurrent = false;
+    scores.fill(0.0);
+}
+
+
+/**
+ * @brief Feed the next event through. The notes that were on since the previous event get credit for the
+ * time in between, and anything that has fallen out of the window is taken back out.
+ *
+ * @param seconds   time of the event. Events are expected in time order; one that goes backwards starts over
+ * @param notes     the notes that are on as of this event
+ */
+void KeyDetector::addEvent(double seconds, const NoteSet &notes)
+{
+    if (hasCurrent && seconds < currentStart)
+        reset();
+
+    if (hasCurrent && currentClasses != 0 && seconds > currentStart)
+    {
+        if (segmentCount == maxSegments)
+            dropSegment();
+        double weight = seconds - currentStart;
+        segments[(firstSegment + segmentCount) % maxSegments] = {seconds, currentClasses, weight};
+        segmentCount++;
+        addToScores(currentClasses, weight);
+    }
+
+    // Slide the window along. A segment counts until it has completely left the window
+    while (segmentCount > 0 && segments[firstSegment].endSeconds <= seconds - windowSeconds)
+        dropSegment();
+
+    currentClasses = static_cast<uint16_t>(notes.pitchClasses());
+    currentStart = seconds;
+    hasCurrent = true;
+}
+
+
+/**
+ * @brief The best fit for the notes in the window
+ *
+ * @return int   0-11 major keys (C = 0), 12-23 minor keys; noKey if there isn't anything to go on
+ */
+int KeyDetector::getKey() const
+{
+    int best = noKey;
+    double bestScore = 1e-9;
+    for (int key = 0; key < keyCount; key++)
+    {
+        if (scores[static_cast<size_t>(key)] > bestScore)
+        {
+            bestScore = scores[static_cast<size_t>(key)];
+            best = key;
+        }
+    }
+    return best;
+}
+
+
+/**
+ * @private
+ * @brief Add (or with a negative weight, remove) the pitch classes' share of each key's score
+ */
+void KeyDetector::addToScores(uint16_t pitchClasses, double weight)
+{
+    const array<array<double, keyCount>, 12> &table = profileTable();
+    for (size_t pc = 0; pc < 12; pc++)
+    {
+        if ((pitchClasses & (1 << pc)) == 0)
+            continue;
+        for (size_t key = 0; key < keyCount; key++)
+            scores[key] += weight * table[pc][key];
+    }
+}
+
+
+/**
+ * @private
+ * @brief Take the oldest segment out of the window
+ */
+void KeyDetector::dropSegment()
+{
+    const Segment &oldest = segments[firstSegment];
+    addToScores(oldest.pitchClasses, -oldest.weight);
+    firstSegment = (firstSegment + 1) % maxSegments;
+    segmentCount--;
+    // Start again from a clean slate whenever it empties so that rounding errors don't pile up
+    if (segmentCount == 0)
+        scores.fill(0.0);
+}
+
+
+/**
+ * @private
+ * @brief How much one pitch class counts toward each key: the key's profile value for that pitch class.
+ * @details
+ * The profiles are centered (the mean taken out) and scaled to unit length. The score for a key is then
+ * the histogram dotted with its profile, which picks the same key as correlating the two would (the
+ * histogram's own mean and length are the same for every key, so they don't change which one wins).
+ *
+ * @return const array<array<double, 24>, 12>&   [pitch class][key]
+ */
+const array<array<double, KeyDetector::keyCount>, 12> &KeyDetector::profileTable()
+{
+    static const array<array<double, keyCount>, 12> table = []
+    {
+        // Krumhansl-Kessler key profiles, starting from the tonic
+        const double major[12] = {6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88};
+        const double minor[12] = {6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17};
+
+        array<array<double, keyCount>, 12> entries {};
+        for (const double *profile : {major, minor})
+        {
+            double mean = 0.0;
+            for (int i = 0; i < 12; i++)
+                mean += profile[i] / 12.0;
+            double length = 0.0;
+            for (int i = 0; i < 12; i++)
+                length += (profile[i] - mean) * (profile[i] - mean);
+            length = sqrt(length);
+
+            size_t firstKey = profile == major ? 0 : 12;
+            for (size_t tonic = 0; tonic < 12; tonic++)
+            {
+                for (size_t pc = 0; pc < 12; pc++)
+                    entries[pc][firstKey + tonic] = (profile[(pc + 12 - tonic) % 12] - mean) / length;
+            }
+        }
+        return entries;
+    }();
+    return table;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file KeyDetector.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "NoteSet.h"
+
+using namespace std;
+
+
+/**
+ * @brief Estimate the key of the music from the notes that have been played recently.
+ * @details
+ * The note events are fed through in time order (e.g., while the static view is built). Each pitch class
+ * gets credit for how long it sounded, summed over a sliding window of time (a histogram). The key is the
+ * one of the 24 major and minor keys whose profile (Krumhansl-Kessler) fits that histogram best.
+ *
+ * Nothing gets recomputed from scratch as the window slides. The pieces of the histogram are kept in a
+ * ring buffer, and when a piece enters or leaves the window its pitch classes are added to (or taken away
+ * from) the running score of each key with a 12x24 table. So an event costs the same no matter how long
+ * the window is or how many notes came before it.
+ *
+ * Keys are numbered 0-11 for C major through B major and 12-23 for C minor through B minor.
+ */
+class KeyDetector
+{
+public:
+    static constexpr int noKey = -1;
+    static constexpr int keyCount = 24;
+
+    KeyDetector(double window = 10.0);
+
+    void addEvent(double seconds, const NoteSet &notes);
+    int getKey() const;
+    void reset();
+
+    static bool isMinorKey(int key) { return key >= 12; }
+    static int keyTonic(int key) { return key % 12; }
+
+private:
+    // A stretch of time where a set of pitch classes was sounding
+    struct Segment
+    {
+        double endSeconds;
+        uint16_t pitchClasses;
+        double weight;
+    };
+
+    // room for this many segments in the window; if it fills up, the oldest ones go early
+    static constexpr size_t maxSegments = 512;
+
+    double windowSeconds;
+    vector<Segment> segments;
+    size_t firstSegment = 0;
+    size_t segmentCount = 0;
+
+    // the notes that are sounding since the last event
+    uint16_t currentClasses = 0;
+    double currentStart = 0.0;
+    bool hasCurrent = false;
+
+    array<double, keyCount> scores {};
+
+    void addToScores(uint16_t pitchClasses, double weight);
+    void dropSegment();
+    static const array<array<double, keyCount>, 12> &profileTable();
+};
@@ -0,0 +1,120 @@
+/**
+ * @file MidiFileImporter.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "MidiFileImporter.h"
+#include <algorithm>
+
+using namespace juce;
+using namespace std;
+
+
+/**
+ * @brief Read a .mid file and add its notes to the store
+ * 
+ * @param file 
+ * @param store    should be empty (or at least not have anything at the same times)
+ * @param error    set to the reason if it fails
+ * @return bool    false if the file couldn't be read
+ */
+bool MidiFileImporter::importFile(const File &file, MidiStore &store, String &error)
+{
+    FileInputStream stream(file);
+    if (!stream.openedOk())
+    {
+        error = "cannot open " + file.getFullPathName();
+        return false;
+    }
+
+    MidiFile midiFile;
+    if (!midiFile.readFrom(stream))
+    {
+        error = "not a valid MIDI file: " + file.getFullPathName();
+        return false;
+    }
+
+    store.setName(file.getFileNameWithoutExtension());
+    importMidiFile(midiFile, store);
+    return true;
+}
+
+
+/**
+ * @brief Add the notes (and tempo and meter) of a MIDI file to the store
+ * 
+ * @param midiFile   with the times in ticks (as it is after reading it)
+ * @param store 
+ */
+void MidiFileImporter::importMidiFile(const MidiFile &midiFile, MidiStore &store)
+{
+    struct NoteEvent
+    {
+        double seconds;
+        double ppq;
+        int note;
+        bool isOn;
+    };
+
+    // SMPTE time (a negative time format) has no beats, so there is no PPQ to go with the events
+    short timeFormat = midiFile.getTimeFormat();
+    bool hasPpq = timeFormat > 0;
+    double ticksPerQuarter = hasPpq ? timeFormat : 1.0;
+
+    MidiFile timed(midiFile);
+    timed.convertTimestampTicksToSeconds();
+
+    vector<NoteEvent> notes;
+    vector<pair<double, double>> tempos;     // ppq, bpm
+    double lastPpq = 0.0;
+    for (int track = 0; track < midiFile.getNumTracks(); track++)
+    {
+        const MidiMessageSequence *ticks = midiFile.getTrack(track);
+        const MidiMessageSequence *seconds = timed.getTrack(track);
+        for (int i = 0; i < ticks->getNumEvents(); i++)
+        {
+            const MidiMessage &message = ticks->getEventPointer(i)->message;
+            double ppq = message.getTimeStamp() / ticksPerQuarter;
+            lastPpq = jmax(lastPpq, ppq);
+            if (message.isTempoMetaEvent() && hasPpq)
+                tempos.push_back({ppq, 60.0 / message.getTempoSecondsPerQuarterNote()});
+            else if (message.isTimeSignatureMetaEvent() && hasPpq)
+            {
+                int numerator, denominator;
+                message.getTimeSignatureInfo(numerator, denominator);
+                store.recordMeter(ppq, numerator, denominator);
+            }
+            else if ((message.isNoteOn() || message.isNoteOff()) && message.getChannel() != drumChannel)
+                notes.push_back({seconds->getEventPointer(i)->message.getTimeStamp(), ppq,
+                                 message.getNoteNumber(), message.isNoteOn()});
+        }
+    }
+
+    // Each tempo lasts until the next one. A file with no tempo at the start is 120 until the first one.
+    stable_sort(tempos.begin(), tempos.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    if (hasPpq && (tempos.empty() || tempos.front().first > 0.0))
+        tempos.insert(tempos.begin(), {0.0, 120.0});
+    for (size_t i = 0; i < tempos.size(); i++)
+    {
+        double end = i + 1 < tempos.size() ? tempos[i + 1].first : lastPpq;
+        store.recordTempo(tempos[i].first, end, tempos[i].second);
+    }
+
+    // The store wants them in time order (anything else is slow to insert). The sort is stable so that a
+    // note off and on at the same time on the same track keep their order.
+    stable_sort(notes.begin(), notes.end(), [](const NoteEvent &a, const NoteEvent &b) { return a.seconds < b.seconds; });
+    store.setSampleRate(sampleRate);
+    for (const NoteEvent &event : notes)
+    {
+        int64 time = static_cast<int64>(std::llround(event.seconds * sampleRate));
+        store.addNoteEventAtTime(time, event.note, event.isOn);
+        store.setEventTimeSeconds(time, event.seconds);
+        if (hasPpq)
+            store.setEventTimePpq(time, event.ppq);
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * @file MidiFileImporter.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "MidiStore.h"
+
+using namespace juce;
+using namespace std;
+
+
+/**
+ * @brief Load a standard MIDI file into a MidiStore, as if the whole thing had been played through the plugin.
+ * @details
+ * The plugin gets its events from the host one block at a time, with the time in samples, seconds and PPQ.
+ * A file has all of that up front: the ticks give the PPQ, and the tempo events give the seconds (and the
+ * tempo map). The "samples" the store uses to identify events are made up from the seconds at a fixed
+ * sample rate, so the quantization works the same as it does in a DAW.
+ *
+ * All the tracks are merged. Channel 10 is skipped since it is drums in General MIDI files, and drum notes
+ * make for some very odd chords.
+ */
+class MidiFileImporter
+{
+public:
+    // the pretend sample rate for the event times
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int drumChannel = 10;
+
+    static bool importFile(const File &file, MidiStore &store, String &error);
+    static void importMidiFile(const MidiFile &midiFile, MidiStore &store);
+};
@@ -11,6 +11,9 @@
 
 #include "MidiStore.h"
 #include "ChordName.h"
+#include "KeyDetector.h"
+#include "ArpeggioWindow.h"
+#include "ChordChangeFilter.h"
 #include "MidiChordsTypes.h"
 
 using namespace juce;
@@ -83,6 +86,7 @@ bool MidiStore::replaceState(ValueTree &newState)
         return false;
     }
     
+    const ScopedLock lock(storeLock);
     this->chordState = newState;
     this->isViewUpToDate = false;
     refreshSettingsFromState();
@@ -96,24 +100,65 @@ bool MidiStore::replaceState(ValueTree &newState)
  */
 void MidiStore::refreshSettingsFromState()
 {
-    if (chordState.hasProperty(allowRecordingProp))
+    loadSettings();
+    settingsBroadcaster.sendChangeMessage();
+
+    tempoMap.clear();
+    if (chordState.hasProperty(tempoMapProp))
     {
-        bool allow = chordState.getProperty(allowRecordingProp);
-        this->allowDataRecording = allow;
+        String mapStr = chordState.getProperty(tempoMapProp);
+        if (!tempoMap.fromString(mapStr.toStdString()))
+            DBG("Ignoring invalid saved tempo map");
     }
+    tempoMapVersion++;
+    tempoMapUnsaved = false;
+
+}
+
+/**
+ * @private
+ * @brief Copy the settings from the state tree to the typed settings (that the getters read). A value that
+ * is missing or out of range gets the default.
+ */
+void MidiStore::loadSettings()
+{
+    // Until I start using this for real and playing live while watching the playback, I am not sure what
+    // good values are for the view width. Default to 20 seconds and limit to 100 for now.
+    // The short chord threshold defaults to half a second. Allowing up to 2 seconds here, but I'm setting the
+    // slider to be less currently
+    settings.playHeadPosition = getStateFloatProp(playHeadPositionProp, 25.0, 0.0, 100.0);
+    settings.timeWidth = getStateFloatProp(viewWidthProp, 20.0, 1.0, 100.0);
+    settings.shortChordThreshold = getStateFloatProp(shortChordThresholdProp, 0.5, 0.0, 2.0);
+    settings.chordNameSize = getStateFloatProp(chordNameSizeProp, 25, 5.0, 50.0);
+    settings.arpeggioWindow = getStateFloatProp(arpeggioWindowProp, 0.0, 0.0, 4.0);
+    settings.spellByKey = static_cast<bool>(chordState.getProperty(spellByKeyProp, false));
+    settings.arpeggioWindowInBeats = static_cast<bool>(chordState.getProperty(arpeggioWindowInBeatsProp, false));
 
+    // default to 1000 ... for no good reason other than that it works well for Logic Pro X
+    int q = chordState.getProperty(quantizationValueProp, 0);
+    settings.quantizationValue = q > 0 ? q : 1000;
+
+    if (chordState.hasProperty(allowRecordingProp))
+        settings.allowRecording = static_cast<bool>(chordState.getProperty(allowRecordingProp));
 }
 
 /**
  * @private
- * @brief Abstraction for setting a prop value in the state
+ * @brief Abstraction for setting a prop value in the state. The typed copy is brought up to date and the
+ * listeners are told about it.
  * 
  * @param propName 
  * @param value 
  */
 void MidiStore::setStateProp(const char* propName, juce::var value)
 {
-    chordState.setProperty(propName, value, nullptr);
+    {
+        // (the audio thread changes the tree too)
+        const ScopedLock lock(storeLock);
+        chordState.setProperty(propName, value, nullptr);
+    }
+    loadSettings();
+    settingsBroadcaster.sendChangeMessage();
 }
 
 /**
@@ -147,7 +192,6 @@ float MidiStore::getStateFloatProp(const char* propName, float defaultValue, flo
  */
 void MidiStore::allowStateChange(bool allow) 
 {
-    allowDataRecording = allow;
     setStateProp(allowRecordingProp, allow);
 }
 
@@ -169,7 +213,7 @@ void MidiStore::setPlayHeadPosition(float percentage)
  */
 float MidiStore::getPlayHeadPosition()
 {
-    return getStateFloatProp(playHeadPositionProp, 25.0, 0.0, 100.0);
+    return settings.playHeadPosition;
 }
 
 /**
@@ -189,9 +233,7 @@ void MidiStore::setTimeWidth(float width)
  */
 float MidiStore::getTimeWidth()
 {
-    // Until I start using this for real and playing live while watching the playback, I 
-    // am not sure what good values are. Default to 20 seconds and limit to 100 for now.
-    return getStateFloatProp(viewWidthProp, 20.0, 1.0, 100.0);
+    return settings.timeWidth;
 }
 
 /**
@@ -202,8 +244,11 @@ float MidiStore::getTimeWidth()
 void MidiStore::setShortChordThreshold(float threshold)
 {
     setStateProp(shortChordThresholdProp, threshold);
-    // The view can change if this is modified. More or fewer notes could be in the view
-    this->isViewUpToDate = false;
+    // More or fewer chords could be in the view now. But the chords themselves haven't changed, so there is
+    // no need for a full rebuild; just filter the unfiltered view again (this gets called for every step of
+    // the slider while it is dragged)
+    const ScopedLock lock(viewLock);
+    applyShortChordFilter();
 }
 
 /**
@@ -213,9 +258,7 @@ void MidiStore::setShortChordThreshold(float threshold)
  */
 float MidiStore::getShortChordThreshold()
 {
-    // default to half a second
-    // Allowing up to 5 seconds here, but I'm setting the slider to be less currently
-    return getStateFloatProp(shortChordThresholdProp, 0.5, 0.0, 2.0);
+    return settings.shortChordThreshold;
 }
 
 /**
@@ -235,7 +278,88 @@ void MidiStore::setChordNameSize(float fontSize)
  */
 float MidiStore::getChordNameSize()
 {
-    return getStateFloatProp(chordNameSizeProp, 25, 5.0, 50.0);
+    return settings.chordNameSize;
+}
+
+/**
+ * @brief Turn spelling the chord names by the detected key on or off
+ * 
+ * @param spell
+ */
+void MidiStore::setSpellChordsByKey(bool spell)
+{
+    setStateProp(spellByKeyProp, spell);
+    // every name in the view potentially changes
+    this->isViewUpToDate = false;
+}
+
+/**
+ * @brief Are the chord names spelled by the detected key? Off by default, in which case the black notes
+ * are always flats.
+ * 
+ * @return bool 
+ */
+bool MidiStore::getSpellChordsByKey()
+{
+    return settings.spellByKey;
+}
+
+/**
+ * @brief Set the arpeggio window. Notes that started within this much time before an event are included
+ * in the chord at that event (see ArpeggioWindow), so broken chords get one name instead of one per note.
+ * 
+ * @param window   length in seconds (or beats, see setArpeggioWindowInBeats). 0 turns it off
+ */
+void MidiStore::setArpeggioWindow(float window)
+{
+    setStateProp(arpeggioWindowProp, window);
+    this->isViewUpToDate = false;
+}
+
+/**
+ * @brief Retrieve the arpeggio window length
+ * 
+ * @return float   0 (the default) if chords are only the notes that are on at the same time
+ */
+float MidiStore::getArpeggioWindow()
+{
+    return settings.arpeggioWindow;
+}
+
+/**
+ * @private
+ * @brief The arpeggio window in seconds. If it is set in beats, this goes by the current tempo (which
+ * is close enough for deciding what a short chord is)
+ * 
+ * @return float   0 if it is off
+ */
+float MidiStore::getArpeggioWindowSeconds()
+{
+    float window = getArpeggioWindow();
+    if (getArpeggioWindowInBeats())
+        window = static_cast<float>(window * 60.0 / getBPMinute().value_or(120.0));
+    return window;
+}
+
+/**
+ * @brief Measure the arpeggio window in beats (quarter notes) instead of seconds
+ * 
+ * @param inBeats 
+ */
+void MidiStore::setArpeggioWindowInBeats(bool inBeats)
+{
+    setStateProp(arpeggioWindowInBeatsProp, inBeats);
+    this->isViewUpToDate = false;
+}
+
+/**
+ * @brief Is the arpeggio window measured in beats?
+ * 
+ * @return bool 
+ */
+bool MidiStore::getArpeggioWindowInBeats()
+{
+    return settings.arpeggioWindowInBeats;
 }
 
 /**
@@ -245,7 +369,9 @@ float MidiStore::getChordNameSize()
  */
 void MidiStore::setBPMinute(double bpm)
 {
-    this->bpMinute = bpm;
+    TransportSnapshot snapshot = transport.load();
+    snapshot.bpm = bpm;
+    transport.store(snapshot);
 }
 
 /**
@@ -255,7 +381,10 @@ void MidiStore::setBPMinute(double bpm)
  */
 optional<double> MidiStore::getBPMinute()
 {
-    return this->bpMinute;
+    double bpm = transport.load().bpm;
+    if (bpm > 0.0)
+        return bpm;
+    return std::nullopt;
 }
 
 /**
@@ -265,7 +394,9 @@ optional<double> MidiStore::getBPMinute()
  */
 void MidiStore::setBPMeasure(int bpm)
 {
-    this->bpMeasure = bpm;
+    TransportSnapshot snapshot = transport.load();
+    snapshot.timeSigNumerator = bpm;
+    transport.store(snapshot);
 }
 
 /**
@@ -275,7 +406,31 @@ void MidiStore::setBPMeasure(int bpm)
  */
 optional<int> MidiStore::getBPMeasure()
 {
-    return this->bpMeasure;
+    int bpm = transport.load().timeSigNumerator;
+    if (bpm > 0)
+        return bpm;
+    return std::nullopt;
+}
+
+void MidiStore::setLastEventTime(int64 time)
+{
+    TransportSnapshot snapshot = transport.load();
+    snapshot.timeInSamples = time;
+    transport.store(snapshot);
+}
+
+void MidiStore::setLastEventTimeInSeconds(double time)
+{
+    TransportSnapshot snapshot = transport.load();
+    snapshot.timeInSeconds = time;
+    transport.store(snapshot);
+}
+
+void MidiStore::setIsPlaying(bool playing)
+{
+    TransportSnapshot snapshot = transport.load();
+    snapshot.isPlaying = playing;
+    transport.store(snapshot);
 }
 
 
@@ -287,6 +442,10 @@ void MidiStore::clear()
     const ScopedLock lock(storeLock);
     // Note - Intentionally ignoring the recordData state change flag on this
     chordState.removeAllChildren(nullptr);
+    chordState.removeProperty(tempoMapProp, nullptr);
+    tempoMap.clear();
+    tempoMapVersion++;
+    tempoMapUnsaved = false;
     this->isViewUpToDate = false;
 }
 
@@ -299,7 +458,7 @@ void MidiStore::clear()
  */
 void MidiStore::addNoteEventAtTime(int64 time, int note, bool isOn)
 {
-    if (!allowDataRecording) 
+    if (!settings.allowRecording) 
         return;
     time = quantizeEventTime(time);
 
@@ -340,15 +499,26 @@ int64 MidiStore::quantizeEventTime(int64 time)
 
 /**
  * @brief Store the time in seconds for an event
+ * If the sample rate is known, the seconds are shifted to match the quantized event time. Re-recording
+ * the same passage then produces exactly the same value even though the raw sample times (and the host's
+ * block boundaries) tend to wander a little from one pass to the next.
  * 
  * @param time      the native integer event time
  * @param seconds   Number of seconds associated with the event
  */
 void MidiStore::setEventTimeSeconds(int64 time, double seconds) 
 {
-    if (!allowDataRecording) 
+    if (!settings.allowRecording) 
         return;
-    time = this->quantizeEventTime(time);
+    int64 quantized = this->quantizeEventTime(time);
+    double rate = this->sampleRate;
+    if (rate > 0.0)
+    {
+        seconds += static_cast<double>(quantized - time) / rate;
+        // Different routes to the same time can differ in the last few bits; a microsecond is plenty
+        seconds = std::round(seconds * 1.0e6) / 1.0e6;
+    }
+    time = quantized;
     Identifier timeProp = notesAtIdent(time);
     const ScopedLock lock(storeLock);
     ValueTree eventTree = chordState.getChildWithName(timeProp);
@@ -363,6 +533,104 @@ void MidiStore::setEventTimeSeconds(int64 time, double seconds)
     }
 }
 
+/**
+ * @brief Store the musical position (PPQ from the host) of an event. Like the seconds, it is shifted to
+ * match the quantized event time when the sample rate is known (using the recorded tempo at that point).
+ * 
+ * @param time      the native integer event time
+ * @param ppq       position in quarter notes
+ */
+void MidiStore::setEventTimePpq(int64 time, double ppq) 
+{
+    if (!settings.allowRecording) 
+        return;
+    int64 quantized = this->quantizeEventTime(time);
+    double rate = this->sampleRate;
+    const ScopedLock lock(storeLock);
+    double bpm = tempoMap.getTempoAt(ppq);
+    if (rate > 0.0 && bpm > 0.0)
+    {
+        ppq += static_cast<double>(quantized - time) / rate * bpm / 60.0;
+        ppq = std::round(ppq * 1.0e6) / 1.0e6;
+    }
+    ValueTree eventTree = chordState.getChildWithName(notesAtIdent(quantized));
+    if (eventTree.isValid()) 
+    {
+        juce::var varPpq = ppq;
+        if (!eventTree.hasProperty(eventTimeInPpqProp) || eventTree.getProperty(eventTimeInPpqProp) != varPpq)
+        {
+            eventTree.setProperty(eventTimeInPpqProp, varPpq, nullptr);
+            this->isViewUpToDate = false;
+        }
+    }
+}
+
+/**
+ * @brief Record the host's tempo for a block of audio (see TempoMap::recordTempo). This is called on the
+ * audio thread for every block during playback; it only touches the state when the tempo is different
+ * from what we already have. When it does change, the seconds of the events get recomputed by the next
+ * view update, with no need to record the notes again.
+ * 
+ * @param ppqStart 
+ * @param ppqEnd 
+ * @param bpm 
+ * @param secondsStart   the host's time in seconds at ppqStart (NaN if not known)
+ */
+void MidiStore::recordTempo(double ppqStart, double ppqEnd, double bpm, double secondsStart)
+{
+    if (!settings.allowRecording) 
+        return;
+    const ScopedLock lock(storeLock);
+    if (tempoMap.recordTempo(ppqStart, ppqEnd, bpm, secondsStart))
+        tempoMapChanged();
+}
+
+/**
+ * @brief Record the host's time signature for a block of audio (see TempoMap::recordMeter). Same deal as
+ * recordTempo: called for every block, rarely does anything.
+ * 
+ * @param barStartPpq 
+ * @param numerator 
+ * @param denominator 
+ */
+void MidiStore::recordMeter(double barStartPpq, int numerator, int denominator)
+{
+    if (!settings.allowRecording) 
+        return;
+    const ScopedLock lock(storeLock);
+    if (tempoMap.recordMeter(barStartPpq, numerator, denominator))
+        tempoMapChanged();
+}
+
+/**
+ * @private
+ * @brief Let everyone know the tempo map changed. This is on the audio thread (and during a tempo ramp, for
+ * every block), so the map isn't written to the state here; see saveTempoMapToState. Caller must hold the
+ * storeLock
+ */
+void MidiStore::tempoMapChanged()
+{
+    tempoMapVersion++;
+    tempoMapUnsaved = true;
+    this->isViewUpToDate = false;
+}
+
+/**
+ * @brief Put the current tempo map in the state tree, if it changed since the last time. Call this before
+ * saving the state (e.g., getStateInformation).
+ */
+void MidiStore::saveTempoMapToState()
+{
+    const ScopedLock lock(storeLock);
+    if (!tempoMapUnsaved)
+        return;
+    tempoMapUnsaved = false;
+    if (tempoMap.isEmpty())
+        chordState.removeProperty(tempoMapProp, nullptr);
+    else
+        chordState.setProperty(tempoMapProp, String(tempoMap.toString()), nullptr);
+}
+
 /**
  * @brief Make sure a child exists at the specified time. If not add it in sorted order
  * 
@@ -438,49 +706,66 @@ int64 MidiStore::findMaxTime()
  * @return vector<int>
  */
 vector<int> MidiStore::getNoteOnEventsAtTime(int64 time)
+{
+    return getNoteOnEventSet(time).toVector();
+}
+
+/**
+ * @brief Retrieve the set of notes that have ON events at the given time.
+ *
+ * @param int64 time
+ * @return NoteSet
+ */
+NoteSet MidiStore::getNoteOnEventSet(int64 time)
 {
     time = this->quantizeEventTime(time);
     Identifier timeProp = notesAtIdent(time);
     const ScopedLock lock(storeLock);
     ValueTree child = chordState.getChildWithName(timeProp);
-    vector<int> notes;
+    NoteSet notes;
     for (int i = 0; i < child.getNumProperties(); ++i)
     {
         Identifier noteIdent = child.getPropertyName(i);
-        String eventStr = noteIdent.toString();
         int note;
         // If this is not an integer, it is not a note event. Skip it in that case
-        if (!noteIdentToInt(eventStr, &note))
+        if (!noteIdentToInt(noteIdent.toString(), &note))
         {
             continue;
         }
         bool isOn = child.getProperty(noteIdent);
         if (isOn)
         {
-            notes.push_back(note);
+            notes.add(note);
         }
     }
-
-    // Need to figure out the nuances of the scopedlock ... ideally should release the lock here before the
-    // sort operation. Or maybe move the extraction call/loop above into a simple method and use the scoped
-    // lock there.
-    sort(notes.begin(), notes.end());
     return notes;
 }
 
 /**
  * @brief Retrieve the list of notes that are ON at the given moment
- * This assumes that the child nodes in the tree are sorted by time
- * Current algorithm is brute force. Start at the beginning and track on/off events
  *
  * @param int64 startTime     Ignore notes before this time
  * @param int64 endTime       Point in time of interest
  * @return vector<int>   Note values at that time
  */
 vector<int> MidiStore::getAllNotesOnAtTime(int64 startTime, int64 endTime)
+{
+    return getAllNotesOnSet(startTime, endTime).toVector();
+}
+
+/**
+ * @brief Retrieve the set of notes that are ON at the given moment
+ * This assumes that the child nodes in the tree are sorted by time
+ * Current algorithm is brute force. Start at the beginning and track on/off events
+ *
+ * @param int64 startTime     Ignore notes before this time
+ * @param int64 endTime       Point in time of interest
+ * @return NoteSet   Notes on at that time
+ */
+NoteSet MidiStore::getAllNotesOnSet(int64 startTime, int64 endTime)
 {
     const ScopedLock lock(storeLock);
-    set<int> notes;
+    NoteSet notes;
 
     startTime = this->quantizeEventTime(startTime);
     endTime = this->quantizeEventTime(endTime);
@@ -501,34 +786,29 @@ vector<int> MidiStore::getAllNotesOnAtTime(int64 startTime, int64 endTime)
         }
     }
 
-    vector<int> returnVal(notes.size());
-    copy(notes.begin(), notes.end(), returnVal.begin());
-
-    return returnVal;
+    return notes;
 }
 
 /**
  * @brief Add/delete the a note from the chidl tree to the set of notes that is current "on"
  * 
  * @param ValueTree childEvents   value tree containing note on/off events
- * @param set<int>  notes         update this set accordingly 
+ * @param NoteSet   notes         update this set accordingly 
  * @param int       propIndex     The index of the property of interest
+ * @param NoteSet   touched       if given, the note gets added to this (whether it went on or off)
  */
-void MidiStore::updateCurrentlyOn(ValueTree &childEvents, set<int> &notes, int propIndex)
+void MidiStore::updateCurrentlyOn(ValueTree &childEvents, NoteSet &notes, int propIndex, NoteSet *touched)
 {
     Identifier noteIdent = childEvents.getPropertyName(propIndex);
-    string eventStr = noteIdent.toString().toStdString();
     int note;
     // If this is not an integer, it is not a note event. Skip it in that case
-    if (!noteIdentToInt(eventStr, &note))
+    if (!noteIdentToInt(noteIdent.toString(), &note))
         return;
 
     bool isOn = childEvents.getProperty(noteIdent);
-    if (isOn)
-        notes.insert(note);
-    else
-        notes.erase(note);
-
+    notes.set(note, isOn);
+    if (touched != nullptr)
+        touched->add(note);
 }
 
 
@@ -554,6 +834,33 @@ double MidiStore::getEventTimeInSeconds(int64 time)
 }
 
 
+/**
+ * @brief Retrieve the musical position (PPQ) associated with this event, if it has one
+ * 
+ * @param time 
+ * @return optional<double> 
+ */
+optional<double> MidiStore::getEventTimeInPpq(int64 time) 
+{
+    time = this->quantizeEventTime(time);
+    const ScopedLock lock(storeLock);
+    ValueTree eventTree = chordState.getChildWithName(notesAtIdent(time));
+    if (eventTree.isValid() && eventTree.hasProperty(eventTimeInPpqProp))
+        return static_cast<double>(eventTree.getProperty(eventTimeInPpqProp));
+    return std::nullopt;
+}
+
+/**
+ * @brief Retrieve a copy of the captured tempo map
+ * 
+ * @return TempoMap 
+ */
+TempoMap MidiStore::getTempoMap()
+{
+    const ScopedLock lock(storeLock);
+    return tempoMap;
+}
+
 /**
  * @brief Retrieve all times where event changes occur
  * 
@@ -586,7 +893,7 @@ vector<int64> MidiStore::getEventTimes() {
  */
 void MidiStore::setQuantizationValue(int q) 
 {
-    chordState.setProperty(quantizationValueProp, q, nullptr);
+    setStateProp(quantizationValueProp, q);
 }
 
 /**
@@ -596,12 +903,8 @@ void MidiStore::setQuantizationValue(int q)
  */
 int MidiStore::getQuantizationValue()
 {
-    int q = 0;
-    if (chordState.hasProperty(quantizationValueProp))
-        q = chordState.getProperty(quantizationValueProp);
-
-    // default to 1000 ... for no good reason other than that it works well for Logic Pro X
-    return q > 0 ? q : 1000;
+    // (this is called for every event on the audio thread)
+    return settings.quantizationValue;
 }
 
 
@@ -613,19 +916,26 @@ int MidiStore::getQuantizationValue()
  * @param int    *value
  * @return bool  True if converted, false if not (e.g., not an integer, or not of right form)
  */
-bool MidiStore::noteIdentToInt(String str, int *value)
+bool MidiStore::noteIdentToInt(const String &str, int *value)
 {
-
-    if (!str.startsWithChar(':')) 
+    // This gets called for every property of every event when replaying the notes, so it works straight
+    // off the characters instead of making substrings
+    const char *text = str.toRawUTF8();
+    if (*text != ':') 
         return false;
 
-    string stdstr = str.substring(1).toStdString();
-    if (stdstr.find_first_not_of("0123456789") != string::npos)
+    int note = 0;
+    int digits = 0;
+    for (++text; *text != 0; ++text, ++digits)
     {
-        // Not an integer apparently
-        return false;
+        // Not an integer apparently (or much too big to be a note)
+        if (*text < '0' || *text > '9' || digits >= 4)
+            return false;
+        note = note * 10 + (*text - '0');
     }
-    *value = stoi(stdstr);
+    if (digits == 0)
+        return false;
+    *value = note;
     return true;
 }
 
@@ -660,60 +970,264 @@ Identifier MidiStore::notesAtIdent(int64 time)
 }
 
 
+/**
+ * @private
+ * @brief The time in seconds of every event (in the order of the children). Events with a PPQ position
+ * get their seconds from the tempo map, all in one pass; the rest (no tempo info from the host, or
+ * state saved by an older version) use the seconds that were stored with them.
+ * Caller must hold the storeLock.
+ * 
+ * @return vector<double> 
+ */
+vector<double> MidiStore::getEventSecondsColumn()
+{
+    int count = chordState.getNumChildren();
+    vector<double> seconds(static_cast<size_t>(count));
+    vector<double> ppqs(static_cast<size_t>(count), std::numeric_limits<double>::quiet_NaN());
+    bool anyPpq = false;
+    for (int i = 0; i < count; i++)
+    {
+        ValueTree child = chordState.getChild(i);
+        seconds[static_cast<size_t>(i)] = child.getProperty(eventTimeInSecondsProp);
+        if (child.hasProperty(eventTimeInPpqProp))
+        {
+            ppqs[static_cast<size_t>(i)] = child.getProperty(eventTimeInPpqProp);
+            anyPpq = true;
+        }
+    }
+
+    if (!anyPpq || !tempoMap.hasTempo())
+        return seconds;
+
+    vector<double> derived;
+    tempoMap.ppqToSeconds(ppqs, derived);
+    for (size_t i = 0; i < seconds.size(); i++)
+    {
+        if (!std::isnan(derived[i]))
+            seconds[i] = derived[i];
+    }
+    return seconds;
+}
+
+
+/**
+ * @private
+ * @brief The position of each event in beats (quarter notes). This goes through the captured tempo map if
+ * there is one; otherwise it assumes the current tempo (or 120 if that isn't known either) for the whole song.
+ * Must be called with the storeLock held.
+ * 
+ * @param seconds   the event times (see getEventSecondsColumn)
+ * @return vector<double> 
+ */
+vector<double> MidiStore::getEventBeatsColumn(const vector<double> &seconds)
+{
+    vector<double> beats(seconds.size());
+    double bpm = getBPMinute().value_or(120.0);
+    for (size_t i = 0; i < seconds.size(); i++)
+        beats[i] = tempoMap.hasTempo() ? tempoMap.secondsToPpq(seconds[i]) : seconds[i] * bpm / 60.0;
+    return beats;
+}
+
+
+/**
+ * @private
+ * @brief How many threads to build the view with: just the caller without a worker pool, otherwise the
+ * pool's threads plus the caller (or fewer if limited with setMaxViewBuildThreads)
+ * 
+ * @return int 
+ */
+int MidiStore::getViewBuildThreads()
+{
+    if (workerPool == nullptr)
+        return 1;
+    int threads = workerPool->getPool().getNumThreads() + 1;
+    return maxViewBuildThreads > 0 ? jmin(threads, maxViewBuildThreads.load()) : threads;
+}
+
+
+/**
+ * @private
+ * @brief Number of pieces to split the events into when building the view. A few per thread so a slow
+ * one doesn't hold everything up, but none smaller than minEventsPerChunk (it isn't worth it for small views)
+ * 
+ * @param eventCount 
+ * @param threads 
+ * @return size_t    1 for doing it all on the calling thread
+ */
+size_t MidiStore::getViewBuildChunkCount(size_t eventCount, int threads)
+{
+    if (threads <= 1)
+        return 1;
+    return jlimit(size_t(1), static_cast<size_t>(threads) * 4, eventCount / minEventsPerChunk);
+}
+
+
+/**
+ * @private
+ * @brief Replay the note on/off events to get the notes that are on at each event. The caller must hold
+ * the storeLock.
+ * @details
+ * The notes that are on at an event depend on every event before it, but the replay can still be split up.
+ * Each chunk of events is replayed on its own starting from nothing, keeping track of which notes it has
+ * seen any event for ("touched"). With S the notes that were on when the chunk started, the notes on at
+ * each of its events are then (S - touched) | replayed. The S for each chunk (the checkpoints) come from
+ * the last event of the chunk before it, which is a quick pass over just the chunks. Then the checkpoints
+ * are applied to each chunk. Both of the heavy steps (going through the value tree and the fix up) are done
+ * on all the chunks at once on the worker pool. The answer is exactly the same as a straight replay.
+ * 
+ * @param noteSets        receives the notes that are on at each event (sized for all the events)
+ * @param secondsColumn   event times (only used for a sanity check)
+ * @param threads         most threads to use (see getViewBuildThreads)
+ */
+void MidiStore::replayNoteEvents(vector<NoteSet> &noteSets, const vector<double> &secondsColumn, int threads)
+{
+    size_t chunkCount = getViewBuildChunkCount(noteSets.size(), threads);
+    vector<NoteSet> touched(chunkCount > 1 ? noteSets.size() : 0);
+    auto chunkStart = [&](size_t chunk) { return noteSets.size() * chunk / chunkCount; };
+
+    auto replayChunk = [&](int chunk)
+    {
+        size_t end = chunkStart(static_cast<size_t>(chunk) + 1);
+        NoteSet notes;
+        NoteSet touchedNotes;
+        for (size_t j = chunkStart(static_cast<size_t>(chunk)); j < end; j++)
+        {
+            ValueTree child = chordState.getChild(static_cast<int>(j));
+
+            // sanity check on the expected sortedness of the value tree events
+            // FIXME: what to do about this... I think it happens when playing back over the
+            // top of existing data. The slight shift I see in the int64 event times applies
+            // to the floating point seconds as well. If I do a straight through recording
+            // of the data (totally clean) then I do no thit this assert
+            jassert(j == 0 || secondsColumn[j] >= secondsColumn[j - 1]);
+            ignoreUnused(secondsColumn);
+
+            for (int i = 0; i < child.getNumProperties(); ++i)
+                updateCurrentlyOn(child, notes, i, &touchedNotes);
+            noteSets[j] = notes;
+            if (chunkCount > 1)
+                touched[j] = touchedNotes;
+        }
+    };
+
+    if (chunkCount <= 1)
+    {
+        replayChunk(0);
+        return;
+    }
+
+    WorkerPool &pool = workerPool->getPool();
+    pool.parallelFor(static_cast<int>(chunkCount), replayChunk, threads);
+
+    // The checkpoint index: the notes that are on as each chunk starts
+    vector<NoteSet> checkpoints(chunkCount);
+    for (size_t chunk = 1; chunk < chunkCount; chunk++)
+    {
+        size_t last = chunkStart(chunk) - 1;
+        checkpoints[chunk] = (checkpoints[chunk - 1] - touched[last]) | noteSets[last];
+    }
+
+    // The first chunk did start from nothing, so it is already right
+    pool.parallelFor(static_cast<int>(chunkCount) - 1, [&](int index)
+    {
+        size_t chunk = static_cast<size_t>(index) + 1;
+        size_t end = chunkStart(chunk + 1);
+        for (size_t j = chunkStart(chunk); j < end; j++)
+            noteSets[j] = (checkpoints[chunk] - touched[j]) | noteSets[j];
+    }, threads);
+}
+
+
 /**
  * @brief Create the simple (efficient) static view of the chords for repeated use
  * 
+ * @param lastEventSeconds   set to the time of the last note event (0 if there aren't any)
  * @return vector <pair<float, string>> 
  */
-vector <pair<float, string>> MidiStore::createStaticView()
+vector <pair<float, string>> MidiStore::createStaticView(float &lastEventSeconds)
 {
-    // I *think* that this lock held here will be the most "expensive" of all the operations. May need to rethink
-    // how this is done. This operation is O(n) without a lot of cost involved (perhaps the chord naming is most costly?)
-    // It might be more efficient to get the lock and then make a copy of the chordState tree, unlock, build up the
-    // chord set, then lock again and replace the static view?
-    const ScopedLock lock(storeLock);
-    set<int> notes;
-    [[maybe_unused]] double prevTime = 0.0;
-    string prevChord = "";
-    ChordName cn;
-    ChordVectorType newStaticView;
-
-    for (ValueTree::Iterator events = chordState.begin(); events != chordState.end(); ++events)
+    // The lock is only held while replaying the note events into one note set per event. The naming of
+    // all of those is then done in one batch after letting go of it.
+    vector<double> secondsColumn;
+    vector<NoteSet> noteSets;
+    int threads = getViewBuildThreads();
     {
-        ValueTree child = *events;
-        double eventTimeInSeconds = child.getProperty(eventTimeInSecondsProp);
-
-        // sanity check on the expected sortedness of the value tree events
-        // FIXME: what to do about this... I think it happens when playing back over the
-        // top of existing data. The slight shift I see in the int64 event times applies
-        // to the floating point seconds as well. If I do a straight through recording
-        // of the data (totally clean) then I do no thit this assert
-        //if (eventTimeInSeconds < prevTime) 
-        //    continue;
-        jassert(eventTimeInSeconds >= prevTime);
-        prevTime = eventTimeInSeconds;
+        const ScopedLock lock(storeLock);
+        secondsColumn = getEventSecondsColumn();
+        noteSets.resize(secondsColumn.size());
+        replayNoteEvents(noteSets, secondsColumn, threads);
+    }
+    lastEventSeconds = secondsColumn.empty() ? 0.0f : static_cast<float>(secondsColumn.back());
 
-        for (int i = 0; i < child.getNumProperties(); ++i)
+    // Broken chords: add the notes that started recently to the ones that are still on
+    float arpeggioWindow = getArpeggioWindow();
+    if (arpeggioWindow > 0.0f)
+    {
+        vector<double> positions = secondsColumn;
+        if (getArpeggioWindowInBeats())
         {
-            updateCurrentlyOn(child, notes, i);
+            const ScopedLock lock(storeLock);
+            positions = getEventBeatsColumn(secondsColumn);
         }
+        ArpeggioWindow arpeggio(arpeggioWindow);
+        for (size_t i = 0; i < noteSets.size(); i++)
+            noteSets[i] = arpeggio.addEvent(positions[i], noteSets[i]);
+    }
+
+    vector<ChordId> chordIds(noteSets.size());
+    size_t chunkCount = getViewBuildChunkCount(noteSets.size(), threads);
+    if (chunkCount <= 1)
+        ChordName::nameChords(noteSets.data(), chordIds.data(), noteSets.size());
+    else
+    {
+        workerPool->getPool().parallelFor(static_cast<int>(chunkCount), [&](int chunk)
+        {
+            size_t begin = noteSets.size() * static_cast<size_t>(chunk) / chunkCount;
+            size_t end = noteSets.size() * static_cast<size_t>(chunk + 1) / chunkCount;
+            ChordName::nameChords(noteSets.data() + begin, chordIds.data() + begin, end - begin);
+        }, threads);
+    }
 
-        vector<int> currentChord(notes.size());
-        copy(notes.begin(), notes.end(), currentChord.begin());
-        string newChord = cn.nameChord(currentChord);
-        if (newChord != prevChord && newChord != "")
+    // Spell each chord for the key as of that point in the song. The key detector is fed the events in
+    // order, so this is one more cheap step per event.
+    if (getSpellChordsByKey())
+    {
+        KeyDetector keys;
+        for (size_t i = 0; i < chordIds.size(); i++)
         {
-            newStaticView.push_back({eventTimeInSeconds, newChord});
-            prevChord = newChord;
+            keys.addEvent(secondsColumn[i], noteSets[i]);
+            chordIds[i] = ChordName::spellForKey(chordIds[i], keys.getKey());
         }
+    }
 
+    // Equal ids are equal names, so only the chords that make it into the view need a string (and each
+    // different one only once)
+    ChordName cn;
+    ChordId prevChord = ChordName::noChord;
+    map<ChordId, string> names;
+    ChordVectorType newStaticView;
+    for (size_t i = 0; i < chordIds.size(); i++)
+    {
+        // A change of key part way through a chord doesn't make it a different chord
+        ChordId chord = ChordName::chordIdUnspelled(chordIds[i]);
+        if (chord != prevChord && chord != ChordName::noChord)
+        {
+            auto name = names.find(chordIds[i]);
+            if (name == names.end())
+                name = names.insert({chordIds[i], cn.chordIdToName(chordIds[i])}).first;
+            newStaticView.push_back({secondsColumn[i], name->second});
+            prevChord = chord;
+        }
     }
 
     return newStaticView;
 }
 
 /**
- * @brief Remove "short" chords. 
+ * @private
+ * @brief Remove "short" chords. Refresh the static view from the unfiltered one for the current short chord
+ * threshold. The caller must hold the viewLock.
+ * @details
  * The idea is that in a busy score, I don't want to see passing notes showing up as chords. 
  * They don't fit on the scrolling view. The threshold value is a user controllable value
  * 
@@ -723,34 +1237,108 @@ vector <pair<float, string>> MidiStore::createStaticView()
  * start using it more, it will turn into that amazing bit of complex code (that I will never
  * be able to understand after sufficient time goes by).
  * 
- * @param vector view 
+ * The actual work is done by ChordChangeFilter (see feedShortChordFilter). The filter only ever compares the
+ * gap between two neighboring chords in the unfiltered view with the threshold. So the result only depends
+ * on which of those gaps are at least the threshold, and it is the same for every threshold between two
+ * neighboring (sorted) gaps. If the threshold is still between the same two gaps as the one the filter has
+ * been using, the view is already right and there is nothing to do. Otherwise the filter starts over and
+ * the whole unfiltered view goes through it, with no replaying of notes or naming.
+ */
+void MidiStore::applyShortChordFilter()
+{
+    // Where one broken chord turns into the next, the arpeggio window holds a blend of the two for up to the
+    // length of the window. Those blends shouldn't show up as chords, so they count as short.
+    float minLength = jmax(getShortChordThreshold(), getArpeggioWindowSeconds());
+    size_t gapIndex = static_cast<size_t>(lower_bound(sortedChordGaps.begin(), sortedChordGaps.end(), minLength) -
+                                          sortedChordGaps.begin());
+    if (gapIndex == filteredGapIndex)
+        return;
+
+    shortChordFilter.restart(minLength);
+    shortChordsFed = 0;
+    feedShortChordFilter();
+    filteredGapIndex = gapIndex;
+}
+
+
+/**
+ * @private
+ * @brief Put the chords of the unfiltered view that the short chord filter hasn't seen yet through it, let it
+ * know how far the notes go, and make the static view from what it has kept (plus the chord that is still
+ * waiting, which is the same as finishing it). The caller must hold the viewLock.
+ */
+void MidiStore::feedShortChordFilter()
+{
+    size_t fed = shortChordsFed;
+    for (; shortChordsFed < unfilteredView.size(); shortChordsFed++)
+        shortChordFilter.add(unfilteredView[shortChordsFed].first, unfilteredView[shortChordsFed].second);
+    // Nothing recorded later can change a chord before the last note
+    shortChordFilter.advanceTo(unfilteredViewEnd);
+    if (fed == shortChordsFed && fed > 0)
+        return;
+
+    ChordVectorType chords;
+    chords.reserve(shortChordFilterOutput.size() + 1);
+    chords.insert(chords.end(), shortChordFilterOutput.begin(), shortChordFilterOutput.end());
+    if (const auto *pending = shortChordFilter.getPending())
+        chords.push_back(*pending);
+    this->staticView = make_shared<const ChordTimeline>(chords);
+    viewVersion++;
+    // The index is only rebuilt when someone goes looking for a progression
+    isProgressionIndexUpToDate = false;
+}
+
+
+/**
+ * @private
+ * @brief Build the progression index for the current static view if it is out of date. The caller must
+ * hold the viewLock.
  */
-void MidiStore::removeShortChords(vector<pair<float, string>> &view)
+void MidiStore::updateProgressionIndex()
 {
-    float minLength = getShortChordThreshold();
-    vector<pair<float, string>>::iterator it;
-    string prevChord = "";
+    if (isProgressionIndexUpToDate)
+        return;
+
+    // The timeline already has the ids of its chords
+    vector<ChordId> chords;
+    chords.reserve(staticView->size());
+    for (size_t i = 0; i < staticView->size(); i++)
+        chords.push_back(staticView->getChordId(i));
+    progressionIndex.build(chords);
+    isProgressionIndexUpToDate = true;
+}
 
-    for (it = view.begin(); it != view.end(); )
+
+/**
+ * @brief Find every place in the (static view of the) song where a chord progression is played
+ * 
+ * @param progression   chord names separated by spaces, commas or bars (e.g., "Am F C G" or "| Am | F | C | G |")
+ * @param anyKey        find it in any key (e.g., "Am F C G" also finds "Em C G D")
+ * @return vector<pair<float, float>>   start and end (the start of the next chord, or of the last chord of the
+ *                                      progression at the end of the song) of each place it is played, in order.
+ *                                      Empty if any of the names can't be made sense of.
+ */
+vector<pair<float, float>> MidiStore::findProgression(const string &progression, bool anyKey)
+{
+    vector<ChordId> chords;
+    for (const String &name : StringArray::fromTokens(String(progression), " \t,|", ""))
     {
-        if (it == view.begin() || (it + 1) == view.end() || (it + 1)->first - it->first >= minLength)
-        {
-            // this is either the first or last chord or it is longer than the threshold, so we keep it
-            ++it;
-        }
-        else 
-        {
-            // This chord falls under the threshold, so we will remove it. (Note to future 
-            // forgetful self: erase returns iterator to the next position after deleted item)
-            it = view.erase(it);
-            // If the new current note is the same as the previous one, then we combine it
-            if (it->second == (it - 1)->second)
-            {
-                it = view.erase(it);
-            }
-        }
+        chords.push_back(ChordName::nameToChordId(name.toStdString()));
+        if (chords.back() == ChordName::noChord)
+            return {};
     }
 
+    const ScopedLock lock(viewLock);
+    updateProgressionIndex();
+    vector<pair<float, float>> sections;
+    for (size_t start : progressionIndex.find(chords, anyKey))
+    {
+        size_t end = start + chords.size();
+        const ChordTimeline &view = *staticView;
+        float endTime = end < view.size() ? view.getTime(end) : view.getTime(end - 1);
+        sections.push_back({view.getTime(start), endTime});
+    }
+    return sections;
 }
 
 
@@ -765,15 +1353,44 @@ void MidiStore::removeShortChords(vector<pair<float, string>> &view)
  */
 void MidiStore::updateStaticView()
 {
-    vector<pair<float, string>> newStaticView;
-    newStaticView = createStaticView();
-
-    // It is more efficient to get rid of the short chords here (as opposed to inside getChordsInWindow). In "normal" usage
-    // this should happen infrequently. 
-    removeShortChords(newStaticView);
-
+    vector<pair<float, string>> newUnfilteredView;
+    float lastEventSeconds = 0.0f;
+    newUnfilteredView = createStaticView(lastEventSeconds);
+
+    // The gaps between the chords, for deciding when the short chord filter needs to run again
+    vector<float> gaps;
+    gaps.reserve(newUnfilteredView.size());
+    for (size_t i = 1; i < newUnfilteredView.size(); i++)
+        gaps.push_back(newUnfilteredView[i].first - newUnfilteredView[i - 1].first);
+    sort(gaps.begin(), gaps.end());
+    gaps.erase(unique(gaps.begin(), gaps.end()), gaps.end());
+
+    // It is more efficient to get rid of the short chords here (as opposed to inside getChordsInWindow). The
+    // unfiltered view is kept so a change of the threshold doesn't need a rebuild.
     const ScopedLock lock(viewLock);
-    this->staticView = newStaticView;
+    // While recording, the chords from last time are usually all still there and the new ones come after the
+    // last note the filter was told about. Then only the new ones need to go through the short chord filter.
+    // Anything else (e.g., notes recorded again in the middle of the song) and it starts over.
+    bool appended = filteredGapIndex != SIZE_MAX && newUnfilteredView.size() >= shortChordsFed &&
+                    equal(unfilteredView.begin(), unfilteredView.begin() + static_cast<ptrdiff_t>(shortChordsFed),
+                          newUnfilteredView.begin()) &&
+                    (newUnfilteredView.size() == shortChordsFed ||
+                     newUnfilteredView[shortChordsFed].first >= shortChordFilter.getTime());
+    this->unfilteredView = std::move(newUnfilteredView);
+    this->unfilteredViewEnd = lastEventSeconds;
+    this->sortedChordGaps = std::move(gaps);
+    if (appended)
+    {
+        feedShortChordFilter();
+        // Where the threshold the filter has been using falls in the gaps now (there are new ones). If the
+        // current threshold doesn't fall in the same place, it starts over.
+        this->filteredGapIndex = static_cast<size_t>(lower_bound(sortedChordGaps.begin(), sortedChordGaps.end(),
+                                                                 shortChordFilter.getThreshold()) -
+                                                     sortedChordGaps.begin());
+    }
+    else
+        this->filteredGapIndex = SIZE_MAX;
+    applyShortChordFilter();
 }
 
 
@@ -792,9 +1409,24 @@ void MidiStore::updateStaticViewIfOutOfDate()
         if (curTime - this->lastViewUpdateTime > 1000)
         {
             // DBG("Updating static view at time " + to_string(curTime));
-            this->updateStaticView();
-            this->lastViewUpdateTime = curTime;  // yeah ... not entirely accurate but close enough
-            this->isViewUpToDate = true;
+            if (this->workerPool == nullptr)
+            {
+                this->isViewUpToDate = true;
+                this->updateStaticView();
+                this->lastViewUpdateTime = curTime;  // yeah ... not entirely accurate but close enough
+            }
+            else if (!this->rebuildInProgress.exchange(true))
+            {
+                // Flag it as up to date *before* the rebuild starts. Note events that arrive while the
+                // rebuild is running then mark it stale again instead of being lost.
+                this->isViewUpToDate = true;
+                this->lastViewUpdateTime = curTime;
+                this->workerPool->addJob([this]
+                {
+                    this->updateStaticView();
+                    this->rebuildInProgress = false;
+                });
+            }
         }
     }
 }
@@ -808,25 +1440,39 @@ void MidiStore::updateStaticViewIfOutOfDate()
  */
 vector<pair<float, string>> MidiStore::getChordsInWindowRaw(pair<float, float> viewWindow)
 {
-    const ScopedLock lock(viewLock);
-
-    // Find the lower end
-    float viewStart = viewWindow.first;
-    float viewEnd = viewWindow.second;
-
-    pair<float, string> p(viewStart, "");
+    ChordWindow window = getChordWindow(viewWindow);
     vector<pair<float, string>> chords;
-    auto curChord = std::lower_bound(this->staticView.begin(), this->staticView.end(), p);
-    for (; curChord != this->staticView.end(); ++curChord)
-    {
-        if (curChord->first > viewEnd)
-            // past end of chords that fit in the window
-            break;
-        chords.push_back({curChord->first, curChord->second});
-    }
-
+    chords.reserve(window.size());
+    for (const auto &chord : window)
+        chords.push_back({chord.first, chord.second});
     return chords;
+}
 
+/**
+ * @brief The chords in the given window of time (in seconds) as a range in the current snapshot of the view.
+ * Nothing is copied, so this is the one to use every frame.
+ * 
+ * @param viewWindow   start and end (both included)
+ * @return ChordWindow 
+ */
+ChordWindow MidiStore::getChordWindow(pair<float, float> viewWindow)
+{
+    ChordSnapshot snapshot = getViewSnapshot();
+    size_t start = snapshot->lowerBound(viewWindow.first);
+    size_t end = max(start, snapshot->upperBound(viewWindow.second));
+    return ChordWindow(std::move(snapshot), start, end);
+}
+
+/**
+ * @brief The current snapshot of the static view. It doesn't change, even when the view is rebuilt (that
+ * makes a new one).
+ * 
+ * @return ChordSnapshot 
+ */
+ChordSnapshot MidiStore::getViewSnapshot()
+{
+    const ScopedLock lock(viewLock);
+    return staticView;
 }
 
 /**
@@ -14,6 +14,13 @@
 
 #include <juce_core/juce_core.h>
 #include <juce_data_structures/juce_data_structures.h>
+#include "WorkerPool.h"
+#include "TransportSnapshot.h"
+#include "TempoMap.h"
+#include "NoteSet.h"
+#include "ProgressionIndex.h"
+#include "ChordWindow.h"
+#include "ChordChangeFilter.h"
 using namespace juce;
 using namespace std;
 
@@ -26,6 +33,9 @@ using namespace std;
  * - The identifier for each child tree is a string of the form "notesat:<int64>" where
  *   the int value is the event time
  * - Each child tree has a property with the identifier "eventTime" where the value is the event time
+ * - Each child tree also has the time in seconds ("eventTimeInSeconds") and, if the host provides it, the
+ *   musical position in quarter notes ("eventTimeInPpq"). When the PPQ position is there, it is the one
+ *   that counts; the seconds are derived from it through the captured tempo map.
  * - The child trees are kept in sorted order by event time
  * - The midi note numbers are stored as properties (in no particular order) in the child tree 
  *   with the identifier being the midi note number (string version of the int value) and the 
@@ -47,6 +57,10 @@ public:
     inline static const char* midiChordsVersionProp = "midiChordsVersion";
     inline static const char* eventTimeInSecondsProp = "eventTimeInSeconds";
     inline static const char* eventTimeProp = "eventTime";
+    inline static const char* eventTimeInPpqProp = "eventTimeInPpq";
+    // The captured tempo map (see TempoMap::toString). This is a property on the root rather than a child
+    // tree since every child is assumed to be a note event
+    inline static const char* tempoMapProp = "tempoMap";
     inline static const char* quantizationValueProp = "quantizationValue";
     inline static const char* allowRecordingProp = "allowRecording";
     // property with the position of the playhead in % (within the view window)
@@ -54,6 +68,9 @@ public:
     inline static const char* viewWidthProp = "viewWidthProp";
     inline static const char* shortChordThresholdProp = "shortChordThresholdProp";
     inline static const char* chordNameSizeProp = "chordNameSizeProp";
+    inline static const char* spellByKeyProp = "spellByKeyProp";
+    inline static const char* arpeggioWindowProp = "arpeggioWindowProp";
+    inline static const char* arpeggioWindowInBeatsProp = "arpeggioWindowInBeatsProp";
 
 
 
@@ -67,20 +84,44 @@ public:
     // -------------------------
     void addNoteEventAtTime(int64 time, int note, bool isOn);
     void setEventTimeSeconds(int64 time, double seconds);
+    void setEventTimePpq(int64 time, double ppq);
+    void recordTempo(double ppqStart, double ppqEnd, double bpm,
+                     double secondsStart = numeric_limits<double>::quiet_NaN());
+    void recordMeter(double barStartPpq, int numerator, int denominator);
     bool replaceState(ValueTree &newState);
     // -------------------------
 
     ValueTree& getState() {return this->chordState;}
+    // The tempo map is only put in the state tree when the state is about to be saved (not on the audio thread)
+    void saveTempoMapToState();
 
 
     void updateStaticView();
     void updateStaticViewIfOutOfDate();
+    // When a worker pool is attached, out of date views are rebuilt in the background on the pool
+    // instead of on the calling (message) thread
+    void setWorkerPool(WorkerPool::Client *pool) { workerPool = pool; }
+    // Big views are built on several threads of the worker pool at once. This limits how many (counting
+    // the calling thread); 0 means no limit. Mostly for testing and measuring.
+    void setMaxViewBuildThreads(int threads) { maxViewBuildThreads = threads; }
     vector<int> getNoteOnEventsAtTime(int64 time);
     vector<int> getAllNotesOnAtTime(int64 startTime, int64 endTime);
+    NoteSet getNoteOnEventSet(int64 time);
+    NoteSet getAllNotesOnSet(int64 startTime, int64 endTime);
     double getEventTimeInSeconds(int64 time);
+    optional<double> getEventTimeInPpq(int64 time);
+    TempoMap getTempoMap();
+    // Bumped every time the tempo map changes, so readers can keep a copy and only refresh it when needed
+    int getTempoMapVersion() const { return tempoMapVersion; }
     vector<int64> getEventTimes();
     vector<pair<float, string>> getChordsInWindow(pair<float, float> viewWindow);
+    // The same chords without copying them (see ChordWindow)
+    ChordWindow getChordWindow(pair<float, float> viewWindow);
+    ChordSnapshot getViewSnapshot();
     int getViewWindowChordCount() {return viewWindowChordCount;}
+    // Bumped every time the chords in the view change, so anything that keeps a copy of some of them knows to refetch
+    int getViewVersion() const { return viewVersion; }
+    vector<pair<float, float>> findProgression(const string &progression, bool anyKey = false);
     void clear();
     void allowStateChange(bool allow);
     void setPlayHeadPosition(float percentage);
@@ -92,21 +133,42 @@ public:
     float getShortChordThreshold();
     void setChordNameSize(float fontSize);
     float getChordNameSize();
+    // Spell the chords for the key the music seems to be in (e.g., G#m instead of Abm in E major)
+    void setSpellChordsByKey(bool spell);
+    bool getSpellChordsByKey();
+    // Name the notes that started within this window (seconds or beats) as one chord; 0 turns it off
+    void setArpeggioWindow(float window);
+    float getArpeggioWindow();
+    void setArpeggioWindowInBeats(bool inBeats);
+    bool getArpeggioWindowInBeats();
     void setBPMinute(double bpm);
     optional<double> getBPMinute();
     void setBPMeasure(int bpmeasure);
     optional<int> getBPMeasure();
 
-    bool getRecordingState() { return allowDataRecording; }
+    bool getRecordingState() { return settings.allowRecording; }
 
-    // setters/getters for most recently seen event time
-    void setLastEventTime(int64 time) {lastEventTime = time;}
-    void setLastEventTimeInSeconds(double time) {lastEventTimeInSeconds = time;}
-    int64 getLastEventTime() {return lastEventTime;}
-    double getLastEventTimeInSeconds() {return lastEventTimeInSeconds;}
+    // Listeners are told (on the message thread) when any of the settings above change, including when a
+    // saved state is loaded (e.g., so the controls can show the new values)
+    void addSettingsListener(ChangeListener *listener) { settingsBroadcaster.addChangeListener(listener); }
+    void removeSettingsListener(ChangeListener *listener) { settingsBroadcaster.removeChangeListener(listener); }
 
-    void setIsPlaying(bool playing) {isPlaying = playing;}
-    bool getIsPlaying() {return isPlaying;}
+    // Transport info (play position, tempo, etc.). The audio thread publishes this once per block and
+    // the UI reads it every frame; neither side blocks the other.
+    void publishTransport(const TransportSnapshot &snapshot) { transport.store(snapshot); }
+    // Sample rate the int64 event times are measured in (from prepareToPlay). Zero if unknown.
+    void setSampleRate(double rate) { sampleRate = rate; }
+    TransportSnapshot getTransport() const { return transport.load(); }
+
+    // setters/getters for individual transport values. The setters are a read/modify/publish of the
+    // snapshot, so they must not be used concurrently with publishTransport (they are for testing)
+    void setLastEventTime(int64 time);
+    void setLastEventTimeInSeconds(double time);
+    int64 getLastEventTime() {return transport.load().timeInSamples;}
+    double getLastEventTimeInSeconds() {return transport.load().timeInSeconds;}
+
+    void setIsPlaying(bool playing);
+    bool getIsPlaying() {return transport.load().isPlaying;}
 
     int getQuantizationValue();
     void setQuantizationValue(int q);
@@ -122,37 +184,79 @@ private:
     // the bulk of the data is stored in this value tree. It, effectively, represents the entire
     // state of the plugin (mostly the midi notes that have been played in the track)
     juce::ValueTree chordState;
+    // Parsed copy of the tempoMapProp in chordState (protected by storeLock)
+    TempoMap tempoMap;
+    atomic<int> tempoMapVersion = 0;
+    // Has the map changed since it was last put in chordState? (see saveTempoMapToState)
+    atomic<bool> tempoMapUnsaved = false;
+    void tempoMapChanged();
 
-    // Is the static view of the chords up to date?
-    bool isViewUpToDate = false;
+    // Is the static view of the chords up to date? Atomic since background rebuilds clear it
+    atomic<bool> isViewUpToDate = false;
     int64 lastViewUpdateTime = 0;
+    WorkerPool::Client *workerPool = nullptr;
+    // Is a background rebuild queued or running?
+    atomic<bool> rebuildInProgress = false;
     int viewWindowChordCount = 0;
 
     void refreshSettingsFromState();
+    void loadSettings();
+    vector<double> getEventSecondsColumn();
+    vector<double> getEventBeatsColumn(const vector<double> &seconds);
+    float getArpeggioWindowSeconds();
 
     void setStateProp(const char *propName, juce::var value);
     float getStateFloatProp(const char *propName, float defaultValue, float min, float max);
 
-    vector<pair<float, string>> staticView;
-    // If this is true, then save state changes. Otherwise, don't
-    // mlwtbd - I think I want this false by default for typical usage ... or maybe it just needs to be stored with the
-    // settings ... as false, it causes test failures, though
-    bool allowDataRecording = true;
-    // flag indicating if we think playback is occuring
-    bool isPlaying = false;
-
-    // Beats per minute and measure. optional because the juce doc says it is optional from the host
-    optional<double> bpMinute = std::nullopt;
-    optional<int> bpMeasure = std::nullopt;
-
-    // Maintain the most recent time we received an event. This is for keeping aware of where the 
-    // current location is in the playback. If this doesn't provide enough detail, then I might
-    // need to just keep a handle here to the pluginprocessor class so I can retrieve current
-    // playback head position on the fly ... but that feels wrong so trying to avoid it for now.
-    int64 lastEventTime = 0;
-    // Make sure the read/write of this value is atomic. Not a big deal but it could result in some
-    // glitchy scrolling if it wasn't.
-    atomic<double> lastEventTimeInSeconds = 0.0;
+    // The chords to show. The snapshot is swapped for a new one (under viewLock) when the view changes, and
+    // readers keep a reference to the one they got, so nobody has to copy the chords to look at them.
+    ChordSnapshot staticView = make_shared<const ChordTimeline>();
+    // The view before the short chords were taken out, the time of the last note event it was made from, the
+    // distinct gaps between its chords (sorted), and where the threshold used for staticView falls in those
+    // (see applyShortChordFilter). All under viewLock
+    vector<pair<float, string>> unfilteredView;
+    float unfilteredViewEnd = 0.0f;
+    vector<float> sortedChordGaps;
+    size_t filteredGapIndex = SIZE_MAX;
+    // The short chord filter is kept from one update to the next; it has seen the first shortChordsFed chords
+    // of unfilteredView, and the ones it kept are in shortChordFilterOutput. Under viewLock
+    ChordVectorType shortChordFilterOutput;
+    ChordChangeFilter shortChordFilter {0.0f, shortChordFilterOutput};
+    size_t shortChordsFed = 0;
+    atomic<int> viewVersion = 0;
+    // For finding chord progressions in staticView; rebuilt when needed (see updateProgressionIndex). Under viewLock
+    ProgressionIndex progressionIndex;
+    bool isProgressionIndexUpToDate = false;
+    void updateProgressionIndex();
+
+    // Typed copy of the settings in chordState. The getters are called every frame (and the quantization for
+    // every event on the audio thread), so they read these instead of looking up properties in the tree. They
+    // are loaded from the tree when a saved state comes in and again whenever a setter writes to it (see
+    // loadSettings), so the tree is still what gets saved.
+    struct Settings
+    {
+        atomic<float> playHeadPosition {25.0f};
+        atomic<float> timeWidth {20.0f};
+        atomic<float> shortChordThreshold {0.5f};
+        atomic<float> chordNameSize {25.0f};
+        atomic<float> arpeggioWindow {0.0f};
+        atomic<bool> spellByKey {false};
+        atomic<bool> arpeggioWindowInBeats {false};
+        atomic<int> quantizationValue {1000};
+        // If this is true, then save state changes. Otherwise, don't
+        // mlwtbd - I think I want this false by default for typical usage ... or maybe it just needs to be stored with the
+        // settings ... as false, it causes test failures, though
+        atomic<bool> allowRecording {true};
+    };
+    Settings settings;
+    juce::ChangeBroadcaster settingsBroadcaster;
+
+    // Most recent transport info from the host: where the playhead is, whether playback is occurring,
+    // tempo and time signature. This is for keeping aware of where the current location is in the playback.
+    // These used to be individual fields, but they are written on the audio thread and read on the
+    // message thread, so they need to travel together without tearing.
+    SeqLock<TransportSnapshot> transport;
+    atomic<double> sampleRate = 0.0;
 
     // simple optimization tool. The normal process of adding values to the midistore will
     // be "in order". For example, playing a track from the start (or any position) will mean
@@ -162,15 +266,22 @@ private:
     // If we know the max stored, then this helps us decide if we need to insert in tne middle.
     int64 maxTimeStored = 0;
 
-    vector <pair<float, string>> createStaticView();
+    vector <pair<float, string>> createStaticView(float &lastEventSeconds);
     vector<pair<float, string>> getChordsInWindowRaw(pair<float, float> viewWindow);
-    void removeShortChords(vector<pair<float, string>> &view);
-    void updateCurrentlyOn(ValueTree &childEvents, set<int> &notes, int propIndex);
+    void applyShortChordFilter();
+    void feedShortChordFilter();
+    void updateCurrentlyOn(ValueTree &childEvents, NoteSet &notes, int propIndex, NoteSet *touched = nullptr);
+    void replayNoteEvents(vector<NoteSet> &noteSets, const vector<double> &secondsColumn, int threads);
+    int getViewBuildThreads();
+    static size_t getViewBuildChunkCount(size_t eventCount, int threads);
+    // smallest piece of the events worth handing to another thread when building the view
+    static constexpr size_t minEventsPerChunk = 2048;
+    atomic<int> maxViewBuildThreads = 0;
     Identifier noteIdentFromInt(int note);
     int64 quantizeEventTime(int64 time);
 
     Identifier notesAtIdent(int64 time);
-    bool noteIdentToInt(String str, int *value);
+    bool noteIdentToInt(const String &str, int *value);
     ValueTree ensureNoteEventAtTime(int64 time);
 
     int64 findMaxTime();
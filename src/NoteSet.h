@@ -0,0 +1,178 @@
+/**
+ * @file NoteSet.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+using namespace std;
+
+
+/**
+ * @brief A set of MIDI notes (0-127), stored as one bit per note.
+ * @details
+ * This is what gets passed around for "the notes that are on right now". It is two words, so copying one
+ * is free and nothing ever allocates; the set operations are a couple of bitwise instructions. Iterating
+ * goes through the notes in ascending order (just like a set<int>). Notes outside of 0-127 are ignored.
+ */
+class NoteSet
+{
+public:
+    constexpr NoteSet() = default;
+    constexpr NoteSet(uint64_t lowWord, uint64_t highWord) : low(lowWord), high(highWord) {}
+    // Careful: NoteSet{a, b} is the notes a and b. Use NoteSet(low, high) for the raw words.
+    constexpr NoteSet(initializer_list<int> notes)
+    {
+        for (int note : notes)
+            add(note);
+    }
+
+    static NoteSet fromVector(const vector<int> &notes)
+    {
+        NoteSet set;
+        for (int note : notes)
+            set.add(note);
+        return set;
+    }
+
+    vector<int> toVector() const
+    {
+        vector<int> notes;
+        notes.reserve(static_cast<size_t>(size()));
+        for (int note : *this)
+            notes.push_back(note);
+        return notes;
+    }
+
+    constexpr void add(int note) { set(note, true); }
+    constexpr void remove(int note) { set(note, false); }
+    constexpr void set(int note, bool on)
+    {
+        if (note < 0 || note > 127)
+            return;
+        uint64_t &word = note < 64 ? low : high;
+        uint64_t bit = uint64_t(1) << (note & 63);
+        word = on ? (word | bit) : (word & ~bit);
+    }
+    constexpr bool contains(int note) const
+    {
+        if (note < 0 || note > 127)
+            return false;
+        return (((note < 64 ? low : high) >> (note & 63)) & 1) != 0;
+    }
+    constexpr void clear() { low = high = 0; }
+
+    constexpr bool isEmpty() const { return (low | high) == 0; }
+    constexpr int size() const { return popCount(low) + popCount(high); }
+    // The bottom (bass) note; -1 if the set is empty
+    constexpr int lowest() const
+    {
+        return low != 0 ? trailingZeros(low) : (high != 0 ? 64 + trailingZeros(high) : -1);
+    }
+    // The top note; -1 if the set is empty
+    constexpr int highest() const
+    {
+        return high != 0 ? 64 + highestBit(high) : (low != 0 ? highestBit(low) : -1);
+    }
+
+    /**
+     * @brief Fold all the notes into a single octave: bit n of the result is set if any note with pitch class
+     * n (C = 0) is in the set. Just shifts and ORs; note 64 is pitch class 4, so the high word's classes get
+     * rotated up by 4.
+     */
+    constexpr uint32_t pitchClasses() const
+    {
+        uint32_t highClasses = foldOctaves(high);
+        return foldOctaves(low) | (((highClasses << 4) | (highClasses >> 8)) & 0xfff);
+    }
+
+    constexpr uint64_t getLowWord() const { return low; }
+    constexpr uint64_t getHighWord() const { return high; }
+
+    constexpr NoteSet operator|(const NoteSet &other) const { return NoteSet(low | other.low, high | other.high); }
+    constexpr NoteSet operator&(const NoteSet &other) const { return NoteSet(low & other.low, high & other.high); }
+    constexpr NoteSet operator^(const NoteSet &other) const { return NoteSet(low ^ other.low, high ^ other.high); }
+    // notes in this set that are not in the other one
+    constexpr NoteSet operator-(const NoteSet &other) const { return NoteSet(low & ~other.low, high & ~other.high); }
+    constexpr NoteSet &operator|=(const NoteSet &other) { return *this = *this | other; }
+    constexpr NoteSet &operator&=(const NoteSet &other) { return *this = *this & other; }
+    constexpr NoteSet &operator-=(const NoteSet &other) { return *this = *this - other; }
+    constexpr bool operator==(const NoteSet &other) const { return low == other.low && high == other.high; }
+    constexpr bool operator!=(const NoteSet &other) const { return !(*this == other); }
+
+    /**
+     * @brief Walks the notes from lowest to highest
+     */
+    class Iterator
+    {
+    public:
+        constexpr Iterator(uint64_t lowWord, uint64_t highWord) : low(lowWord), high(highWord) {}
+        constexpr int operator*() const { return low != 0 ? trailingZeros(low) : 64 + trailingZeros(high); }
+        constexpr Iterator &operator++()
+        {
+            // clear the lowest bit
+            if (low != 0)
+                low &= low - 1;
+            else
+                high &= high - 1;
+            return *this;
+        }
+        constexpr bool operator!=(const Iterator &other) const { return low != other.low || high != other.high; }
+        constexpr bool operator==(const Iterator &other) const { return !(*this != other); }
+
+    private:
+        uint64_t low;
+        uint64_t high;
+    };
+
+    constexpr Iterator begin() const { return {low, high}; }
+    constexpr Iterator end() const { return {0, 0}; }
+
+private:
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    static constexpr int popCount(uint64_t word)
+    {
+        word = word - ((word >> 1) & 0x5555555555555555ULL);
+        word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+        word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        return static_cast<int>((word * 0x0101010101010101ULL) >> 56);
+    }
+    // word must not be zero
+    static constexpr int trailingZeros(uint64_t word)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(word);
+#else
+        return popCount((word & (0 - word)) - 1);
+#endif
+    }
+    // word must not be zero
+    static constexpr int highestBit(uint64_t word)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(word);
+#else
+        int bit = 0;
+        while (word >>= 1)
+            bit++;
+        return bit;
+#endif
+    }
+    // Bit k of the word is pitch class k % 12, so OR together the 12 bit groups (and the 4 bits left over)
+    static constexpr uint32_t foldOctaves(uint64_t word)
+    {
+        return static_cast<uint32_t>((word & 0xfff) | ((word >> 12) & 0xfff) | ((word >> 24) & 0xfff) |
+                                     ((word >> 36) & 0xfff) | ((word >> 48) & 0xfff) | (word >> 60));
+    }
+};
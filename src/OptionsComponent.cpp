@@ -58,8 +58,21 @@ OptionsComponent::OptionsComponent(MidiStore &ms) : midiState(ms)
     propsPanel.addAndMakeVisible(chordFontSizeLabel);
     chordFontSizeLabel.setText("Font size", juce::dontSendNotification);
 
+    // Window for collecting the notes of broken chords (0 is off)
+    propsPanel.addAndMakeVisible(&arpeggioSlider);
+    setSliderColors(arpeggioSlider);
+    arpeggioSlider.setRange(0.0, 2.0, 0.05);
+    arpeggioSlider.setTextValueSuffix(" sec");
+    arpeggioLabel.attachToComponent(&arpeggioSlider, true);
+    propsPanel.addAndMakeVisible(arpeggioLabel);
+    arpeggioLabel.setText("Arpeggio", juce::dontSendNotification);
+    arpeggioInBeatsToggle.setButtonText("In Beats");
+    propsPanel.addAndMakeVisible(&arpeggioInBeatsToggle);
+
     recordingOnToggle.setButtonText("Record Notes");
     propsPanel.addAndMakeVisible(&recordingOnToggle);
+    spellByKeyToggle.setButtonText("Spell by Key");
+    propsPanel.addAndMakeVisible(&spellByKeyToggle);
     resetChordsButton.setButtonText("Clear Notes!");
     propsPanel.addAndMakeVisible(&resetChordsButton);
 
@@ -67,6 +80,8 @@ OptionsComponent::OptionsComponent(MidiStore &ms) : midiState(ms)
     resetChordsButton.onClick = [this] { resetClick(); };
     recordingOnToggle.onStateChange = [this] { recordingClick(recordingOnToggle.getToggleState()); };
     recordingOnToggle.setToggleState(ms.getRecordingState(), juce::sendNotification);
+    spellByKeyToggle.onStateChange = [this] { spellByKeyClick(spellByKeyToggle.getToggleState()); };
+    spellByKeyToggle.setToggleState(ms.getSpellChordsByKey(), juce::sendNotification);
 
     positionOfPlayheadSlider.onValueChange = [this] { adjustPositionPlayhead(positionOfPlayheadSlider.getValue()); };
     positionOfPlayheadSlider.setValue(ms.getPlayHeadPosition(), juce::sendNotification);
@@ -80,10 +95,18 @@ OptionsComponent::OptionsComponent(MidiStore &ms) : midiState(ms)
     chordFontSizeSlider.onValueChange = [this] { adjustChordFontSize(chordFontSizeSlider.getValue()); };
     chordFontSizeSlider.setValue(ms.getChordNameSize(), juce::sendNotification);
 
+    arpeggioInBeatsToggle.onStateChange = [this] { arpeggioInBeatsClick(arpeggioInBeatsToggle.getToggleState()); };
+    arpeggioInBeatsToggle.setToggleState(ms.getArpeggioWindowInBeats(), juce::sendNotification);
+    arpeggioSlider.onValueChange = [this] { adjustArpeggioWindow(arpeggioSlider.getValue()); };
+    arpeggioSlider.setValue(ms.getArpeggioWindow(), juce::sendNotification);
+
     propsPanel.addAndMakeVisible(&aboutBoxButton);
     aboutBoxButton.setButtonText("About...");
     aboutBoxButton.onClick = [this] { showAboutBox(); };
 
+    // Keep the controls up to date if the settings are changed some other way (e.g., the host loads a preset)
+    ms.addSettingsListener(this);
+
     this->resized();
 }
 
@@ -109,14 +132,36 @@ void OptionsComponent::resetClick()
     midiState.clear();
 }
 
+OptionsComponent::~OptionsComponent()
+{
+    midiState.removeSettingsListener(this);
+}
+
 /**
  * @brief Update the controls to the current settings in the state tree
  */
 void OptionsComponent::refreshControlState()
 {
     recordingOnToggle.setToggleState(midiState.getRecordingState(), juce::sendNotification);
+    spellByKeyToggle.setToggleState(midiState.getSpellChordsByKey(), juce::sendNotification);
+    arpeggioInBeatsToggle.setToggleState(midiState.getArpeggioWindowInBeats(), juce::sendNotification);
+    arpeggioSlider.setValue(midiState.getArpeggioWindow(), juce::sendNotification);
     positionOfPlayheadSlider.setValue(midiState.getPlayHeadPosition(), juce::sendNotification);
     timeWidthSlider.setValue(midiState.getTimeWidth(), juce::sendNotification);
+    shortChordSlider.setValue(midiState.getShortChordThreshold(), juce::sendNotification);
+    chordFontSizeSlider.setValue(midiState.getChordNameSize(), juce::sendNotification);
+}
+
+/**
+ * @brief The store lets us know when the settings change. Most of the time it is one of these controls that
+ * changed it, and setting a control to the value it already has does nothing, so this only really does
+ * anything when the change came from somewhere else (e.g., the host loading a saved state).
+ * 
+ * @param source 
+ */
+void OptionsComponent::changeListenerCallback(juce::ChangeBroadcaster *source __attribute__((unused)))
+{
+    refreshControlState();
 }
 
 // Handlers for changes in the settings (update the state tree with the info)
@@ -140,9 +185,30 @@ void OptionsComponent::adjustChordFontSize(double value)
     midiState.setChordNameSize(static_cast<float>(value));
 }
 
+void OptionsComponent::adjustArpeggioWindow(double value)
+{
+    midiState.setArpeggioWindow(static_cast<float>(value));
+}
+
 void OptionsComponent::recordingClick(bool state)
 {
-    midiState.allowStateChange(state);
+    // onStateChange fires on mouse over too, so only touch the setting when it actually changes
+    if (state != midiState.getRecordingState())
+        midiState.allowStateChange(state);
+}
+
+void OptionsComponent::spellByKeyClick(bool state)
+{
+    // onStateChange fires on mouse over too, so only touch the setting when it actually changes
+    if (state != midiState.getSpellChordsByKey())
+        midiState.setSpellChordsByKey(state);
+}
+
+void OptionsComponent::arpeggioInBeatsClick(bool state)
+{
+    if (state != midiState.getArpeggioWindowInBeats())
+        midiState.setArpeggioWindowInBeats(state);
+    arpeggioSlider.setTextValueSuffix(state ? " beats" : " sec");
 }
 
 void OptionsComponent::showAboutBox()
@@ -177,6 +243,12 @@ void OptionsComponent::resized() // override
     column = shortChordSlider.getBounds().getTopLeft().getX() + shortChordSlider.getBounds().getWidth() + 30;
     recordingOnToggle.setBounds(column, area.getHeight() / 3 - controlHeight / 2, 100, controlHeight);
     resetChordsButton.setBounds(column, area.getHeight() * 2 / 3 - buttonHeight / 2, 100, buttonHeight);
+    column += recordingOnToggle.getBounds().getWidth() + 20;
+    spellByKeyToggle.setBounds(column, area.getHeight() / 3 - controlHeight / 2, 110, controlHeight);
+    arpeggioInBeatsToggle.setBounds(column, area.getHeight() * 2 / 3 - controlHeight / 2, 110, controlHeight);
+
+    column += spellByKeyToggle.getBounds().getWidth() + 80;
+    arpeggioSlider.setBounds(column, area.getHeight() / 3 - controlHeight / 2, 160, controlHeight);
 
     // this "sticks" the about... button to the right hand side
     column = area.getWidth() - 125;
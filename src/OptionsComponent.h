@@ -18,10 +18,12 @@
 /**
  * @brief Provide a set of controls for affecting the behavior of the plugin
  */
-class OptionsComponent : public juce::Component
+class OptionsComponent : public juce::Component,
+                         public juce::ChangeListener
 {
 public:
     OptionsComponent(MidiStore&);
+    ~OptionsComponent() override;
 
     void resetClick();
 
@@ -29,18 +31,24 @@ public:
     void adjustTimeWidth(double value);
     void adjustShortChordThreshold(double value);
     void adjustChordFontSize(double value);
+    void adjustArpeggioWindow(double value);
     void showAboutBox();
 
     void recordingClick(bool state);
+    void spellByKeyClick(bool state);
+    void arpeggioInBeatsClick(bool state);
 
 
     void refreshControlState();
+    // The settings changed (e.g., the host loaded a saved state)
+    void changeListenerCallback(juce::ChangeBroadcaster *source) override;
 
 private:
     MidiStore &midiState;
     juce::GroupComponent propsPanel;
     juce::TextButton resetChordsButton;
     juce::ToggleButton recordingOnToggle;
+    juce::ToggleButton spellByKeyToggle;
     juce::Label playheadLabel;
     juce::Slider positionOfPlayheadSlider;
     juce::Label timeWidthLabel;
@@ -49,6 +57,9 @@ private:
     juce::Slider shortChordSlider;
     juce::Label chordFontSizeLabel;
     juce::Slider chordFontSizeSlider;
+    juce::Label arpeggioLabel;
+    juce::Slider arpeggioSlider;
+    juce::ToggleButton arpeggioInBeatsToggle;
     juce::TextButton aboutBoxButton;
     AboutBox aboutBox;
 
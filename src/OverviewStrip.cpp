@@ -0,0 +1,76 @@
+/**
+ * @file OverviewStrip.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+
+#include "OverviewStrip.h"
+#include "ChordName.h"
+
+using namespace std;
+using namespace juce;
+
+OverviewStrip::OverviewStrip(MidiStore &ms, ChordView &view) : midiState(ms), chordView(view)
+{
+    // It doesn't need to be as smooth as the chord view; the box just creeps along
+    setFramesPerSecond(15);
+}
+
+
+void OverviewStrip::update()
+{
+    // Nothing happens here unless there is a new view of the chords, and then it is mostly just the end
+    // of the song that gets worked out again
+    overview.update(midiState.getViewSnapshot());
+}
+
+
+void OverviewStrip::paint(juce::Graphics &g)
+{
+    g.fillAll(juce::Colours::white);
+    float width = static_cast<float>(getWidth());
+    float height = static_cast<float>(getHeight());
+
+    // The whole song, or at least as much as the chord view shows (so the box fits)
+    ViewWindowType viewWindow = chordView.getViewWindow();
+    double songLength = jmax(overview.getLength(), static_cast<double>(viewWindow.second), 1.0);
+    float ratio = width / static_cast<float>(songLength);
+
+    // One level of the overview has bins about a pixel wide, so this is about as many blocks as pixels
+    overview.getSegments(0.0, songLength, getWidth(), segments);
+    for (const OverviewSegment &segment : segments)
+    {
+        g.setColour(getChordColour(segment.chord));
+        g.fillRect(segment.start * ratio, 0.0f, (segment.end - segment.start) * ratio, height);
+    }
+
+    // The part in the chord view
+    float left = jmax(0.0f, viewWindow.first * ratio);
+    float right = jmin(width, viewWindow.second * ratio);
+    g.setColour(juce::Colours::black.withAlpha(0.15f));
+    g.fillRect(left, 0.0f, right - left, height);
+    g.setColour(juce::Colours::black);
+    g.drawRect(left, 0.0f, right - left, height, 1.0f);
+    g.drawRect(getLocalBounds(), 1);
+}
+
+
+/**
+ * @brief The color to draw a chord in. The hue goes with the root (so all the C chords are about the same
+ * color), and the different kinds of chords on that root are lighter or darker.
+ *
+ * @param chord
+ * @return juce::Colour
+ */
+juce::Colour OverviewStrip::getChordColour(ChordId chord)
+{
+    // Around the circle of fifths, so chords that go together are close in color
+    int fifths = (ChordName::chordIdRoot(chord) * 7) % 12;
+    float brightness = 0.95f - 0.12f * static_cast<float>(ChordName::chordIdQuality(chord) % 4);
+    return juce::Colour::fromHSV(static_cast<float>(fifths) / 12.0f, 0.45f, brightness, 1.0f);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file OverviewStrip.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <juce_graphics/juce_graphics.h>
+#include <juce_gui_extra/juce_gui_extra.h>
+
+#include "MidiStore.h"
+#include "ChordOverview.h"
+#include "ChordView.h"
+
+using namespace std;
+
+
+/**
+ * @brief A thin strip above the chord view with the whole song in it: a colored block for each chord (the
+ * color goes with the root) and a box around the part that the chord view is showing.
+ */
+class OverviewStrip : public juce::AnimatedAppComponent
+{
+public:
+    OverviewStrip(MidiStore&, ChordView&);
+
+    void update() override;
+    void paint(juce::Graphics &g) override;
+
+    static juce::Colour getChordColour(ChordId chord);
+
+private:
+    MidiStore &midiState;
+    ChordView &chordView;
+    ChordOverview overview;
+    // reused from one paint to the next
+    vector<OverviewSegment> segments;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OverviewStrip)
+};
@@ -0,0 +1,70 @@
+/**
+ * @file PlayheadEstimator.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "PlayheadEstimator.h"
+#include <cmath>
+
+using namespace std;
+
+
+/**
+ * @brief Move the estimate along to now. This is expected to be called every frame.
+ *
+ * @param transport                the most recent block from the audio thread
+ * @param fallbackElapsedSeconds   time since the last call, for when the block isn't stamped (see above)
+ * @return double                  the playhead position (seconds)
+ */
+double PlayheadEstimator::update(const TransportSnapshot &transport, double fallbackElapsedSeconds)
+{
+    int64 now = clock();
+    bool isStamped = transport.hostTimeNs != 0;
+    double elapsed = fallbackElapsedSeconds;
+    if (isStamped)
+        elapsed = lastUpdateNs != 0 ? static_cast<double>(now - lastUpdateNs) / 1.0e9 : 0.0;
+    lastUpdateNs = now;
+
+    bool isNewBlock = transport.timeInSeconds != lastTransportTime || transport.hostTimeNs != lastHostTimeNs;
+    bool hasMoved = transport.timeInSeconds != lastTransportTime;
+    lastTransportTime = transport.timeInSeconds;
+    lastHostTimeNs = transport.hostTimeNs;
+
+    if (!transport.isPlaying)
+    {
+        // Stopped: only follow the host if it moves the playhead (otherwise the scroll wheel can move it)
+        if (hasMoved)
+            position = transport.timeInSeconds;
+        unstampedTarget = position;
+        wasPlaying = false;
+        return position;
+    }
+
+    // Where the host says the playhead is by now
+    double target;
+    if (isStamped)
+        target = transport.timeInSeconds + static_cast<double>(jmax(int64(0), now - transport.hostTimeNs)) / 1.0e9;
+    else
+    {
+        unstampedTarget = isNewBlock ? transport.timeInSeconds : unstampedTarget + elapsed;
+        target = unstampedTarget;
+    }
+
+    double predicted = position + elapsed;
+    double error = target - predicted;
+    if (!wasPlaying || fabs(error) > maxCorrection)
+        position = target;
+    else
+    {
+        // Steer a bit of the way there, but never backwards (a little slower for a bit instead)
+        double steered = predicted + error * (1.0 - exp(-elapsed / correctionTime));
+        position = jmax(position, steered);
+    }
+    wasPlaying = true;
+    return position;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file PlayheadEstimator.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <functional>
+#include "TransportSnapshot.h"
+
+using namespace std;
+
+
+/**
+ * @brief Where the playhead is right now (for drawing), between the positions the host gives us.
+ * @details
+ * The host only tells us the position once per audio block, and with big buffers that is a long time
+ * between updates (2048 samples at 44.1k is almost 50ms). The audio thread stamps every block with the
+ * monotonic clock (hostTimeNs), so the position "now" is the block's position plus the time since it was
+ * stamped. That would be exact if the blocks were stamped at exactly the right time, but they are stamped
+ * whenever the host gets around to calling us, which jitters by a millisecond or more.
+ *
+ * So the estimate runs on its own clock (it just moves along with the time) and is steered towards where
+ * the blocks say it should be a little at a time. That takes out the jitter and never makes it jump. It
+ * only jumps when it is far off (starting playback, a seek, a loop going back to its start), or when
+ * playback is stopped and the host moves the playhead.
+ *
+ * Without the stamps (hostTimeNs is zero, e.g., from tests or an older store) the time since the block is
+ * unknown, so the target is the block's position moved along by the frame times since it arrived.
+ *
+ * The clock can be swapped out (for the tests). It must be the same one the blocks were stamped with.
+ */
+class PlayheadEstimator
+{
+public:
+    typedef function<int64()> Clock;
+
+    // How quickly the estimate is steered back to the target (seconds for about two thirds of the error)
+    static constexpr double correctionTime = 0.25;
+    // Further off than this and it goes straight there
+    static constexpr double maxCorrection = 0.25;
+
+    explicit PlayheadEstimator(Clock clockToUse = getMonotonicNanos) : clock(std::move(clockToUse)) {}
+
+    double update(const TransportSnapshot &transport, double fallbackElapsedSeconds);
+    double getPosition() const { return position; }
+    void moveTo(double seconds) { position = seconds; }
+
+private:
+    Clock clock;
+    double position = 0.0;
+    // what the most recent block said and when this last ran
+    double lastTransportTime = 0.0;
+    int64 lastHostTimeNs = 0;
+    int64 lastUpdateNs = 0;
+    bool wasPlaying = false;
+    // where the block without a stamp says the playhead is by now
+    double unstampedTarget = 0.0;
+};
@@ -17,14 +17,15 @@ using std::unordered_set;
 
 //==============================================================================
 MidiChordsAudioProcessorEditor::MidiChordsAudioProcessorEditor (MidiChordsAudioProcessor& p, MidiStore& ms)
-    : AudioProcessorEditor (&p), juce::Timer(), audioProcessor (p), options(ms), chordView(ms)
+    : AudioProcessorEditor (&p), juce::Timer(), audioProcessor (p), options(ms), chordView(ms), overviewStrip(ms, chordView)
 {
     getLookAndFeel().setDefaultLookAndFeel(&lookAndFeel);
     setResizable(true, true);
-    setSize (1000, 210);
+    setSize (1000, 234);
 
     addAndMakeVisible(&options);
     addAndMakeVisible(&chordView);
+    addAndMakeVisible(&overviewStrip);
 
 
     Timer::startTimer(500);
@@ -42,19 +43,8 @@ void MidiChordsAudioProcessorEditor::timerCallback()
     // this when actual changes occur (e.g., when isViewUpToDate is set to false and for props like allowStateChange)
     // this->audioProcessor.updateHostDisplay(AudioPluginInstance::ChangeDetails{}.withNonParameterStateChanged(true));
 
-
-    // This is very cheesy - refresh the control settings in case the state has changed. I need to figure
-    // out the listener stuff better. But there are very few controls, so not expensive
-    // Current thinking for better solution:
-    //  - Add a new child valuetree in the main state tree that stores prop values (e.g., scroll view window width, playhead position)
-    //  - Put a broadcaster on that tree; then it should be efficient and not trigger for any of the other tree changes (e.g., new notes)
-    //  - Add a listener for those state changes and call the refreshControlState
-    //  - The tricky bit is that I blow away the entire state tree on the load of the state (in PluginProcessor.cpp). I would
-    //    need to somehow reestablish that listener. Or maybe just move that props child tree to the new tree. A valuetree can
-    //    have only one parent, so I suspect that is a simple operation.
-    options.refreshControlState();
-
-
+    // The options component listens for settings changes itself (see MidiStore::addSettingsListener), so this
+    // is just for keeping the view of the chords up to date.
     MidiStore *ms = audioProcessor.getMidiState();
     ms->updateStaticViewIfOutOfDate();
 
@@ -77,5 +67,6 @@ void MidiChordsAudioProcessorEditor::resized()
 {
     // sets the position and size of the slider with arguments (x, y, width, height)
     options.setBounds(0, getHeight() - 100, getWidth(), 100);
-    chordView.setBounds(0, 10, getWidth(), getHeight() - 120);
+    overviewStrip.setBounds(0, 10, getWidth(), 20);
+    chordView.setBounds(0, 34, getWidth(), getHeight() - 144);
 }
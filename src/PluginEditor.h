@@ -12,6 +12,7 @@
 #include "PluginProcessor.h"
 #include "OptionsComponent.h"
 #include "ChordView.h"
+#include "OverviewStrip.h"
 
 //==============================================================================
 /**
@@ -37,6 +38,7 @@ private:
 
     OptionsComponent options;
     ChordView chordView;
+    OverviewStrip overviewStrip;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiChordsAudioProcessorEditor)
 };
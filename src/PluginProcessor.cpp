@@ -25,6 +25,7 @@ MidiChordsAudioProcessor::MidiChordsAudioProcessor()
                        )
 #endif
 {
+    midiState.setWorkerPool(&workerPool);
 }
 
 MidiChordsAudioProcessor::~MidiChordsAudioProcessor()
@@ -108,6 +109,7 @@ void MidiChordsAudioProcessor::prepareToPlay (double sampleRate, int samplesPerB
     DBG("prepareToPlay called");
     this->currentSampleRate = sampleRate;
     this->currentSamplesPerBlock = samplesPerBlock;
+    this->midiState.setSampleRate(sampleRate);
 }
 
 void MidiChordsAudioProcessor::releaseResources()
@@ -144,17 +146,14 @@ bool MidiChordsAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 
 void MidiChordsAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    juce::ignoreUnused(buffer);
-    pair<int64, double> posOfBlock = currentPlayheadPosition();
-
-    if (auto positionInfo = getPlayHead()->getPosition())
+    TransportSnapshot transport = readTransport();
+    this->midiState.publishTransport(transport);
+    if (transport.isPlaying && transport.hasPpq && transport.bpm > 0.0)
     {
-        this->midiState.setIsPlaying(positionInfo->getIsPlaying());
-
-        if (auto bpMeasure = positionInfo->getTimeSignature())
-            this->midiState.setBPMeasure(bpMeasure->numerator);
-        if (auto bpMinute = positionInfo->getBpm())
-            this->midiState.setBPMinute(*bpMinute);
+        double blockEndPpq = transport.ppqAtSampleOffset(buffer.getNumSamples(), this->currentSampleRate);
+        midiState.recordTempo(transport.ppqPosition, blockEndPpq, transport.bpm, transport.timeInSeconds);
+        if (transport.hasBarStart && transport.timeSigNumerator > 0)
+            midiState.recordMeter(transport.barStartPpq, transport.timeSigNumerator, transport.timeSigDenominator);
     }
 
     for (const auto metadata : midiMessages)
@@ -162,24 +161,18 @@ void MidiChordsAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
         auto message = metadata.getMessage();
         
         int noteNumber = message.getNoteNumber();
-        auto messageEventTime = (int64)message.getTimeStamp() + posOfBlock.first;
-        if (message.isNoteOn())
-        {
-            midiState.addNoteEventAtTime(messageEventTime, noteNumber, true);
-            // mlwtbd - Store the current time in seconds that "might be" associated with this event.
-            // However this value is the current position of the playhead ... and we are offsetting the
-            // actual event time by the metadata.samplePosition. There is the concept of:
-            // MidiFile::convertTimestampTicksToSeconds; but this isn't a midi file so I don't have that
-            // context. Observation shows that the behavior is as desired. But not sure it will always
-            // work that way. Need to keep an eye on it.
-            // Maybe the samplesPerBlock from PrepareToPlay would give me that info?
-            midiState.setEventTimeSeconds(messageEventTime, posOfBlock.second);
-        }
-        if (message.isNoteOff()) 
+        auto messageEventTime = (int64)message.getTimeStamp() + transport.timeInSamples;
+        // The seconds from the host are for the start of the block; the event is samplePosition samples
+        // into it. With big mixdown buffers (1024-2048 samples) that difference is tens of milliseconds.
+        double messageEventSeconds = transport.secondsAtSampleOffset(metadata.samplePosition, this->currentSampleRate);
+        if (message.isNoteOn() || message.isNoteOff())
         {
-            // DBG("Note off: " + message.getDescription());
-            midiState.addNoteEventAtTime(messageEventTime, noteNumber, false);
-            midiState.setEventTimeSeconds(messageEventTime, posOfBlock.second);
+            midiState.addNoteEventAtTime(messageEventTime, noteNumber, message.isNoteOn());
+            midiState.setEventTimeSeconds(messageEventTime, messageEventSeconds);
+            // The musical position is what really identifies the event; if the tempo of the song changes
+            // later, the seconds can be recomputed from it
+            if (transport.hasPpq)
+                midiState.setEventTimePpq(messageEventTime, transport.ppqAtSampleOffset(metadata.samplePosition, this->currentSampleRate));
         }
         //juce::String raw = String::toHexString(message.getRawData(), message.getRawDataSize());
         //juce::String raw = String::toHexString(message.getSysExData(), message.getSysExDataSize());
@@ -189,36 +182,56 @@ void MidiChordsAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
 }
 
 /**
- * @brief Retrieve the current playhead position in time
+ * @brief Retrieve the current transport info (playhead position in time, tempo, etc.) for this block
  * This is from code provided in response to my question about how to find this:
  * https://forum.juce.com/t/processblock-sampleposition-gettimestamp-interpretation/56172/3?u=tetrachord
  *
- * This also updates the most recently seen time values in the reference track for use by the display
+ * This asks the host exactly once per block. Anything the host does not provide this time around keeps
+ * the value from the previous block.
  * 
- * @return pair<int64, double> event time and time in seconds
+ * @return TransportSnapshot
  */
-pair<int64, double> MidiChordsAudioProcessor::currentPlayheadPosition()
+TransportSnapshot MidiChordsAudioProcessor::readTransport()
 {
-    int64 currentTime = 0;
-    double timeInSeconds = 0.0;
+    TransportSnapshot transport = this->lastTransport;
     if (auto *playHead = getPlayHead())
     {
         if (auto position = playHead->getPosition())
         {
             if (auto samplePos = position->getTimeInSamples())
+                transport.timeInSamples = *samplePos;
+            if (auto seconds = position->getTimeInSeconds())
+                transport.timeInSeconds = *seconds;
+            else if (position->getTimeInSamples() && this->currentSampleRate > 0.0)
+                transport.timeInSeconds = static_cast<double>(transport.timeInSamples) / this->currentSampleRate;
+            // Don't carry the PPQ over from an earlier block; a stale musical position is worse than none
+            transport.hasPpq = false;
+            transport.hasBarStart = false;
+            if (auto ppq = position->getPpqPosition())
             {
-                currentTime = *samplePos;
-                midiState.setLastEventTime(currentTime);
+                transport.ppqPosition = *ppq;
+                transport.hasPpq = true;
             }
-            if (auto seconds = position->getTimeInSeconds())
+            if (auto barStart = position->getPpqPositionOfLastBarStart())
+            {
+                transport.barStartPpq = *barStart;
+                transport.hasBarStart = true;
+            }
+            if (auto bpm = position->getBpm())
+                transport.bpm = *bpm;
+            if (auto timeSig = position->getTimeSignature())
             {
-                timeInSeconds = *seconds;
-                midiState.setLastEventTimeInSeconds(*seconds);
+                transport.timeSigNumerator = timeSig->numerator;
+                transport.timeSigDenominator = timeSig->denominator;
             }
+            transport.isPlaying = position->getIsPlaying();
+            transport.isLooping = position->getIsLooping();
         }
     }
+    transport.hostTimeNs = getMonotonicNanos();
 
-    return {currentTime, timeInSeconds};
+    this->lastTransport = transport;
+    return transport;
 }
 
 //==============================================================================
@@ -238,6 +251,7 @@ void MidiChordsAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
     // You should use this method to store your parameters in the memory block.
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
+    this->midiState.saveTempoMapToState();
     ValueTree &vt = this->midiState.getState();
     std::unique_ptr<juce::XmlElement> xml(vt.createXml());
     copyXmlToBinary(*xml, destData);
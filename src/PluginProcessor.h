@@ -64,7 +64,12 @@ public:
 
 private:
     MidiStore midiState;
-    pair<int64, double> currentPlayheadPosition();
+    // This instance's handle on the process-wide worker pool. It is declared after midiState so that it
+    // is destroyed first; its destructor waits for any of our jobs (which use midiState) still running.
+    WorkerPool::Client workerPool;
+    // The transport info most recently published to midiState. Only touched on the audio thread.
+    TransportSnapshot lastTransport;
+    TransportSnapshot readTransport();
 
     // variables for some of the pluginprocessor things I don't need yet
     int currentProgram = 0;
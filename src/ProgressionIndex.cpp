@@ -0,0 +1,213 @@
+/**
+ * @file ProgressionIndex.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "ProgressionIndex.h"
+#include <algorithm>
+
+using namespace std;
+
+
+/**
+ * @brief Index the chords of a song (replaces whatever was there)
+ *
+ * @param chords   in time order; noChord entries are allowed but never match anything
+ */
+void ProgressionIndex::build(const vector<ChordId> &chords)
+{
+    exactText.resize(chords.size());
+    for (size_t i = 0; i < chords.size(); i++)
+        exactText[i] = chords[i] == ChordName::noChord ? unknownSymbol : ChordName::chordIdUnspelled(chords[i]);
+    exactSuffixes = buildSuffixArray(exactText);
+
+    relativeText = relativeForm(chords);
+    vector<uint32_t> suffixes = buildSuffixArray(relativeText);
+    relativeSuffixes.clear();
+    relativeSuffixes.reserve(chords.size());
+    for (uint32_t suffix : suffixes)
+    {
+        if (suffix % 2 == 0)
+            relativeSuffixes.push_back(suffix);
+    }
+}
+
+
+void ProgressionIndex::clear()
+{
+    exactText.clear();
+    exactSuffixes.clear();
+    relativeText.clear();
+    relativeSuffixes.clear();
+}
+
+
+/**
+ * @brief Find every occurrence of a progression
+ *
+ * @param progression   the chords to look for
+ * @param anyKey        true to find it transposed to any key as well
+ * @return vector<size_t>   where each occurrence starts (in order)
+ */
+vector<size_t> ProgressionIndex::find(const vector<ChordId> &progression, bool anyKey) const
+{
+    vector<size_t> positions;
+    if (progression.empty())
+        return positions;
+
+    vector<uint32_t> pattern;
+    if (anyKey)
+    {
+        // The interval after the last chord of the progression isn't part of it
+        pattern = relativeForm(progression);
+        pattern.pop_back();
+    }
+    else
+    {
+        for (ChordId chord : progression)
+            pattern.push_back(chord == ChordName::noChord ? unknownSymbol : ChordName::chordIdUnspelled(chord));
+    }
+    if (std::find(pattern.begin(), pattern.end(), unknownSymbol) != pattern.end())
+        return positions;
+
+    const vector<uint32_t> &text = anyKey ? relativeText : exactText;
+    const vector<uint32_t> &suffixes = anyKey ? relativeSuffixes : exactSuffixes;
+    auto range = findRange(text, suffixes, pattern);
+    for (size_t i = range.first; i < range.second; i++)
+        positions.push_back(anyKey ? suffixes[i] / 2 : suffixes[i]);
+    sort(positions.begin(), positions.end());
+    return positions;
+}
+
+
+/**
+ * @private
+ * @brief The shape of a chord with the root taken out: the quality, whether it is a slash chord, and how far
+ * above the root the bass is
+ *
+ * @param chord
+ * @return uint32_t
+ */
+uint32_t ProgressionIndex::shapeSymbol(ChordId chord)
+{
+    if (chord == ChordName::noChord)
+        return unknownSymbol;
+    bool slash = ChordName::chordIdIsSlash(chord);
+    int bassOffset = slash ? (ChordName::chordIdBass(chord) - ChordName::chordIdRoot(chord) + 12) % 12 : 0;
+    return static_cast<uint32_t>(ChordName::chordIdQuality(chord) | (slash ? 1 << 8 : 0) | (bassOffset << 9));
+}
+
+
+/**
+ * @private
+ * @brief The interval from the root of one chord up to the root of the next. These are kept out of the way
+ * of the shape symbols, though since the two always alternate they could never be confused anyway.
+ *
+ * @param from
+ * @param to
+ * @return uint32_t
+ */
+uint32_t ProgressionIndex::intervalSymbol(ChordId from, ChordId to)
+{
+    if (from == ChordName::noChord || to == ChordName::noChord)
+        return unknownSymbol;
+    return static_cast<uint32_t>(0x10000 | ((ChordName::chordIdRoot(to) - ChordName::chordIdRoot(from) + 12) % 12));
+}
+
+
+/**
+ * @private
+ * @brief Chords in key independent form: shape, interval to the next root, shape, interval, ... shape
+ *
+ * @param chords
+ * @return vector<uint32_t>   two symbols per chord (with an unknown interval after the last one)
+ */
+vector<uint32_t> ProgressionIndex::relativeForm(const vector<ChordId> &chords)
+{
+    vector<uint32_t> text;
+    text.reserve(chords.size() * 2);
+    for (size_t i = 0; i < chords.size(); i++)
+    {
+        text.push_back(shapeSymbol(chords[i]));
+        text.push_back(i + 1 < chords.size() ? intervalSymbol(chords[i], chords[i + 1]) : unknownSymbol);
+    }
+    return text;
+}
+
+
+/**
+ * @private
+ * @brief Sort all of the suffixes of the text by prefix doubling: sort by the first symbol, then by the first
+ * two (using the ranks from the first pass), then four, and so on until every rank is different. Songs are
+ * repetitive, but even a song that is the same four chords the whole way through only takes log(n) passes.
+ *
+ * @param text
+ * @return vector<uint32_t>   starting position of each suffix, in sorted order
+ */
+vector<uint32_t> ProgressionIndex::buildSuffixArray(const vector<uint32_t> &text)
+{
+    size_t n = text.size();
+    vector<uint32_t> suffixes(n);
+    vector<uint32_t> rank(n);
+    vector<uint32_t> newRank(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        suffixes[i] = static_cast<uint32_t>(i);
+        rank[i] = text[i];
+    }
+
+    for (size_t length = 1; ; length *= 2)
+    {
+        // rank of the second half; running off the end sorts first
+        auto key = [&](uint32_t i) { return make_pair(rank[i], i + length < n ? static_cast<int64_t>(rank[i + length]) : -1); };
+        sort(suffixes.begin(), suffixes.end(), [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+
+        uint32_t nextRank = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (i > 0 && key(suffixes[i - 1]) < key(suffixes[i]))
+                nextRank++;
+            newRank[suffixes[i]] = nextRank;
+        }
+        rank.swap(newRank);
+        if (n == 0 || nextRank == n - 1 || length >= n)
+            break;
+    }
+    return suffixes;
+}
+
+
+/**
+ * @private
+ * @brief The range of the sorted suffixes that start with the pattern
+ *
+ * @param text
+ * @param suffixes   (sorted) suffixes of the text to look through
+ * @param pattern
+ * @return pair<size_t, size_t>   first and one past the last index into suffixes
+ */
+pair<size_t, size_t> ProgressionIndex::findRange(const vector<uint32_t> &text, const vector<uint32_t> &suffixes,
+                                                 const vector<uint32_t> &pattern)
+{
+    // Compare just the first pattern.size() symbols of the suffix: <0, 0 (starts with the pattern) or >0
+    auto compare = [&](uint32_t suffix)
+    {
+        for (size_t j = 0; j < pattern.size(); j++)
+        {
+            if (suffix + j >= text.size())
+                return -1;
+            if (text[suffix + j] != pattern[j])
+                return text[suffix + j] < pattern[j] ? -1 : 1;
+        }
+        return 0;
+    };
+
+    auto first = partition_point(suffixes.begin(), suffixes.end(), [&](uint32_t suffix) { return compare(suffix) < 0; });
+    auto last = partition_point(first, suffixes.end(), [&](uint32_t suffix) { return compare(suffix) == 0; });
+    return {static_cast<size_t>(first - suffixes.begin()), static_cast<size_t>(last - suffixes.begin())};
+}
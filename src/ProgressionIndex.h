@@ -0,0 +1,61 @@
+/**
+ * @file ProgressionIndex.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "ChordName.h"
+
+using namespace std;
+
+
+/**
+ * @brief Find every place a chord progression (e.g., Am F C G) shows up in the chords of a song.
+ * @details
+ * This is a suffix array over the chord ids: the starting position of every suffix of the sequence of chords,
+ * sorted. All of the suffixes that start with a given progression are next to each other in that order, so
+ * finding them is two binary searches, each comparing at most the length of the progression
+ * (O(m log n) for m chords in the progression and n in the song).
+ *
+ * For finding a progression in any key, there is a second suffix array over a "relative" form of the chords.
+ * Each chord becomes its shape (quality and where the bass is relative to the root) followed by the interval
+ * from its root up to the root of the next chord. Am F C G and Em C G D are then exactly the same thing.
+ *
+ * The spelling of the chords (G# vs Ab) is ignored.
+ */
+class ProgressionIndex
+{
+public:
+    void build(const vector<ChordId> &chords);
+    void clear();
+    size_t size() const { return exactText.size(); }
+
+    // The positions (indexes into the chords given to build) where the progression starts, in order
+    vector<size_t> find(const vector<ChordId> &progression, bool anyKey) const;
+
+private:
+    static uint32_t shapeSymbol(ChordId chord);
+    static uint32_t intervalSymbol(ChordId from, ChordId to);
+    static vector<uint32_t> relativeForm(const vector<ChordId> &chords);
+    static vector<uint32_t> buildSuffixArray(const vector<uint32_t> &text);
+    static pair<size_t, size_t> findRange(const vector<uint32_t> &text, const vector<uint32_t> &suffixes,
+                                          const vector<uint32_t> &pattern);
+
+    // never matches anything (a chord the index couldn't make sense of)
+    static constexpr uint32_t unknownSymbol = 0xffffffff;
+
+    vector<uint32_t> exactText;
+    vector<uint32_t> exactSuffixes;
+    // the relative form has two symbols per chord, but only the suffixes starting on a chord are kept
+    vector<uint32_t> relativeText;
+    vector<uint32_t> relativeSuffixes;
+};
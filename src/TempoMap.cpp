@@ -0,0 +1,413 @@
+/**
+ * @file TempoMap.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "TempoMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+// PPQ values from the host for consecutive blocks don't always line up to the last bit. Anything this
+// close to the start of a block is treated as being at the start of it (about 50 microseconds at 120 bpm)
+static const double ppqTolerance = 1.0e-4;
+// The seconds the host reports and the seconds worked out from the tempo are the same if they are this close
+static const double secondsTolerance = 1.0e-3;
+static const double noAnchor = numeric_limits<double>::quiet_NaN();
+
+
+/**
+ * @brief Record the tempo the host reported for a block of audio. This is called for every block during
+ * playback, so the common case (the tempo already matches what we have) does no allocation.
+ *
+ * @param ppqStart       PPQ position at the start of the block
+ * @param ppqEnd         PPQ position at the end of the block
+ * @param bpm            tempo during the block
+ * @param secondsStart   time in seconds the host reported at the start of the block (NaN if not known)
+ * @return bool          true if the map changed
+ */
+bool TempoMap::recordTempo(double ppqStart, double ppqEnd, double bpm, double secondsStart)
+{
+    if (bpm <= 0.0)
+        return false;
+    ppqEnd = std::max(ppqStart, ppqEnd);
+
+    auto byPpq = [](const TempoPoint &point, double ppq) { return point.ppq < ppq; };
+    auto lo = std::lower_bound(points.begin(), points.end(), ppqStart - ppqTolerance, byPpq);
+    auto hi = std::lower_bound(lo, points.end(), ppqEnd - ppqTolerance, byPpq);
+
+    // Already known? Same tempo, no changes inside the block, and the host agrees about where it is in time
+    // (it won't if a part of the song with some other tempo was skipped to get here)
+    bool sameTime = std::isnan(secondsStart) || std::abs(ppqToSeconds(ppqStart) - secondsStart) <= secondsTolerance;
+    if (!points.empty() && getTempoAt(ppqStart) == bpm && (lo == hi || (hi - lo == 1 && lo->bpm == bpm)) && sameTime)
+        return false;
+
+    // If we know what comes after this block, keep it. If not (we are recording at the end of what we
+    // know), this tempo is the best guess for the rest of the song.
+    bool keepTail = hi != points.end() && hi->ppq > ppqEnd + ppqTolerance;
+    double tailBpm = getTempoAt(ppqEnd);
+    double tailSeconds = ppqToSeconds(ppqEnd);
+
+    // The anchored points after this block that just carry on from the part before them move along with the
+    // end of this block (e.g., the tempo of this part was changed in the DAW and it's being played again).
+    // The first one that doesn't (the host jumped there, past some part we don't know) stays put, and so
+    // does everything after it.
+    double shiftUntil = numeric_limits<double>::infinity();
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const TempoPoint &point = points[i];
+        if (point.ppq < ppqEnd - ppqTolerance || std::isnan(point.anchor))
+            continue;
+        if (i == 0 || std::abs(point.anchor - (points[i - 1].seconds +
+                                               (point.ppq - points[i - 1].ppq) * 60.0 / points[i - 1].bpm)) > secondsTolerance)
+        {
+            shiftUntil = point.ppq;
+            break;
+        }
+    }
+
+    auto pos = points.erase(lo, hi);
+    pos = points.insert(pos, {ppqStart, bpm, 0.0, secondsStart});
+    if (keepTail)
+        points.insert(pos + 1, {ppqEnd, tailBpm, 0.0, noAnchor});
+    mergeAndUpdateSeconds();
+
+    double shift = ppqToSeconds(ppqStart) + (ppqEnd - ppqStart) * 60.0 / bpm - tailSeconds;
+    if (std::abs(shift) > secondsTolerance)
+    {
+        for (TempoPoint &point : points)
+        {
+            if (point.ppq >= ppqEnd - ppqTolerance && point.ppq < shiftUntil && !std::isnan(point.anchor))
+                point.anchor += shift;
+        }
+        mergeAndUpdateSeconds();
+    }
+    return true;
+}
+
+/**
+ * @brief Record the time signature the host reported for a block. Like the tempo, this is called for every
+ * block and usually finds that there is nothing to do.
+ *
+ * @param barStartPpq   PPQ position of the start of the bar the block is in
+ * @param numerator
+ * @param denominator
+ * @return bool         true if the map changed
+ */
+bool TempoMap::recordMeter(double barStartPpq, int numerator, int denominator)
+{
+    if (numerator <= 0 || denominator <= 0)
+        return false;
+
+    auto lo = std::lower_bound(meters.begin(), meters.end(), barStartPpq - ppqTolerance,
+                               [](const MeterPoint &point, double ppq) { return point.ppq < ppq; });
+    bool atPoint = lo != meters.end() && lo->ppq <= barStartPpq + ppqTolerance;
+    if (!meters.empty())
+    {
+        const MeterPoint &current = atPoint ? *lo : meters[findMeter(barStartPpq)];
+        if (current.numerator == numerator && current.denominator == denominator)
+            return false;
+    }
+
+    MeterPoint point = {barStartPpq, numerator, denominator, 0.0, 0};
+    if (atPoint)
+        *lo = point;
+    else
+        meters.insert(lo, point);
+
+    mergeAndUpdateBars();
+    return true;
+}
+
+/**
+ * @brief Index of the point whose tempo applies at ppq (the first point if ppq is before all of them)
+ * Assumes the map is not empty.
+ *
+ * @param ppq
+ * @return size_t
+ */
+size_t TempoMap::findPoint(double ppq) const
+{
+    auto next = std::upper_bound(points.begin(), points.end(), ppq,
+                                 [](double value, const TempoPoint &point) { return value < point.ppq; });
+    if (next == points.begin())
+        return 0;
+    return static_cast<size_t>(next - points.begin()) - 1;
+}
+
+/**
+ * @brief Index of the meter that applies at ppq (the first one if ppq is before all of them)
+ * Assumes there is at least one.
+ *
+ * @param ppq
+ * @return size_t
+ */
+size_t TempoMap::findMeter(double ppq) const
+{
+    auto next = std::upper_bound(meters.begin(), meters.end(), ppq,
+                                 [](double value, const MeterPoint &point) { return value < point.ppq; });
+    if (next == meters.begin())
+        return 0;
+    return static_cast<size_t>(next - meters.begin()) - 1;
+}
+
+/**
+ * @brief Tempo in beats per minute at the given position; 0 if nothing has been recorded
+ *
+ * @param ppq
+ * @return double
+ */
+double TempoMap::getTempoAt(double ppq) const
+{
+    if (points.empty())
+        return 0.0;
+    return points[findPoint(ppq)].bpm;
+}
+
+/**
+ * @brief Convert musical time to seconds from the start of the song. O(log n) in the number of tempo
+ * changes. An empty map has no idea, and returns 0.
+ *
+ * @param ppq
+ * @return double
+ */
+double TempoMap::ppqToSeconds(double ppq) const
+{
+    if (points.empty())
+        return 0.0;
+    const TempoPoint &point = points[findPoint(ppq)];
+    return point.seconds + (ppq - point.ppq) * 60.0 / point.bpm;
+}
+
+/**
+ * @brief Convert seconds from the start of the song to musical time. The inverse of ppqToSeconds.
+ *
+ * @param seconds
+ * @return double
+ */
+double TempoMap::secondsToPpq(double seconds) const
+{
+    if (points.empty())
+        return 0.0;
+    auto next = std::upper_bound(points.begin(), points.end(), seconds,
+                                 [](double value, const TempoPoint &point) { return value < point.seconds; });
+    const TempoPoint &point = next == points.begin() ? points.front() : *(next - 1);
+    return point.ppq + (seconds - point.seconds) * point.bpm / 60.0;
+}
+
+/**
+ * @brief Convert a whole column of PPQ values to seconds in one pass. The values are expected to be sorted
+ * (event order), in which case this just walks along the tempo points with them; out of order values
+ * still work, they just cost a binary search. NaN (an event without a PPQ position) gives NaN.
+ *
+ * @param ppqs      positions to convert
+ * @param seconds   receives the times; resized to match
+ */
+void TempoMap::ppqToSeconds(const vector<double> &ppqs, vector<double> &seconds) const
+{
+    seconds.resize(ppqs.size());
+    if (points.empty())
+    {
+        std::fill(seconds.begin(), seconds.end(), 0.0);
+        return;
+    }
+
+    size_t index = 0;
+    size_t count = points.size();
+    for (size_t i = 0; i < ppqs.size(); i++)
+    {
+        double ppq = ppqs[i];
+        if (ppq < points[index].ppq)
+            index = findPoint(ppq);
+        while (index + 1 < count && points[index + 1].ppq <= ppq)
+            index++;
+        const TempoPoint &point = points[index];
+        seconds[i] = point.seconds + (ppq - point.ppq) * 60.0 / point.bpm;
+    }
+}
+
+/**
+ * @brief Find the bar lines that fall inside a window of time (not including one exactly at the start).
+ * The cost is a couple of binary searches plus the number of bars found, no matter how long the song is.
+ * Nothing is found unless both a tempo and a meter are known.
+ *
+ * @param startSeconds
+ * @param endSeconds
+ * @param bars          receives (bar number, time in seconds) of each bar line in the window
+ * @param maxBars       stop after this many. The default is for a window on the screen; something that
+ *                      wants the bars of the whole song (e.g., ChordDisplayList) can pass more
+ */
+void TempoMap::getBarsInWindow(double startSeconds, double endSeconds, vector<pair<int, double>> &bars,
+                               size_t maxBars) const
+{
+    bars.clear();
+    if (points.empty() || meters.empty())
+        return;
+
+    double ppqStart = secondsToPpq(startSeconds);
+    size_t meterIndex = findMeter(ppqStart);
+    const MeterPoint *meter = &meters[meterIndex];
+    // bars (from the start of this meter) to the first one after the start of the window
+    int barOffset = static_cast<int>(std::floor((ppqStart - meter->ppq) / meter->barLength)) + 1;
+
+    while (bars.size() < maxBars)
+    {
+        double barPpq = meter->ppq + barOffset * meter->barLength;
+        if (meterIndex + 1 < meters.size() && barPpq >= meters[meterIndex + 1].ppq - ppqTolerance)
+        {
+            meter = &meters[++meterIndex];
+            barOffset = 0;
+            barPpq = meter->ppq;
+        }
+        double seconds = ppqToSeconds(barPpq);
+        if (seconds >= endSeconds)
+            break;
+        bars.push_back({meter->barNumber + barOffset, seconds});
+        barOffset++;
+    }
+}
+
+/**
+ * @brief Refresh the cached seconds of each point and drop points that don't change anything (the same
+ * tempo as the one before, at the time the one before says it is)
+ */
+void TempoMap::mergeAndUpdateSeconds()
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        TempoPoint point = points[i];
+        double worked = kept == 0 ? point.ppq * 60.0 / point.bpm
+                                  : points[kept - 1].seconds + (point.ppq - points[kept - 1].ppq) * 60.0 / points[kept - 1].bpm;
+        // (an anchor that would make time go backwards is the host being confused; ignore it)
+        bool anchored = !std::isnan(point.anchor) && (kept == 0 || point.anchor >= points[kept - 1].seconds);
+        point.seconds = anchored ? point.anchor : worked;
+        if (kept > 0 && point.bpm == points[kept - 1].bpm && (!anchored || std::abs(point.anchor - worked) <= secondsTolerance))
+            continue;
+        points[kept++] = point;
+    }
+    points.resize(kept);
+}
+
+/**
+ * @brief Drop meters that are the same as the one before and refresh the cached bar lengths and numbers.
+ * The first meter is assumed to go back to the start of the song (bar 1 starts at PPQ 0). After that, a
+ * meter change normally lands on a bar line; if not, the partial bar still counts as a bar.
+ */
+void TempoMap::mergeAndUpdateBars()
+{
+    auto last = std::unique(meters.begin(), meters.end(), [](const MeterPoint &a, const MeterPoint &b)
+                            { return a.numerator == b.numerator && a.denominator == b.denominator; });
+    meters.erase(last, meters.end());
+
+    for (size_t i = 0; i < meters.size(); i++)
+    {
+        MeterPoint &meter = meters[i];
+        meter.barLength = meter.numerator * 4.0 / meter.denominator;
+        if (i == 0)
+            meter.barNumber = static_cast<int>(std::floor(meter.ppq / meter.barLength + 1.0e-6)) + 1;
+        else
+        {
+            const MeterPoint &prev = meters[i - 1];
+            meter.barNumber = prev.barNumber + static_cast<int>(std::ceil((meter.ppq - prev.ppq) / prev.barLength - 1.0e-6));
+        }
+    }
+}
+
+/**
+ * @brief Serialize as "ppq:bpm;ppq:bpm@seconds;..." followed by "|ppq:num/den;..." if there are meters. The
+ * "@seconds" is only there for a point anchored to the host's time. This is saved in the plugin state.
+ *
+ * @return string
+ */
+string TempoMap::toString() const
+{
+    ostringstream oss;
+    oss << setprecision(15);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (i > 0)
+            oss << ";";
+        oss << points[i].ppq << ":" << points[i].bpm;
+        if (!std::isnan(points[i].anchor))
+            oss << "@" << points[i].anchor;
+    }
+    if (!meters.empty())
+    {
+        oss << "|";
+        for (size_t i = 0; i < meters.size(); i++)
+        {
+            if (i > 0)
+                oss << ";";
+            oss << meters[i].ppq << ":" << meters[i].numerator << "/" << meters[i].denominator;
+        }
+    }
+    return oss.str();
+}
+
+/**
+ * @brief Restore from the toString() form (which may or may not have the meters). The map is left alone
+ * if the string isn't valid.
+ *
+ * @param str
+ * @return bool   true if it was valid
+ */
+bool TempoMap::fromString(const string &str)
+{
+    vector<TempoPoint> newPoints;
+    vector<MeterPoint> newMeters;
+    size_t split = str.find('|');
+    istringstream iss(str.substr(0, split));
+    string item;
+    while (getline(iss, item, ';'))
+    {
+        istringstream itemStream(item);
+        double ppq;
+        double bpm;
+        char separator;
+        if (!(itemStream >> ppq >> separator >> bpm) || separator != ':' || !std::isfinite(ppq) ||
+            !std::isfinite(bpm) || bpm <= 0.0)
+            return false;
+        // (older saved states don't have the anchors)
+        double anchor = noAnchor;
+        if (itemStream >> separator && (separator != '@' || !(itemStream >> anchor) || !std::isfinite(anchor)))
+            return false;
+        newPoints.push_back({ppq, bpm, 0.0, anchor});
+    }
+    if (split != string::npos)
+    {
+        istringstream meterStream(str.substr(split + 1));
+        while (getline(meterStream, item, ';'))
+        {
+            istringstream itemStream(item);
+            double ppq;
+            int numerator;
+            int denominator;
+            char separator;
+            char slash;
+            if (!(itemStream >> ppq >> separator >> numerator >> slash >> denominator) || separator != ':' ||
+                slash != '/' || !std::isfinite(ppq) || numerator <= 0 || denominator <= 0)
+                return false;
+            newMeters.push_back({ppq, numerator, denominator, 0.0, 0});
+        }
+    }
+
+    std::stable_sort(newPoints.begin(), newPoints.end(),
+                     [](const TempoPoint &a, const TempoPoint &b) { return a.ppq < b.ppq; });
+    std::stable_sort(newMeters.begin(), newMeters.end(),
+                     [](const MeterPoint &a, const MeterPoint &b) { return a.ppq < b.ppq; });
+    points = newPoints;
+    meters = newMeters;
+    mergeAndUpdateSeconds();
+    mergeAndUpdateBars();
+    return true;
+}
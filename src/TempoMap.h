@@ -0,0 +1,98 @@
+/**
+ * @file TempoMap.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+
+/**
+ * @brief The tempo of the song as captured from the host during playback, as a function of musical
+ * time (PPQ = quarter notes since the start of the song).
+ * @details
+ * The map is a sorted list of points where the tempo changes. The tempo is constant from one point to
+ * the next, so seconds are piecewise linear in PPQ. Each point also caches the seconds at which it starts,
+ * which makes a conversion a binary search plus one multiply-add.
+ *
+ * Playback doesn't always start at the top of the song, and the tempo of the part that wasn't played isn't
+ * known. So a point recorded from the host is anchored to the seconds the host reported for it, and the
+ * seconds are only worked out from the tempo between one point and the next. A point with no anchor (e.g.,
+ * from a MIDI file, which has the whole map) is worked out from the one before it, and if it is the first
+ * one, its tempo is assumed to go all the way back to PPQ 0 (the start of the song is at 0 seconds).
+ *
+ * Note events are stored with their PPQ position. If the tempo of the song is changed in the DAW, playing
+ * it through again updates this map and the seconds of every event can then be recomputed from it;
+ * the events don't need to be captured again.
+ *
+ * The time signature is tracked the same way, as points at the bar where a meter starts. Each of those
+ * caches the number of its first bar, so the bar lines in any window of time come from a binary search
+ * followed by a walk over just the visible bars.
+ */
+class TempoMap
+{
+public:
+    // Way more bars than will ever fit on the screen; just protection against a silly window
+    static constexpr size_t maxBarsInWindow = 1000;
+
+    struct TempoPoint
+    {
+        double ppq;
+        double bpm;
+        // cached: the time in seconds at ppq
+        double seconds;
+        // the time in seconds the host reported at ppq (NaN if not known)
+        double anchor;
+    };
+
+    struct MeterPoint
+    {
+        // position of the first bar in this meter
+        double ppq;
+        int numerator;
+        int denominator;
+        // cached: length of a bar in quarter notes and the (1-based) number of the bar at ppq
+        double barLength;
+        int barNumber;
+    };
+
+    void clear() { points.clear(); meters.clear(); }
+    bool isEmpty() const { return points.empty() && meters.empty(); }
+    bool hasTempo() const { return !points.empty(); }
+    bool hasMeter() const { return !meters.empty(); }
+    const vector<TempoPoint> &getPoints() const { return points; }
+    const vector<MeterPoint> &getMeterPoints() const { return meters; }
+
+    bool recordTempo(double ppqStart, double ppqEnd, double bpm,
+                     double secondsStart = numeric_limits<double>::quiet_NaN());
+    bool recordMeter(double barStartPpq, int numerator, int denominator);
+    double getTempoAt(double ppq) const;
+    double ppqToSeconds(double ppq) const;
+    double secondsToPpq(double seconds) const;
+    void ppqToSeconds(const vector<double> &ppqs, vector<double> &seconds) const;
+    void getBarsInWindow(double startSeconds, double endSeconds, vector<pair<int, double>> &bars,
+                         size_t maxBars = maxBarsInWindow) const;
+
+    string toString() const;
+    bool fromString(const string &str);
+
+private:
+    vector<TempoPoint> points;
+    vector<MeterPoint> meters;
+
+    size_t findPoint(double ppq) const;
+    size_t findMeter(double ppq) const;
+    void mergeAndUpdateSeconds();
+    void mergeAndUpdateBars();
+};
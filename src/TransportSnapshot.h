@@ -0,0 +1,140 @@
+/**
+ * @file TransportSnapshot.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+using namespace juce;
+using namespace std;
+
+
+/**
+ * @brief Everything we know about the host transport as of the most recent audio block. The audio thread
+ * publishes one of these per block and the UI reads it every frame.
+ * This must stay trivially copyable (it is copied word by word through SeqLock).
+ */
+struct TransportSnapshot
+{
+    int64 timeInSamples = 0;
+    double timeInSeconds = 0.0;
+    double ppqPosition = 0.0;
+    // PPQ position of the start of the current bar (only if hasBarStart)
+    double barStartPpq = 0.0;
+    // Beats per minute; zero if the host didn't provide it (which is as good as not available)
+    double bpm = 0.0;
+    // Time signature; zero if the host didn't provide it
+    int timeSigNumerator = 0;
+    int timeSigDenominator = 0;
+    bool hasPpq = false;
+    bool hasBarStart = false;
+    bool isPlaying = false;
+    bool isLooping = false;
+    // Monotonic clock (see getMonotonicNanos) at the time the block was published. Zero if not stamped.
+    int64 hostTimeNs = 0;
+
+    /**
+     * @brief Time in seconds of an event that is sampleOffset samples into the block this snapshot describes
+     * (e.g., a MIDI message's sample position). Without a sample rate, the best we have is the block start.
+     */
+    double secondsAtSampleOffset(int sampleOffset, double sampleRate) const
+    {
+        if (sampleRate <= 0.0)
+            return timeInSeconds;
+        return timeInSeconds + sampleOffset / sampleRate;
+    }
+
+    /**
+     * @brief Musical position (PPQ) of an event that is sampleOffset samples into the block. The tempo
+     * reported for the block is assumed to hold for the block. Only meaningful if hasPpq is true.
+     */
+    double ppqAtSampleOffset(int sampleOffset, double sampleRate) const
+    {
+        if (sampleRate <= 0.0 || bpm <= 0.0)
+            return ppqPosition;
+        return ppqPosition + (sampleOffset / sampleRate) * bpm / 60.0;
+    }
+};
+
+
+/**
+ * @brief Monotonic high resolution clock in nanoseconds. The audio thread stamps transport snapshots
+ * with this and the UI compares against it, so both sides must use this same function.
+ *
+ * @return int64
+ */
+inline int64 getMonotonicNanos()
+{
+    return static_cast<int64>(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks()) * 1.0e9);
+}
+
+
+/**
+ * @brief Sequence lock for passing a small trivially copyable value from one writer thread to any
+ * number of readers.
+ * @details
+ * Neither side ever takes a lock or waits on the other. The writer bumps the sequence number to an
+ * odd value, copies the data in, and bumps it again. A reader copies the data out and only retries
+ * if the sequence number shows that it overlapped a write (rare: the audio thread writes a few dozen
+ * bytes once per block). The payload is stored in relaxed atomic words so that a torn read is never
+ * undefined behavior; it just gets detected and discarded.
+ *
+ * Only one thread may call store() at a time.
+ */
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+
+public:
+    SeqLock() { store(T()); }
+
+    void store(const T &value)
+    {
+        uint64 buffer[numWords] = {};
+        memcpy(buffer, &value, sizeof(T));
+
+        uint32 seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < numWords; i++)
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        uint64 buffer[numWords];
+        for (;;)
+        {
+            uint32 before = sequence.load(std::memory_order_acquire);
+            if ((before & 1) == 0)
+            {
+                for (size_t i = 0; i < numWords; i++)
+                    buffer[i] = words[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == before)
+                    break;
+            }
+        }
+
+        T value;
+        memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr size_t numWords = (sizeof(T) + sizeof(uint64) - 1) / sizeof(uint64);
+    std::atomic<uint32> sequence { 0 };
+    std::atomic<uint64> words[numWords];
+};
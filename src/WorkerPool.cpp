@@ -0,0 +1,372 @@
+/**
+ * @file WorkerPool.cpp
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+using namespace juce;
+using namespace std;
+
+// The pool (and queue) that the current thread is working for, if any. This lets jobs that add more
+// jobs put them on their own queue (they are the most likely to be hot in the cache)
+static thread_local WorkerPool *currentPool = nullptr;
+static thread_local int currentQueue = -1;
+
+// The process-wide pool shared by all the plugin instances. Only weakly held here; the clients own it
+static CriticalSection sharedPoolLock;
+static weak_ptr<WorkerPool> sharedPool;
+
+
+CancellationToken::CancellationToken() : state(make_shared<State>())
+{
+}
+
+void CancellationToken::cancel()
+{
+    state->cancelled = true;
+}
+
+bool CancellationToken::isCancelled() const
+{
+    return state->cancelled;
+}
+
+
+WorkerPool::WorkerPool(int numThreads)
+{
+    numThreads = std::max(1, numThreads);
+    for (int i = 0; i < numThreads; i++)
+        queues.push_back(make_unique<WorkQueue>());
+}
+
+WorkerPool::~WorkerPool()
+{
+    for (auto &worker : workers)
+        worker->signalThreadShouldExit();
+    for (auto &worker : workers)
+    {
+        worker->notify();
+        worker->stopThread(2000);
+    }
+
+    // Anything still queued at this point never gets to run. Release whoever might be waiting on it.
+    for (auto &queue : queues)
+    {
+        for (auto &entry : queue->jobs)
+        {
+            if (--entry.token->outstanding == 0)
+                entry.token->finished.signal();
+        }
+        queue->jobs.clear();
+    }
+}
+
+/**
+ * @brief Number of threads for the shared pool. Leave a couple of cores for the DAW (the audio threads
+ * matter far more than us) and don't go overboard on machines with lots of cores; the work is bursty.
+ *
+ * @return int
+ */
+int WorkerPool::getDefaultNumThreads()
+{
+    return jlimit(1, 8, SystemStats::getNumCpus() - 2);
+}
+
+/**
+ * @brief Start the worker threads. Done on the first job rather than in the constructor.
+ */
+void WorkerPool::startWorkers()
+{
+    const ScopedLock lock(startLock);
+    if (started)
+        return;
+
+    for (int i = 0; i < static_cast<int>(queues.size()); i++)
+    {
+        workers.push_back(make_unique<Worker>(*this, i));
+        workers.back()->startThread(Thread::Priority::background);
+    }
+    started = true;
+}
+
+/**
+ * @brief Queue a job
+ *
+ * @param job
+ * @param token  Cancelling this token drops the job if it has not started yet
+ */
+void WorkerPool::addJob(Job job, const CancellationToken &token)
+{
+    if (token.isCancelled())
+        return;
+    if (!started)
+        startWorkers();
+
+    token.state->outstanding++;
+    pendingJobs++;
+
+    int queueIndex;
+    if (currentPool == this)
+        queueIndex = currentQueue;
+    else
+        queueIndex = nextQueue++ % static_cast<int>(queues.size());
+
+    {
+        WorkQueue &queue = *queues[static_cast<size_t>(queueIndex)];
+        const ScopedLock lock(queue.lock);
+        queue.jobs.push_back({std::move(job), token.state});
+    }
+    wakeWorker(queueIndex);
+}
+
+/**
+ * @brief Run body(0) ... body(count - 1), spread over the pool, and wait for all of them to finish.
+ * @details
+ * The calling thread does its share of the work too: it and the helpers all take the next index from a
+ * shared counter until they run out. So this is safe to call from inside a job (e.g., a background view
+ * rebuild) even when every worker is busy; the caller just ends up doing all of it. Helpers that only get
+ * going after everything is done find nothing left to do and quit.
+ *
+ * @param count        number of pieces of work
+ * @param body         called once with each index, from any of the threads
+ * @param maxThreads   most threads to use, counting the caller (0 for as many as the pool has plus the caller)
+ */
+void WorkerPool::parallelFor(int count, function<void(int)> body, int maxThreads)
+{
+    struct Shared
+    {
+        function<void(int)> body;
+        int count;
+        atomic<int> next { 0 };
+        atomic<int> done { 0 };
+        WaitableEvent finished;
+    };
+    auto shared = make_shared<Shared>();
+    shared->body = std::move(body);
+    shared->count = count;
+
+    auto work = [shared]
+    {
+        for (int i = shared->next++; i < shared->count; i = shared->next++)
+        {
+            shared->body(i);
+            if (++shared->done == shared->count)
+                shared->finished.signal();
+        }
+    };
+
+    int helpers = getNumThreads();
+    if (maxThreads > 0)
+        helpers = std::min(helpers, maxThreads - 1);
+    helpers = std::min(helpers, count - 1);
+    CancellationToken token;
+    for (int i = 0; i < helpers; i++)
+        addJob(work, token);
+
+    work();
+    while (shared->done < count)
+        shared->finished.wait(1);
+}
+
+/**
+ * @brief Wake up a worker to handle newly added work. An idle one is best (it will steal the job if it
+ * is not on its own queue); otherwise poke the owner of the queue so it looks again before sleeping.
+ *
+ * @param preferred  index of the queue the job went on
+ */
+void WorkerPool::wakeWorker(int preferred)
+{
+    for (auto &worker : workers)
+    {
+        if (worker->idle)
+        {
+            worker->notify();
+            return;
+        }
+    }
+    if (preferred < static_cast<int>(workers.size()))
+        workers[static_cast<size_t>(preferred)]->notify();
+}
+
+/**
+ * @brief Find the next job for a worker: newest from its own queue, else the oldest from another queue
+ *
+ * @param queueIndex   the worker's own queue
+ * @param entry        receives the job
+ * @return bool        false if there is nothing to do anywhere
+ */
+bool WorkerPool::takeJob(int queueIndex, Entry &entry)
+{
+    int count = static_cast<int>(queues.size());
+    {
+        WorkQueue &own = *queues[static_cast<size_t>(queueIndex)];
+        const ScopedLock lock(own.lock);
+        if (!own.jobs.empty())
+        {
+            entry = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+
+    for (int i = 1; i < count; i++)
+    {
+        WorkQueue &victim = *queues[static_cast<size_t>((queueIndex + i) % count)];
+        const ScopedLock lock(victim.lock);
+        if (!victim.jobs.empty())
+        {
+            entry = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Run a job (unless its owner cancelled it in the meantime) and do the bookkeeping
+ *
+ * @param entry
+ */
+void WorkerPool::runJob(Entry &entry)
+{
+    if (!entry.token->cancelled)
+        entry.job();
+
+    // Let go of anything the job captured before announcing that it is done
+    entry.job = nullptr;
+    if (--entry.token->outstanding == 0)
+        entry.token->finished.signal();
+    pendingJobs--;
+}
+
+/**
+ * @brief Cancel all the jobs for the given token. Queued ones are dropped; this waits for the ones
+ * that are already running. Don't call this from one of the token's own jobs.
+ *
+ * @param token
+ */
+void WorkerPool::cancelJobs(const CancellationToken &token)
+{
+    auto state = token.state;
+    state->cancelled = true;
+
+    for (auto &queue : queues)
+    {
+        const ScopedLock lock(queue->lock);
+        for (auto it = queue->jobs.begin(); it != queue->jobs.end();)
+        {
+            if (it->token == state)
+            {
+                it = queue->jobs.erase(it);
+                pendingJobs--;
+                if (--state->outstanding == 0)
+                    state->finished.signal();
+            }
+            else
+                ++it;
+        }
+    }
+
+    while (state->outstanding > 0)
+        state->finished.wait(10);
+}
+
+/**
+ * @brief Wait until there is no queued or running work. Mostly for tests and benchmarks.
+ *
+ * @param timeoutMs
+ * @return bool     true if the pool went idle, false on timeout
+ */
+bool WorkerPool::waitUntilIdle(int timeoutMs)
+{
+    int64 endTime = Time::currentTimeMillis() + timeoutMs;
+    while (pendingJobs > 0)
+    {
+        if (Time::currentTimeMillis() > endTime)
+            return false;
+        Thread::sleep(1);
+    }
+    return true;
+}
+
+/**
+ * @brief Get the shared pool, creating it if no one else is using it right now
+ *
+ * @return shared_ptr<WorkerPool>
+ */
+shared_ptr<WorkerPool> WorkerPool::acquireShared()
+{
+    const ScopedLock lock(sharedPoolLock);
+    shared_ptr<WorkerPool> pool = sharedPool.lock();
+    if (pool == nullptr)
+    {
+        pool = make_shared<WorkerPool>(getDefaultNumThreads());
+        sharedPool = pool;
+    }
+    return pool;
+}
+
+bool WorkerPool::hasSharedPool()
+{
+    const ScopedLock lock(sharedPoolLock);
+    return !sharedPool.expired();
+}
+
+
+WorkerPool::Worker::Worker(WorkerPool &owner, int index)
+    : Thread("MidiChords worker " + String(index)), pool(owner), queueIndex(index)
+{
+}
+
+void WorkerPool::Worker::run()
+{
+    currentPool = &pool;
+    currentQueue = queueIndex;
+
+    while (!threadShouldExit())
+    {
+        Entry entry;
+        if (pool.takeJob(queueIndex, entry))
+        {
+            pool.runJob(entry);
+            continue;
+        }
+
+        // Nothing to do. The timeout is just a safety net; addJob() wakes us up
+        idle = true;
+        wait(50);
+        idle = false;
+    }
+}
+
+
+WorkerPool::Client::Client() : pool(acquireShared())
+{
+}
+
+WorkerPool::Client::~Client()
+{
+    // Drop our queued work and wait for running jobs before letting go of the pool. If this is
+    // the last client, releasing the pool shuts down its threads.
+    pool->cancelJobs(token);
+    const ScopedLock lock(sharedPoolLock);
+    pool = nullptr;
+}
+
+void WorkerPool::Client::addJob(Job job)
+{
+    pool->addJob(std::move(job), token);
+}
+
+void WorkerPool::Client::cancelJobs()
+{
+    pool->cancelJobs(token);
+}
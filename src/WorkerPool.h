@@ -0,0 +1,147 @@
+/**
+ * @file WorkerPool.h
+ * @author Mark Wilkins
+ * @brief Part of MidiChords project (plugin to display chord names from a MIDI track on playback)
+ * @version 0.9.0
+ *
+ * @copyright Copyright (c) 2023-2026
+ *
+ */
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <functional>
+#include <deque>
+#include <memory>
+
+using namespace juce;
+using namespace std;
+
+
+/**
+ * @brief Cancellation flag for a group of jobs. Each owner of background work (e.g., each plugin instance)
+ * has one of these. Cancelling it drops the owner's queued jobs and lets long running jobs bail out early
+ * by polling isCancelled().
+ */
+class CancellationToken
+{
+public:
+    CancellationToken();
+
+    void cancel();
+    bool isCancelled() const;
+
+private:
+    friend class WorkerPool;
+
+    struct State
+    {
+        atomic<bool> cancelled { false };
+        // Number of jobs for this token that are queued or running
+        atomic<int> outstanding { 0 };
+        WaitableEvent finished;
+    };
+    shared_ptr<State> state;
+};
+
+
+/**
+ * @brief A small work-stealing thread pool.
+ * @details
+ * Each worker has its own job queue. Jobs added from outside the pool are spread round robin over the
+ * queues; jobs added from inside a running job go on the current worker's own queue. A worker takes jobs
+ * from the back of its own queue and, when that is empty, steals from the front of the other queues.
+ *
+ * The threads run at background priority and are not started until the first job arrives, so hosts that
+ * just scan/instantiate the plugin never pay for them.
+ *
+ * The plugin instances share a single process-wide pool through WorkerPool::Client handles. A DAW template
+ * with 40 instances then still has only a handful of background threads instead of 40+ of them competing
+ * with the audio threads. The shared pool is shut down when the last client goes away.
+ */
+class WorkerPool
+{
+public:
+    typedef function<void()> Job;
+
+    explicit WorkerPool(int numThreads);
+    ~WorkerPool();
+
+    void addJob(Job job, const CancellationToken &token);
+    void parallelFor(int count, function<void(int)> body, int maxThreads = 0);
+    void cancelJobs(const CancellationToken &token);
+    bool waitUntilIdle(int timeoutMs);
+    int getNumThreads() const { return static_cast<int>(queues.size()); }
+    bool isStarted() const { return started; }
+
+    static int getDefaultNumThreads();
+
+    /**
+     * @brief Handle to the shared, process-wide pool. Each MidiChordsAudioProcessor owns one.
+     * Destroying it cancels the owner's queued jobs and waits for any of its jobs that are currently running,
+     * so it must be destroyed before anything those jobs reference.
+     */
+    class Client
+    {
+    public:
+        Client();
+        ~Client();
+
+        void addJob(Job job);
+        void cancelJobs();
+        bool isCancelled() const { return token.isCancelled(); }
+        WorkerPool& getPool() { return *pool; }
+
+    private:
+        shared_ptr<WorkerPool> pool;
+        CancellationToken token;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Client)
+    };
+
+    // For testing: is the shared pool currently alive (e.g., is there at least one client)?
+    static bool hasSharedPool();
+
+private:
+    struct Entry
+    {
+        Job job;
+        shared_ptr<CancellationToken::State> token;
+    };
+
+    struct WorkQueue
+    {
+        CriticalSection lock;
+        deque<Entry> jobs;
+    };
+
+    class Worker : public Thread
+    {
+    public:
+        Worker(WorkerPool &owner, int index);
+        void run() override;
+        atomic<bool> idle { false };
+
+    private:
+        WorkerPool &pool;
+        int queueIndex;
+    };
+
+    vector<unique_ptr<WorkQueue>> queues;
+    vector<unique_ptr<Worker>> workers;
+    CriticalSection startLock;
+    atomic<bool> started { false };
+    atomic<int> nextQueue { 0 };
+    // Queued plus running jobs across all tokens (used by waitUntilIdle)
+    atomic<int> pendingJobs { 0 };
+
+    void startWorkers();
+    bool takeJob(int queueIndex, Entry &entry);
+    void runJob(Entry &entry);
+    void wakeWorker(int preferred);
+
+    static shared_ptr<WorkerPool> acquireShared();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WorkerPool)
+};
@@ -0,0 +1,231 @@
+#include <catch2/catch_test_macros.hpp>
+#include "ChordClipper.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+using namespace std;
+
+
+// Count the heap allocations made on this thread while countAllocations is on. Replacing the global
+// operator new affects the whole test program, but the counting is only done inside the per-frame loop below.
+// Every form of new is replaced (plain, array, nothrow and aligned) along with the delete that goes with it,
+// so nothing allocated by one pair is released by another.
+static thread_local bool countAllocations = false;
+static atomic<int> allocationCount {0};
+
+// GCC inlines these into delete expressions and then warns that free() is given a pointer from operator
+// new. That's the whole point here (new is malloc underneath), so the warning is turned off for them.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static void *countedAlloc(size_t size)
+{
+    if (countAllocations)
+        allocationCount++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+static void *countedAlignedAlloc(size_t size, align_val_t alignment)
+{
+    if (countAllocations)
+        allocationCount++;
+    size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+    return _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+    // (aligned_alloc wants the size to be a multiple of the alignment)
+    return aligned_alloc(align, (size == 0 ? align : (size + align - 1) / align * align));
+#endif
+}
+
+static void alignedFree(void *p)
+{
+#ifdef _MSC_VER
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+void *operator new(size_t size)
+{
+    if (void *p = countedAlloc(size))
+        return p;
+    throw bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new(size_t size, align_val_t alignment)
+{
+    if (void *p = countedAlignedAlloc(size, alignment))
+        return p;
+    throw bad_alloc();
+}
+
+void *operator new[](size_t size, align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, const nothrow_t &) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, const nothrow_t &) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, align_val_t) noexcept
+{
+    alignedFree(p);
+}
+
+void operator delete[](void *p, align_val_t) noexcept
+{
+    alignedFree(p);
+}
+
+void operator delete(void *p, size_t, align_val_t) noexcept
+{
+    alignedFree(p);
+}
+
+void operator delete[](void *p, size_t, align_val_t) noexcept
+{
+    alignedFree(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+
+static void addNote(MidiStore &ms, double time, double duration, int note)
+{
+    int64 onTime = static_cast<int64>(time * 1000);
+    int64 offTime = static_cast<int64>((time + duration) * 1000);
+    ms.addNoteEventAtTime(onTime, note, true);
+    ms.setEventTimeSeconds(onTime, static_cast<float>(time));
+    ms.addNoteEventAtTime(offTime, note, false);
+    ms.setEventTimeSeconds(offTime, static_cast<float>(time + duration));
+}
+
+TEST_CASE("per frame display does not allocate", "allocation")
+{
+    MidiStore ms;
+    ChordClipper cp(ms);
+    ms.setQuantizationValue(1);
+    ms.setTimeWidth(10.0);
+    ms.setPlayHeadPosition(25.0);
+    ms.setBPMeasure(4);
+    ms.setBPMinute(120.0);
+    const int notes[] = {12, 17, 19, 16};
+    for (int i = 0; i < 300; i++)
+        addNote(ms, i, 0.5, notes[i % 4]);
+    ms.updateStaticView();
+
+    // One pass through the whole song first. The first frames are allowed to allocate (the snapshot is
+    // fetched and the measure buffers grow to fit the window).
+    auto frame = [&](float position)
+    {
+        ms.setLastEventTimeInSeconds(position);
+        cp.updateCurrentPosition(0);
+        float windowStart = 0.0f;
+        size_t chords = 0;
+        for (const auto &chord : cp.getChordWindowToDisplay(windowStart))
+            chords += chord.first - windowStart < 100.0f ? 1 : 0;
+        return chords + cp.getMeasuresToDisplay().size();
+    };
+    size_t seen = 0;
+    for (int i = 0; i < 300; i++)
+        seen += frame(static_cast<float>(i));
+
+    // Now playback, scrubbing and jumping around the song, all with no allocations
+    allocationCount = 0;
+    countAllocations = true;
+    for (int i = 0; i < 5000; i++)
+        seen += frame(static_cast<float>(i) * 0.02f);
+    for (int i = 0; i < 200; i++)
+        seen += frame(150.0f + (i % 2 == 0 ? -20.0f : 20.0f));
+    for (int i = 0; i < 2000; i++)
+        seen += frame(280.0f - static_cast<float>(i) * 0.1f);
+    countAllocations = false;
+
+    REQUIRE(seen > 0);
+    REQUIRE(allocationCount == 0);
+
+    // Without a captured tempo map, the transport's tempo is what there is, and the grid follows it (still with
+    // no allocation). The tempo only goes down from the one above, so there are never more bars in the window.
+    int generation = cp.getMeasureGridGeneration();
+    countAllocations = true;
+    for (int i = 0; i < 200; i++)
+    {
+        ms.setBPMinute(120.0 - (i % 20));
+        seen += frame(static_cast<float>(i) * 0.1f);
+    }
+    countAllocations = false;
+    REQUIRE(allocationCount == 0);
+    REQUIRE(cp.getMeasureGridGeneration() > generation);
+
+    // With one, the host's tempo changing (automation, or just jitter) is ignored; the bar lines come from
+    // the map, which isn't copied again
+    ms.recordTempo(0.0, 600.0, 120.0);
+    ms.recordMeter(0.0, 4, 4);
+    seen += frame(0.0f);
+    generation = cp.getMeasureGridGeneration();
+    countAllocations = true;
+    for (int i = 0; i < 2000; i++)
+    {
+        ms.setBPMinute(120.0 + (i % 7) * 0.01);
+        seen += frame(static_cast<float>(i) * 0.1f);
+    }
+    countAllocations = false;
+    REQUIRE(allocationCount == 0);
+    REQUIRE(cp.getMeasureGridGeneration() == generation);
+
+    // Sanity check that the counting works at all: the copying version of the window allocates
+    countAllocations = true;
+    ChordVectorType copied = cp.getChordsToDisplay();
+    countAllocations = false;
+    REQUIRE(!copied.empty());
+    REQUIRE(allocationCount > 0);
+}
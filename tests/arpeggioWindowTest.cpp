@@ -0,0 +1,113 @@
+#include <catch2/catch_test_macros.hpp>
+#include "ArpeggioWindow.h"
+#include "MidiStore.h"
+using namespace std;
+
+
+TEST_CASE("arpeggio window", "arpeggio")
+{
+    ArpeggioWindow window(1.0);
+    // C, E, G one after the other with no overlap
+    REQUIRE(window.addEvent(0.0, NoteSet{60}) == NoteSet{60});
+    REQUIRE(window.addEvent(0.2, NoteSet()) == NoteSet{60});
+    REQUIRE(window.addEvent(0.3, NoteSet{64}) == (NoteSet{60, 64}));
+    REQUIRE(window.addEvent(0.6, NoteSet{67}) == (NoteSet{60, 64, 67}));
+    // the C started a second ago, so it's gone; a held note stays no matter how long ago it started
+    REQUIRE(window.addEvent(1.0, NoteSet{67}) == (NoteSet{64, 67}));
+    REQUIRE(window.addEvent(5.0, NoteSet{67}) == (NoteSet{67}));
+    // playing the same note again keeps it in the window until its last start expires
+    window.addEvent(5.1, NoteSet{72});
+    window.addEvent(5.2, NoteSet());
+    window.addEvent(5.5, NoteSet{72});
+    REQUIRE(window.addEvent(6.2, NoteSet()) == (NoteSet{72}));
+    REQUIRE(window.addEvent(6.5, NoteSet()).isEmpty());
+
+    // going back in time starts over
+    REQUIRE(window.addEvent(0.0, NoteSet{48}) == NoteSet{48});
+}
+
+
+// A broken chord pattern (indexes into the chord's notes) for each chord, one bar of 16ths each.
+// Every note is let go before the next one starts.
+static void addArpeggios(MidiStore &ms, const vector<vector<int>> &chords, const vector<size_t> &pattern,
+                         double secondsPer16th)
+{
+    int64 time = 1000;
+    const int64 samplesPer16th = 1000;
+    for (const vector<int> &chord : chords)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int note = chord[pattern[static_cast<size_t>(i) % pattern.size()]];
+            ms.addNoteEventAtTime(time, note, true);
+            ms.setEventTimeSeconds(time, static_cast<double>(time) / samplesPer16th * secondsPer16th);
+            ms.addNoteEventAtTime(time + samplesPer16th * 9 / 10, note, false);
+            ms.setEventTimeSeconds(time + samplesPer16th * 9 / 10,
+                                   static_cast<double>(time + samplesPer16th * 9 / 10) / samplesPer16th * secondsPer16th);
+            time += samplesPer16th;
+        }
+    }
+}
+
+static vector<string> chordNames(MidiStore &ms)
+{
+    ms.updateStaticView();
+    vector<string> names;
+    for (auto &chord : ms.getChordsInWindow({0.0f, 1000.0f}))
+        names.push_back(chord.second);
+    return names;
+}
+
+TEST_CASE("arpeggiated chords", "arpeggio")
+{
+    // C Am F G7 in root position (C3 and up)
+    vector<vector<int>> chords = {{48, 52, 55, 60}, {45, 48, 52, 57}, {41, 45, 48, 53}, {43, 47, 50, 53}};
+    vector<string> expected = {"C", "Am", "F", "G7"};
+    vector<vector<size_t>> patterns = {
+        {0, 1, 2, 3},           // up
+        {0, 3, 2, 1},           // bass then down
+        {0, 1, 2, 3, 2, 1},     // up and down
+        {0, 2, 1, 2, 3, 2, 1, 2}, // alberti-ish
+    };
+
+    for (const vector<size_t> &pattern : patterns)
+    {
+        MidiStore ms;
+        ms.setQuantizationValue(1);
+        ms.setShortChordThreshold(0.2f);
+        // 16ths at 120 bpm
+        addArpeggios(ms, chords, pattern, 0.125);
+
+        // Without the window, nothing overlaps so every note is its own chord
+        vector<string> names = chordNames(ms);
+        REQUIRE(names != expected);
+
+        // Half a bar is enough to get a whole cycle of any of the patterns
+        ms.setArpeggioWindow(1.0f);
+        REQUIRE(chordNames(ms) == expected);
+
+        // The same thing measured in beats (a beat is half a second at 120)
+        ms.recordTempo(0.0, 100.0, 120.0);
+        ms.setArpeggioWindowInBeats(true);
+        ms.setArpeggioWindow(2.0f);
+        REQUIRE(chordNames(ms) == expected);
+    }
+}
+
+TEST_CASE("arpeggio window on a long song", "arpeggio")
+{
+    // Hundreds of bars of 16ths; this is mostly to show that it doesn't lose track as the song goes on
+    vector<vector<int>> progression = {{48, 52, 55, 60}, {45, 48, 52, 57}, {41, 45, 48, 53}, {43, 47, 50, 53}};
+    vector<vector<int>> chords;
+    for (int i = 0; i < 100; i++)
+        chords.insert(chords.end(), progression.begin(), progression.end());
+
+    MidiStore ms;
+    ms.setQuantizationValue(1);
+    ms.setShortChordThreshold(0.2f);
+    ms.setArpeggioWindow(1.0f);
+    addArpeggios(ms, chords, {0, 1, 2, 3}, 0.125);
+    vector<string> names = chordNames(ms);
+    REQUIRE(names.size() == chords.size());
+    REQUIRE(names[301] == "Am");
+}
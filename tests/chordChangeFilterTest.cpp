@@ -0,0 +1,106 @@
+#include <catch2/catch_test_macros.hpp>
+#include "ChordChangeFilter.h"
+#include <random>
+using namespace std;
+
+
+// The original after-the-fact version of the filter (from MidiStore::removeShortChords)
+static void removeShortChordsReference(ChordVectorType &view, float minLength)
+{
+    for (auto it = view.begin(); it != view.end(); )
+    {
+        if (it == view.begin() || (it + 1) == view.end() || (it + 1)->first - it->first >= minLength)
+            ++it;
+        else
+        {
+            it = view.erase(it);
+            if (it->second == (it - 1)->second)
+                it = view.erase(it);
+        }
+    }
+}
+
+static ChordVectorType filterChords(const ChordVectorType &view, float minLength)
+{
+    ChordVectorType kept;
+    ChordChangeFilter filter(minLength, kept);
+    for (const auto &chord : view)
+        filter.add(chord.first, chord.second);
+    filter.finish();
+    return kept;
+}
+
+TEST_CASE("chord change filter", "chordfilter")
+{
+    ChordVectorType view = {{0.0f, "C"}, {1.0f, "F"}, {1.1f, "G"}, {1.2f, "F"}, {3.0f, "Am"}, {3.1f, "Dm"}};
+    // F and G are too short, which leaves the second F; Am is too short but the last one is always kept
+    ChordVectorType expected = {{0.0f, "C"}, {1.2f, "F"}, {3.1f, "Dm"}};
+    REQUIRE(filterChords(view, 0.5f) == expected);
+    REQUIRE(filterChords(view, 0.0f) == view);
+    REQUIRE(filterChords({}, 0.5f).empty());
+
+    // A short chord between two of the same one joins them back together
+    view = {{0.0f, "C"}, {1.0f, "F"}, {1.7f, "G"}, {1.8f, "F"}, {3.0f, "C"}};
+    expected = {{0.0f, "C"}, {1.0f, "F"}, {3.0f, "C"}};
+    REQUIRE(filterChords(view, 0.5f) == expected);
+
+    // The pending chord is kept as soon as the time goes past the threshold, without waiting for the next one
+    ChordVectorType kept;
+    ChordChangeFilter filter(0.5f, kept);
+    filter.add(0.0f, "C");
+    filter.add(1.0f, "F");
+    REQUIRE(kept.size() == 1);
+    REQUIRE(filter.getPending()->second == "F");
+    filter.advanceTo(1.2f);
+    REQUIRE(kept.size() == 1);
+    filter.advanceTo(1.5f);
+    REQUIRE(kept.size() == 2);
+    REQUIRE(filter.getPending() == nullptr);
+    // (time doesn't go backwards)
+    filter.advanceTo(1.0f);
+    REQUIRE(filter.getTime() == 1.5f);
+    filter.add(1.7f, "G");
+    filter.add(1.8f, "C");
+    filter.finish();
+    expected = {{0.0f, "C"}, {1.0f, "F"}, {1.8f, "C"}};
+    REQUIRE(kept == expected);
+
+    filter.restart(0.0f);
+    REQUIRE(kept.empty());
+    REQUIRE(filter.getPending() == nullptr);
+    filter.add(0.0f, "C");
+    filter.add(0.1f, "F");
+    filter.finish();
+    expected = {{0.0f, "C"}, {0.1f, "F"}};
+    REQUIRE(kept == expected);
+}
+
+TEST_CASE("chord change filter matches the original", "chordfilter")
+{
+    mt19937 gen(42);
+    uniform_int_distribution<> nameDist(0, 3);
+    uniform_real_distribution<float> gapDist(0.0f, 1.0f);
+    const string names[] = {"C", "F", "G", "Am"};
+
+    bool allMatch = true;
+    for (int trial = 0; trial < 2000 && allMatch; trial++)
+    {
+        ChordVectorType view;
+        float time = 0.0f;
+        int count = trial % 40;
+        for (int i = 0; i < count; i++)
+        {
+            string name = names[nameDist(gen)];
+            // the view never has the same chord twice in a row
+            if (!view.empty() && view.back().second == name)
+                continue;
+            view.push_back({time, name});
+            time += gapDist(gen);
+        }
+        float threshold = gapDist(gen);
+        ChordVectorType expected = view;
+        removeShortChordsReference(expected, threshold);
+        allMatch = filterChords(view, threshold) == expected;
+    }
+    REQUIRE(allMatch);
+}
@@ -215,6 +215,31 @@ TEST_CASE("measure bars", "chordview")
 }
 
 
+// The captured tempo map wins over the current transport values
+TEST_CASE("measure bars with tempo change", "chordview")
+{
+    MidiStore ms;
+    ChordClipper cp(ms);
+    MeasurePositionType bars;
+    MeasurePositionType expected;
+
+    ms.setTimeWidth(20.0);
+    ms.setPlayHeadPosition(50.0);
+    // 4 bars of 4/4 at 120 (8 seconds), then 3/4 at 60 (3 seconds per bar)
+    ms.recordTempo(0.0, 16.0, 120.0);
+    ms.recordMeter(0.0, 4, 4);
+    ms.recordTempo(16.0, 64.0, 60.0);
+    ms.recordMeter(16.0, 3, 4);
+    ms.setBPMinute(60.0);
+    ms.setBPMeasure(3);
+
+    ms.setLastEventTimeInSeconds(10.0);
+    cp.updateCurrentPosition(0);
+    bars = cp.getMeasuresToDisplay();
+    expected = {{2, 2.0}, {3, 4.0}, {4, 6.0}, {5, 8.0}, {6, 11.0}, {7, 14.0}, {8, 17.0}};
+    REQUIRE(bars == expected);
+}
+
 TEST_CASE("mouse nudge", "chordview")
 {
     MidiStore ms;
@@ -251,4 +276,88 @@ TEST_CASE("mouse nudge", "chordview")
     chords = cp.getChordsToDisplay();
     expected = {{1, "C"}};
     REQUIRE(chords == expected);
-}
\ No newline at end of file
+}
+
+// What getChordsToDisplay should give, straight from the store
+static ChordVectorType chordsInView(MidiStore &ms, ChordClipper &cp, float position)
+{
+    float start = position - cp.getCurrentNotePosition();
+    ChordVectorType chords = ms.getChordsInWindow({start - 2.0f, start + cp.getViewWidthInSeconds() + 2.0f});
+    for (auto &chord : chords)
+        chord.first -= start;
+    return chords;
+}
+
+TEST_CASE("chord view cache", "chordview")
+{
+    MidiStore ms;
+    ChordClipper cp(ms);
+    ms.setQuantizationValue(1);
+    ms.setTimeWidth(10.0);
+    ms.setPlayHeadPosition(25.0);
+    // a chord every second for a couple of minutes
+    const int notes[] = {12, 17, 19, 16};
+    for (int i = 0; i < 120; i++)
+        addNote(ms, i, 0.5, notes[i % 4]);
+
+    // Playing forward a frame (20ms) at a time doesn't need anything new from the store
+    bool allMatch = true;
+    ms.setLastEventTimeInSeconds(10.0);
+    cp.updateCurrentPosition(0);
+    cp.getChordsToDisplay();
+    int fetches = cp.getFetchCount();
+    for (int frame = 0; frame < 1000; frame++)
+    {
+        float position = 10.0f + static_cast<float>(frame) * 0.02f;
+        ms.setLastEventTimeInSeconds(position);
+        cp.updateCurrentPosition(0);
+        allMatch = allMatch && cp.getChordsToDisplay() == chordsInView(ms, cp, position);
+    }
+    REQUIRE(allMatch);
+    REQUIRE(cp.getFetchCount() == fetches);
+
+    // Nor does scrubbing back and forth
+    fetches = cp.getFetchCount();
+    for (int i = 0; i < 20; i++)
+    {
+        float position = 28.0f + (i % 2 == 0 ? -1.5f : 1.5f);
+        ms.setLastEventTimeInSeconds(position);
+        cp.updateCurrentPosition(0);
+        allMatch = allMatch && cp.getChordsToDisplay() == chordsInView(ms, cp, position);
+    }
+    REQUIRE(allMatch);
+    REQUIRE(cp.getFetchCount() == fetches);
+
+    // Going backwards works like going forwards
+    fetches = cp.getFetchCount();
+    for (int frame = 0; frame < 500; frame++)
+    {
+        float position = 28.0f - static_cast<float>(frame) * 0.04f;
+        ms.setLastEventTimeInSeconds(position);
+        cp.updateCurrentPosition(0);
+        allMatch = allMatch && cp.getChordsToDisplay() == chordsInView(ms, cp, position);
+    }
+    REQUIRE(allMatch);
+    REQUIRE(cp.getFetchCount() == fetches);
+
+    // Jumping around (looping, clicking in the timeline) and nudging with the mouse
+    for (float position : {100.0f, 20.0f, 119.0f, 60.0f, 58.5f, 61.0f, -5.0f, 3.0f})
+    {
+        ms.setLastEventTimeInSeconds(position);
+        cp.updateCurrentPosition(0);
+        allMatch = allMatch && cp.getChordsToDisplay() == chordsInView(ms, cp, position);
+        cp.scrollWheelNudge(0.3f);
+        allMatch = allMatch && cp.getChordsToDisplay() == chordsInView(ms, cp, position + 3.0f);
+    }
+    REQUIRE(allMatch);
+
+    // A new chord in the part that is already showing is there as soon as the store's view has it
+    ms.setLastEventTimeInSeconds(50.0);
+    cp.updateCurrentPosition(0);
+    cp.getChordsToDisplay();
+    fetches = cp.getFetchCount();
+    addNote(ms, 50.5, 0.2, 21);
+    REQUIRE(cp.getChordsToDisplay() == chordsInView(ms, cp, 50.0f));
+    REQUIRE(cp.getFetchCount() == fetches + 1);
+    REQUIRE(cp.getChordsToDisplay().size() == 15);
+}
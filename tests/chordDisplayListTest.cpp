@@ -0,0 +1,203 @@
+#include <catch2/catch_test_macros.hpp>
+#include "ChordDisplayList.h"
+#include "ChordName.h"
+using namespace std;
+
+
+// Every character is 10 pixels wide (20 in the symbol font)
+static float fakeMeasure(const string &text, bool isSymbol)
+{
+    return isSymbol ? 20.0f : 10.0f * static_cast<float>(text.size());
+}
+
+static DisplaySettings makeSettings(bool symbolFont)
+{
+    DisplaySettings settings;
+    // 10 pixels a second
+    settings.width = 200;
+    settings.viewSeconds = 20.0f;
+    settings.fontSize = 40;
+    settings.symbolFont = symbolFont;
+    settings.measuresEnd = 12.0;
+    return settings;
+}
+
+static vector<DisplayCommand> commandsOfKind(const vector<DisplayCommand> &commands, DisplayCommand::Kind kind)
+{
+    vector<DisplayCommand> found;
+    for (const auto &command : commands)
+        if (command.kind == kind)
+            found.push_back(command);
+    return found;
+}
+
+TEST_CASE("display list measures", "display")
+{
+    // 60 bpm in 4/4 for two bars, then 3/4
+    TempoMap measures;
+    measures.recordTempo(0.0, 0.0, 60.0);
+    measures.recordMeter(0.0, 4, 4);
+    measures.recordMeter(8.0, 3, 4);
+    auto list = ChordDisplayList::build(make_shared<const ChordTimeline>(), measures, makeSettings(false), fakeMeasure);
+    const vector<DisplayCommand> &commands = list->getMeasureCommands();
+
+    // Bars go back a window's width before the start (for the start of the song) and up to the end
+    vector<DisplayCommand> bars = commandsOfKind(commands, DisplayCommand::barLine);
+    vector<float> barX;
+    for (const auto &bar : bars)
+        barX.push_back(bar.x);
+    REQUIRE(barX == vector<float>{-160.0f, -120.0f, -80.0f, -40.0f, 0.0f, 40.0f, 80.0f, 110.0f});
+
+    vector<DisplayCommand> numbers = commandsOfKind(commands, DisplayCommand::measureNumber);
+    REQUIRE(numbers.size() == bars.size());
+    REQUIRE(numbers[4].x == 0.0f + ChordDisplayList::measureNumberOffset);
+    REQUIRE(list->getText(numbers[4].text) == "1");
+    REQUIRE(list->getText(numbers[7].text) == "4");
+
+    // Three hashes in a 4/4 bar and two in a 3/4 one
+    vector<DisplayCommand> hashes = commandsOfKind(commands, DisplayCommand::beatHash);
+    REQUIRE(hashes.size() == 6 * 3 + 2 * 2);
+    REQUIRE(hashes[12].x == 10.0f);
+    REQUIRE(hashes[18].x == 90.0f);
+    REQUIRE(hashes[19].x == 100.0f);
+    REQUIRE(hashes[20].x == 120.0f);
+
+    for (size_t i = 1; i < commands.size(); i++)
+        REQUIRE(commands[i - 1].x <= commands[i].x);
+
+    // No tempo, no bars
+    auto empty = ChordDisplayList::build(make_shared<const ChordTimeline>(), TempoMap(), makeSettings(false), fakeMeasure);
+    REQUIRE(empty->getMeasureCommands().empty());
+}
+
+// An hour at 120 in 4/4 is 1800 bars, a lot more than fit in a window; they all need to be there
+TEST_CASE("display list measures for a long song", "display")
+{
+    TempoMap measures;
+    measures.recordTempo(0.0, 0.0, 120.0);
+    measures.recordMeter(0.0, 4, 4);
+    DisplaySettings settings = makeSettings(false);
+    settings.measuresEnd = 3600.0;
+    auto list = ChordDisplayList::build(make_shared<const ChordTimeline>(), measures, settings, fakeMeasure);
+
+    vector<DisplayCommand> numbers = commandsOfKind(list->getMeasureCommands(), DisplayCommand::measureNumber);
+    // 9 bars in the window before the start (not one right at its edge), then bars 1 to 1800
+    REQUIRE(numbers.size() == 9 + 1800);
+    REQUIRE(list->getText(numbers.back().text) == "1800");
+    REQUIRE(numbers.back().x == 35980.0f + ChordDisplayList::measureNumberOffset);
+
+    // A window on the screen still has the limit
+    vector<pair<int, double>> bars;
+    measures.getBarsInWindow(0.0, 3600.0, bars);
+    REQUIRE(bars.size() == TempoMap::maxBarsInWindow);
+}
+
+TEST_CASE("display list chords", "display")
+{
+    ChordVectorType chords = {{1.0f, "C"}, {5.0f, "Bbm7"}, {11.0f, "C"}, {15.0f, "F#"}};
+    auto snapshot = make_shared<const ChordTimeline>(chords);
+
+    // Without the symbol font, each name is one piece
+    auto plain = ChordDisplayList::build(snapshot, TempoMap(), makeSettings(false), fakeMeasure);
+    const vector<DisplayCommand> &plainCommands = plain->getChordCommands();
+    REQUIRE(plainCommands.size() == 4);
+    REQUIRE(plainCommands[1].x == 50.0f);
+    REQUIRE(plainCommands[1].kind == DisplayCommand::chordText);
+    REQUIRE(plain->getText(plainCommands[1].text) == "Bbm7");
+    // the two C chords share their text
+    REQUIRE(plainCommands[0].text == plainCommands[2].text);
+    REQUIRE(plain->getMaxTextWidth() == 40.0f);
+    REQUIRE(plain->getChords() == snapshot);
+
+    // With it, the flats and sharps are their own pieces, spaced out a bit
+    auto symbols = ChordDisplayList::build(snapshot, TempoMap(), makeSettings(true), fakeMeasure);
+    const vector<DisplayCommand> &commands = symbols->getChordCommands();
+    REQUIRE(commands.size() == 7);
+    // B, flat, m7
+    REQUIRE(commands[1].x == 50.0f);
+    REQUIRE(symbols->getText(commands[1].text) == "B");
+    REQUIRE(commands[2].kind == DisplayCommand::symbolText);
+    REQUIRE(symbols->getText(commands[2].text) == ChordName().getUnicodeSymbol('b'));
+    REQUIRE(commands[2].x == 50.0f + 10.0f + ChordDisplayList::symbolSpacer);
+    REQUIRE(symbols->getText(commands[3].text) == "m7");
+    REQUIRE(commands[3].x == 50.0f + 10.0f + 20.0f + 2 * ChordDisplayList::symbolSpacer);
+    REQUIRE(symbols->getMaxTextWidth() == 10.0f + 20.0f + 20.0f + 2 * ChordDisplayList::symbolSpacer);
+    // F, sharp
+    REQUIRE(commands[6].kind == DisplayCommand::symbolText);
+
+    // Finding where the window starts
+    REQUIRE(ChordDisplayList::findFirst(commands, 0.0f) == 0);
+    REQUIRE(ChordDisplayList::findFirst(commands, 50.0f) == 1);
+    REQUIRE(ChordDisplayList::findFirst(commands, 51.0f) == 2);
+    REQUIRE(ChordDisplayList::findFirst(commands, 1000.0f) == commands.size());
+}
+
+TEST_CASE("display list pieces stay sorted", "display")
+{
+    // A long name right before another (in the next row): its last piece ends up past the start of it
+    auto snapshot = make_shared<const ChordTimeline>(ChordVectorType{{1.0f, "Bbmaj7"}, {1.5f, "C"}});
+    DisplaySettings settings = makeSettings(true);
+    settings.height = 120;
+    auto list = ChordDisplayList::build(snapshot, TempoMap(), settings, fakeMeasure);
+    const vector<DisplayCommand> &commands = list->getChordCommands();
+    REQUIRE(commands.size() == 4);
+    for (size_t i = 1; i < commands.size(); i++)
+        REQUIRE(commands[i - 1].x <= commands[i].x);
+    REQUIRE(list->getText(commands[1].text) == "C");
+    REQUIRE(commands[1].row == 1);
+}
+
+TEST_CASE("display list label rows", "display")
+{
+    // 40 pixel font: one row in a short view, up to three in a tall one
+    DisplaySettings settings = makeSettings(false);
+    settings.height = 60;
+    REQUIRE(ChordDisplayList::getRowsThatFit(settings) == 1);
+    settings.height = 120;
+    REQUIRE(ChordDisplayList::getRowsThatFit(settings) == 2);
+    settings.height = 1000;
+    REQUIRE(ChordDisplayList::getRowsThatFit(settings) == ChordDisplayList::maxLabelRows);
+
+    // A busy spot: a name every second (10 pixels), each 30 pixels wide, then a chord that lasts
+    ChordVectorType chords;
+    for (int i = 0; i < 8; i++)
+        chords.push_back({static_cast<float>(i), i % 2 == 0 ? "Am7" : "D7s"});
+    chords.push_back({8.0f, "Gma"});
+    chords.push_back({20.0f, "C"});
+    auto snapshot = make_shared<const ChordTimeline>(chords);
+
+    // Every name drawn in a row doesn't run into the next one in that row
+    auto checkRows = [](const ChordDisplayList &list)
+    {
+        vector<float> rowEnd(ChordDisplayList::maxLabelRows, -1000.0f);
+        for (const auto &command : list.getChordCommands())
+        {
+            REQUIRE(command.row < list.getRowCount());
+            REQUIRE(command.x >= rowEnd[command.row]);
+            rowEnd[command.row] = command.x + 10.0f * static_cast<float>(list.getText(command.text).size()) +
+                                  ChordDisplayList::labelGap;
+        }
+    };
+
+    // Three rows: still not room for all of them
+    auto tall = ChordDisplayList::build(snapshot, TempoMap(), settings, fakeMeasure);
+    checkRows(*tall);
+    REQUIRE(tall->getRowCount() == 3);
+    REQUIRE(tall->getCulledCount() > 0);
+    REQUIRE(tall->getChordCommands().size() + tall->getCulledCount() == chords.size());
+
+    // One row: the quick chords give way to the longer ones
+    settings.height = 60;
+    auto flat = ChordDisplayList::build(snapshot, TempoMap(), settings, fakeMeasure);
+    checkRows(*flat);
+    REQUIRE(flat->getRowCount() == 1);
+    const vector<DisplayCommand> &commands = flat->getChordCommands();
+    REQUIRE(flat->getText(commands[commands.size() - 2].text) == "Gma");
+    REQUIRE(commands.back().x == 200.0f);
+
+    // Zoomed in, there is room for everything in one row
+    settings.viewSeconds = 2.0f;
+    auto zoomed = ChordDisplayList::build(snapshot, TempoMap(), settings, fakeMeasure);
+    REQUIRE(zoomed->getCulledCount() == 0);
+    REQUIRE(zoomed->getChordCommands().size() == chords.size());
+}
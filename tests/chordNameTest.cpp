@@ -1,5 +1,6 @@
 
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include "ChordName.h"
 #include <algorithm>
 #include <random>
@@ -243,4 +244,181 @@ TEST_CASE("flat sharp", "chordident")
     REQUIRE(*symbol == "\xe2\x99\xad");
     symbol = cn.getUnicodeSymbol('n');
     REQUIRE(*symbol == "\xe2\x99\xae");
-}
\ No newline at end of file
+}
+// The batch (table) naming has to agree with the original one-at-a-time logic for anything it recognizes,
+// and with the single chord version for everything
+TEST_CASE("batch chord naming", "chordident")
+{
+    ChordName cn;
+    vector<NoteSet> masks;
+    vector<vector<int>> noteLists;
+    mt19937 gen(1234);
+    uniform_int_distribution<> noteDist(0, 127);
+    uniform_int_distribution<> countDist(0, 6);
+
+    for (int i = 0; i < 20000; i++)
+    {
+        vector<int> notes;
+        NoteSet mask;
+        int count = countDist(gen);
+        for (int j = 0; j < count; j++)
+        {
+            int note = noteDist(gen);
+            notes.push_back(note);
+            mask.set(note, true);
+        }
+        noteLists.push_back(notes);
+        masks.push_back(mask);
+    }
+    // every pitch class combination over every bass note, spread over a couple of octaves
+    for (int bass = 0; bass < 12; bass++)
+    {
+        for (int classes = 0; classes < 4096; classes++)
+        {
+            vector<int> notes = {48 + bass};
+            NoteSet mask;
+            mask.set(48 + bass, true);
+            for (int pc = 0; pc < 12; pc++)
+            {
+                if (classes & (1 << pc))
+                {
+                    int note = 60 + pc + 12 * (pc % 2);
+                    notes.push_back(note);
+                    mask.set(note, true);
+                }
+            }
+            noteLists.push_back(notes);
+            masks.push_back(mask);
+        }
+    }
+
+    vector<ChordId> ids(masks.size());
+    ChordName::nameChords(masks.data(), ids.data(), masks.size());
+    bool allMatch = true;
+    for (size_t i = 0; i < masks.size(); i++)
+    {
+        bool recognized;
+        ChordId original = cn.scalarChordId(noteLists[i], &recognized);
+        if ((recognized && ids[i] != original) || ids[i] != cn.chordId(noteLists[i]))
+        {
+            allMatch = false;
+            break;
+        }
+    }
+    REQUIRE(allMatch);
+
+    NoteSet empty;
+    ChordId id;
+    ChordName::nameChords(&empty, &id, 1);
+    REQUIRE(id == ChordName::noChord);
+    REQUIRE(cn.chordIdToName(id) == "");
+    REQUIRE(cn.chordIdToName(cn.chordId(NoteSet{12, 19, 22, 26})) == "Gm/C");
+}
+
+TEST_CASE("extended chord names", "chordident")
+{
+    ChordName cn;
+    // root position
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 55, 62}) == "Cadd9");
+    REQUIRE(cn.nameChord(vector<int>{48, 51, 55, 62}) == "Cmadd9");
+    REQUIRE(cn.nameChord(vector<int>{48, 50, 55}) == "Csus2");
+    REQUIRE(cn.nameChord(vector<int>{48, 53, 55}) == "Csus4");
+    REQUIRE(cn.nameChord(vector<int>{48, 53, 55, 58}) == "C7sus4");
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 55, 57}) == "C6");
+    REQUIRE(cn.nameChord(vector<int>{48, 51, 55, 57}) == "Cm6");
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 55, 57, 62}) == "C6/9");
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 55, 58, 62}) == "C9");
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 58, 62}) == "C9");
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 55, 59, 62}) == "CM9");
+    REQUIRE(cn.nameChord(vector<int>{48, 51, 55, 58, 62}) == "Cm9");
+    REQUIRE(cn.nameChord(vector<int>{48, 55, 58, 62, 65}) == "C11");
+    REQUIRE(cn.nameChord(vector<int>{48, 51, 55, 58, 65}) == "Cm11");
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 58, 62, 69}) == "C13");
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 59, 69}) == "CM13");
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 58}) == "C7");
+    REQUIRE(cn.nameChord(vector<int>{50, 54, 57, 61, 64}) == "DM9");
+
+    // inversions are slash chords
+    REQUIRE(cn.nameChord(vector<int>{47, 50, 53, 55}) == "G7/B");
+    REQUIRE(cn.nameChord(vector<int>{52, 55, 58, 60, 62}) == "C9/E");
+
+    // the names the original logic came up with don't change
+    REQUIRE(cn.nameChord(vector<int>{48, 52, 55}) == "C");
+    REQUIRE(cn.nameChord(vector<int>{48, 51, 54, 57}) == "Cdim");
+    REQUIRE(cn.nameChord(vector<int>{48, 53, 57}) == "F/C");
+    REQUIRE(cn.nameChord(vector<int>{50, 53, 57, 60}) == "Dm7");
+    REQUIRE(cn.nameChord(vector<int>{12, 19, 23, 26}) == "G/C");
+}
+
+TEST_CASE("chord names back to ids", "chordident")
+{
+    ChordName cn;
+    // every name that can be made comes back as the same chord
+    bool allMatch = true;
+    for (int quality = 0; quality < 28; quality++)
+    {
+        for (int root = 0; root < 12; root++)
+        {
+            for (int bass = 0; bass < 12; bass++)
+            {
+                for (ChordId spelling : {0u, 1u << 17, 1u << 18, 3u << 17})
+                {
+                    // (the spelling bits don't do anything for the white notes, so compare the names)
+                    ChordId id = ChordName::makeChordId(root, bass, quality, true) | spelling;
+                    ChordId back = ChordName::nameToChordId(cn.chordIdToName(id));
+                    allMatch = allMatch && cn.chordIdToName(back) == cn.chordIdToName(id) &&
+                               ChordName::chordIdUnspelled(back) == ChordName::chordIdUnspelled(id);
+                }
+            }
+            ChordId id = ChordName::makeChordId(root, root, quality, false);
+            allMatch = allMatch && ChordName::nameToChordId(cn.chordIdToName(id)) == id;
+        }
+    }
+    REQUIRE(allMatch);
+
+    REQUIRE(ChordName::nameToChordId("F#m7") == ChordName::nameToChordId("Gbm7") + (1 << 17));
+    REQUIRE(cn.chordIdToName(ChordName::nameToChordId("C6/9")) == "C6/9");
+    REQUIRE(cn.chordIdToName(ChordName::nameToChordId("C6/9/E")) == "C6/9/E");
+    REQUIRE(ChordName::nameToChordId("") == ChordName::noChord);
+    REQUIRE(ChordName::nameToChordId("H7") == ChordName::noChord);
+    REQUIRE(ChordName::nameToChordId("Cmaj9") == ChordName::noChord);
+    REQUIRE(ChordName::nameToChordId("C/X") == ChordName::noChord);
+    REQUIRE(ChordName::nameToChordId("C/Ebb") == ChordName::noChord);
+}
+
+// Not run by default (hidden tag). Run the test executable with "[benchmark]" to see the numbers.
+TEST_CASE("chord naming benchmark", "[.benchmark]")
+{
+    ChordName cn;
+    vector<NoteSet> masks;
+    vector<vector<int>> noteLists;
+    mt19937 gen(99);
+    uniform_int_distribution<> noteDist(36, 84);
+    for (int i = 0; i < 10000; i++)
+    {
+        vector<int> notes;
+        NoteSet mask;
+        for (int j = 0; j < 4; j++)
+        {
+            int note = noteDist(gen);
+            notes.push_back(note);
+            mask.set(note, true);
+        }
+        noteLists.push_back(notes);
+        masks.push_back(mask);
+    }
+    vector<ChordId> ids(masks.size());
+
+    BENCHMARK("scalar naming x10000")
+    {
+        size_t total = 0;
+        for (auto &notes : noteLists)
+            total += cn.chordIdToName(cn.scalarChordId(notes)).size();
+        return total;
+    };
+    BENCHMARK("batch nameChords x10000")
+    {
+        ChordName::nameChords(masks.data(), ids.data(), masks.size());
+        return ids[0];
+    };
+}
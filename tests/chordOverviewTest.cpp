@@ -0,0 +1,115 @@
+#include <catch2/catch_test_macros.hpp>
+#include "ChordOverview.h"
+#include <random>
+using namespace std;
+
+
+static ChordSnapshot makeSnapshot(const ChordVectorType &chords)
+{
+    return make_shared<const ChordTimeline>(chords);
+}
+
+// A long set: a chord every 0.5 to 4 seconds
+static ChordVectorType randomSet(double seconds, mt19937 &gen)
+{
+    const string names[] = {"C", "F", "G7", "Am", "Bb", "Dm", "E7"};
+    uniform_int_distribution<> nameDist(0, 6);
+    uniform_int_distribution<> gapDist(1, 8);
+    ChordVectorType chords;
+    for (float time = 0.0f; time < seconds; time += static_cast<float>(gapDist(gen)) * 0.5f)
+        chords.push_back({time, names[nameDist(gen)]});
+    return chords;
+}
+
+static bool sameBins(const ChordOverview &a, const ChordOverview &b)
+{
+    if (a.getLevelCount() != b.getLevelCount())
+        return false;
+    for (int level = 0; level < a.getLevelCount(); level++)
+    {
+        if (a.getBinCount(level) != b.getBinCount(level))
+            return false;
+        for (size_t bin = 0; bin < a.getBinCount(level); bin++)
+            if (a.getBinChord(level, bin) != b.getBinChord(level, bin))
+                return false;
+    }
+    return true;
+}
+
+TEST_CASE("chord overview", "overview")
+{
+    ChordId c = ChordName::nameToChordId("C");
+    ChordId f = ChordName::nameToChordId("F");
+    ChordId g7 = ChordName::nameToChordId("G7");
+    ChordOverview overview;
+    REQUIRE(overview.update(makeSnapshot({{1.0f, "C"}, {3.0f, "F"}, {3.1f, "G7"}, {5.0f, "C"}})));
+    // Up to the last chord plus its few seconds
+    REQUIRE(overview.getLength() == 9.0);
+    REQUIRE(overview.getBinCount(0) == 36);
+    REQUIRE(overview.getBinCount(overview.getLevelCount() - 1) == 1);
+
+    // At full size, each chord is where it is (to the nearest bin); the F is too short to get a bin
+    vector<OverviewSegment> segments;
+    overview.getSegments(0.0, 9.0, 1000, segments);
+    REQUIRE(segments.size() == 3);
+    REQUIRE((segments[0].start == 1.0f && segments[0].end == 3.0f && segments[0].chord == c));
+    REQUIRE((segments[1].start == 3.0f && segments[1].end == 5.0f && segments[1].chord == g7));
+    REQUIRE((segments[2].start == 5.0f && segments[2].end == 9.0f && segments[2].chord == c));
+    REQUIRE(overview.getBinChord(0, 12) == g7);
+
+    // Squeezed into a few pixels, the biggest chords win
+    overview.getSegments(0.0, 9.0, 2, segments);
+    REQUIRE(segments.size() == 1);
+    REQUIRE(segments[0].chord == c);
+
+    // The same chords again: nothing to do
+    REQUIRE(!overview.update(makeSnapshot({{1.0f, "C"}, {3.0f, "F"}, {3.1f, "G7"}, {5.0f, "C"}})));
+    REQUIRE(overview.getBinChord(1, 2) == c);
+    REQUIRE(overview.update(makeSnapshot({{1.0f, "F"}})));
+    REQUIRE(overview.getBinChord(1, 2) == f);
+    REQUIRE(overview.getLength() == 5.0);
+}
+
+TEST_CASE("chord overview of a long set", "overview")
+{
+    // Three hours: drawing all of it, or any part of it, looks at about as many bins as there are pixels
+    mt19937 gen(8);
+    ChordVectorType chords = randomSet(3 * 60 * 60, gen);
+    ChordOverview overview;
+    overview.update(makeSnapshot(chords));
+    vector<OverviewSegment> segments;
+    for (int pixels : {100, 1000, 1920})
+    {
+        size_t looked = overview.getSegments(0.0, overview.getLength(), pixels, segments);
+        REQUIRE(looked <= 2 * static_cast<size_t>(pixels) + 1);
+        REQUIRE(!segments.empty());
+        looked = overview.getSegments(3600.0, 3700.0, pixels, segments);
+        REQUIRE(looked <= 2 * static_cast<size_t>(pixels) + 1);
+    }
+
+    // Recording more at the end only works out the new part again, and comes out the same as starting over
+    ChordVectorType longer = chords;
+    float end = chords.back().first;
+    longer.push_back({end + 2.0f, "C"});
+    longer.push_back({end + 3.0f, "G7"});
+    REQUIRE(overview.update(makeSnapshot(longer)));
+    REQUIRE(overview.getRebuiltBinCount() < 64);
+    ChordOverview fresh;
+    fresh.update(makeSnapshot(longer));
+    REQUIRE(sameBins(overview, fresh));
+
+    // So does a change in the middle
+    longer[longer.size() / 2].second = "Eb";
+    REQUIRE(overview.update(makeSnapshot(longer)));
+    REQUIRE(overview.getRebuiltBinCount() < fresh.getBinCount(0));
+    ChordOverview freshAgain;
+    freshAgain.update(makeSnapshot(longer));
+    REQUIRE(sameBins(overview, freshAgain));
+
+    // and taking chords off the end
+    longer.resize(longer.size() - 100);
+    REQUIRE(overview.update(makeSnapshot(longer)));
+    ChordOverview shorter;
+    shorter.update(makeSnapshot(longer));
+    REQUIRE(sameBins(overview, shorter));
+}
@@ -0,0 +1,114 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include "ChordTimeline.h"
+#include <algorithm>
+#include <random>
+using namespace std;
+
+
+// A chord every so often (some of them at the same time, which the view can have after quantizing)
+static ChordVectorType randomChords(size_t count, mt19937 &gen)
+{
+    const string names[] = {"C", "F", "G7", "Am", "Bb", "D/F#"};
+    uniform_int_distribution<> nameDist(0, 5);
+    uniform_int_distribution<> gapDist(0, 3);
+    ChordVectorType chords;
+    float time = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        chords.push_back({time, names[nameDist(gen)]});
+        time += static_cast<float>(gapDist(gen)) * 0.25f;
+    }
+    return chords;
+}
+
+static size_t lowerBoundInPairs(const ChordVectorType &chords, float time)
+{
+    auto byTime = [](const pair<float, string> &chord, float t) { return chord.first < t; };
+    return static_cast<size_t>(lower_bound(chords.begin(), chords.end(), time, byTime) - chords.begin());
+}
+
+TEST_CASE("chord timeline", "timeline")
+{
+    ChordVectorType chords = {{0.0f, "C"}, {1.5f, "F"}, {2.0f, "C"}, {4.0f, "G7"}};
+    ChordTimeline timeline(chords);
+    REQUIRE(timeline.size() == 4);
+    REQUIRE(!timeline.hasSearchIndex());
+    REQUIRE(timeline.toVector() == chords);
+    REQUIRE(timeline.getName(2) == "C");
+    REQUIRE(timeline.getChordId(3) == ChordName::nameToChordId("G7"));
+
+    REQUIRE(timeline.lowerBound(-1.0f) == 0);
+    REQUIRE(timeline.lowerBound(1.5f) == 1);
+    REQUIRE(timeline.upperBound(1.5f) == 2);
+    REQUIRE(timeline.lowerBound(3.0f) == 3);
+    REQUIRE(timeline.lowerBound(5.0f) == 4);
+    REQUIRE(timeline.upperBound(4.0f) == 4);
+
+    ChordTimeline empty;
+    REQUIRE(empty.lowerBound(1.0f) == 0);
+    REQUIRE(ChordTimeline({}, 0).lowerBound(1.0f) == 0);
+}
+
+TEST_CASE("chord timeline search matches lower_bound", "timeline")
+{
+    mt19937 gen(5);
+    bool allMatch = true;
+    for (size_t count : {1u, 2u, 3u, 7u, 8u, 15u, 16u, 17u, 100u, 1000u, 5000u})
+    {
+        ChordVectorType chords = randomChords(count, gen);
+        // with and without the Eytzinger copy
+        ChordTimeline timeline(chords, 0);
+        ChordTimeline plain(chords, count + 1);
+        allMatch = allMatch && timeline.hasSearchIndex() && !plain.hasSearchIndex();
+        float last = chords.back().first;
+        for (float time = -0.5f; time <= last + 0.5f; time += 0.125f)
+        {
+            size_t expected = lowerBoundInPairs(chords, time);
+            allMatch = allMatch && timeline.lowerBoundInIndex(time) == expected;
+            allMatch = allMatch && timeline.lowerBoundInColumn(time) == expected;
+            allMatch = allMatch && plain.lowerBound(time) == expected;
+        }
+    }
+    REQUIRE(allMatch);
+}
+
+// Not run by default (hidden tag). Run the test executable with "[benchmark]" to see the numbers.
+TEST_CASE("chord timeline search benchmark", "[.benchmark]")
+{
+    mt19937 gen(17);
+    // About four hours at a chord every second, and a long day of them
+    for (size_t count : {14400u, 250000u})
+    {
+        ChordVectorType chords = randomChords(count, gen);
+        ChordTimeline timeline(chords, 0);
+        float last = chords.back().first;
+        uniform_real_distribution<float> timeDist(0.0f, last);
+        vector<float> queries;
+        for (int i = 0; i < 4096; i++)
+            queries.push_back(timeDist(gen));
+
+        string size = to_string(count) + " chords";
+        BENCHMARK("lower_bound on the time/name pairs, " + size)
+        {
+            size_t sum = 0;
+            for (float time : queries)
+                sum += lowerBoundInPairs(chords, time);
+            return sum;
+        };
+        BENCHMARK("branch free search on the time column, " + size)
+        {
+            size_t sum = 0;
+            for (float time : queries)
+                sum += timeline.lowerBoundInColumn(time);
+            return sum;
+        };
+        BENCHMARK("Eytzinger search, " + size)
+        {
+            size_t sum = 0;
+            for (float time : queries)
+                sum += timeline.lowerBoundInIndex(time);
+            return sum;
+        };
+    }
+}
@@ -0,0 +1,305 @@
+#include <catch2/catch_test_macros.hpp>
+#include "ChordView.h"
+#include "FontCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+using namespace std;
+
+
+// Renders ChordView into an image with no window (and no display needed). The things that don't depend on
+// the fonts (border, playhead, bar lines, that there are chord names at all) are checked in every image.
+// The rest is compared with the golden images in tests/golden, one set per platform since the fonts differ.
+// A missing one is a failure. Set MIDICHORDS_UPDATE_GOLDEN=1 to write them all, e.g. for a new platform or
+// after a change that is supposed to change how things look; they go in the build directory
+// (MIDICHORDS_RENDER_OUTPUT_DIR), and get copied to tests/golden after they've been looked over. A mismatch
+// writes what was drawn there too.
+
+#if JUCE_MAC
+static const char *platformName = "mac";
+#elif JUCE_WINDOWS
+static const char *platformName = "windows";
+#else
+static const char *platformName = "linux";
+#endif
+
+struct RenderCase
+{
+    string name;
+    int width;
+    int height;
+    float fontSize;
+    // chords per second
+    float density;
+};
+
+// A chord (triad) on a random root every 1/density seconds, with a flat or sharp in a lot of the names
+static void addSong(MidiStore &ms, float density, float seconds)
+{
+    mt19937 gen(29);
+    uniform_int_distribution<> rootDist(0, 11);
+    uniform_int_distribution<> minorDist(0, 1);
+    float length = 1.0f / density;
+    int64 eventTime = 0;
+    for (float time = 0.0f; time < seconds; time += length)
+    {
+        int root = 48 + rootDist(gen);
+        for (int note : {root, root + 3 + minorDist(gen), root + 7})
+        {
+            ms.addNoteEventAtTime(eventTime, note, true);
+            ms.setEventTimeSeconds(eventTime++, time);
+            ms.addNoteEventAtTime(eventTime, note, false);
+            ms.setEventTimeSeconds(eventTime++, time + length * 0.9f);
+        }
+    }
+    ms.updateStaticView();
+}
+
+static void moveTo(MidiStore &ms, double seconds)
+{
+    TransportSnapshot transport;
+    transport.timeInSeconds = seconds;
+    transport.bpm = 120.0;
+    transport.timeSigNumerator = 4;
+    transport.timeSigDenominator = 4;
+    ms.publishTransport(transport);
+}
+
+// Bring the view up to date (waiting for its display list) and paint it
+static void render(ChordView &view, juce::Image &image)
+{
+    view.update();
+    while (view.isDisplayListPending())
+        juce::Thread::sleep(1);
+    // and once more, in case something changed while that was being built
+    view.update();
+    while (view.isDisplayListPending())
+        juce::Thread::sleep(1);
+    juce::Graphics g(image);
+    view.paintEntireComponent(g, false);
+}
+
+// How many pixels are noticeably different (a little slack for anti-aliasing)
+static int countDifferentPixels(const juce::Image &a, const juce::Image &b)
+{
+    int different = 0;
+    for (int y = 0; y < a.getHeight(); y++)
+        for (int x = 0; x < a.getWidth(); x++)
+        {
+            juce::Colour pa = a.getPixelAt(x, y);
+            juce::Colour pb = b.getPixelAt(x, y);
+            if (abs(pa.getRed() - pb.getRed()) > 24 || abs(pa.getGreen() - pb.getGreen()) > 24 ||
+                abs(pa.getBlue() - pb.getBlue()) > 24)
+                different++;
+        }
+    return different;
+}
+
+static bool isDark(juce::Colour colour)
+{
+    return colour.getPerceivedBrightness() < 0.35f;
+}
+
+static bool isRed(juce::Colour colour)
+{
+    return colour.getRed() > 200 && colour.getGreen() < 80 && colour.getBlue() < 80;
+}
+
+// Is there a dark pixel at y in one of the columns next to x (a line at a fractional position can end up in
+// either one)
+static bool isDarkNear(const juce::Image &image, int x, int y)
+{
+    for (int column = std::max(0, x - 1); column <= std::min(image.getWidth() - 1, x + 1); column++)
+        if (isDark(image.getPixelAt(column, y)))
+            return true;
+    return false;
+}
+
+// What every render has to have, fonts or not. The song is at 120 in 4/4 (a bar every 2 seconds), the view
+// is 20 seconds wide with the playhead a quarter of the way in, at 10 seconds.
+static void checkLayout(const juce::Image &image)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    float pixelsPerSecond = static_cast<float>(width) / 20.0f;
+    int playheadX = width / 4;
+
+    // The border
+    REQUIRE(isDark(image.getPixelAt(0, height / 2)));
+    REQUIRE(isDark(image.getPixelAt(width - 1, height / 2)));
+    REQUIRE(isDark(image.getPixelAt(width / 2, 0)));
+
+    // The playhead goes top to bottom (a name can be drawn over it here and there)
+    int red = 0;
+    for (int y = 1; y < height - 1; y++)
+        red += isRed(image.getPixelAt(playheadX, y)) ? 1 : 0;
+    REQUIRE(red > (height - 2) * 3 / 4);
+
+    // The bar lines (the window starts at 5 seconds, so the first is at 6), down at the bottom where there
+    // are no names
+    int bars = 0;
+    for (float seconds = 6.0f; seconds < 25.0f; seconds += 2.0f)
+    {
+        int x = static_cast<int>((seconds - 5.0f) * pixelsPerSecond);
+        if (abs(x - playheadX) <= 2)
+            continue;
+        INFO("bar line at " << seconds << " seconds, x " << x);
+        REQUIRE(isDarkNear(image, x, height - 3));
+        bars++;
+    }
+    REQUIRE(bars >= 8);
+    // and nothing in between
+    REQUIRE_FALSE(isDarkNear(image, static_cast<int>(2.0f * pixelsPerSecond), height - 3));
+
+    // Some chord names, across the middle
+    int ink = 0;
+    for (int y = height / 4; y < height * 3 / 4; y++)
+        for (int x = 2; x < width - 2; x++)
+            ink += isDark(image.getPixelAt(x, y)) ? 1 : 0;
+    REQUIRE(ink > width * height / 200);
+}
+
+static void writePng(const juce::Image &image, const juce::File &file)
+{
+    file.deleteFile();
+    juce::FileOutputStream stream(file);
+    juce::PNGImageFormat png;
+    png.writeImageToStream(image, stream);
+}
+
+TEST_CASE("chord view golden images", "render")
+{
+    juce::ScopedJuceInitialiser_GUI gui;
+    juce::File goldenDir(MIDICHORDS_GOLDEN_DIR);
+    juce::File outputDir(MIDICHORDS_RENDER_OUTPUT_DIR);
+    outputDir.createDirectory();
+    bool updateGolden = juce::SystemStats::getEnvironmentVariable("MIDICHORDS_UPDATE_GOLDEN", "") == "1";
+
+    const RenderCase cases[] = {
+        {"sparse", 800, 100, 40.0f, 0.5f},
+        {"dense-rows", 800, 200, 40.0f, 4.0f},
+        {"small", 400, 80, 20.0f, 1.0f},
+    };
+    for (const RenderCase &renderCase : cases)
+    {
+        SECTION(renderCase.name)
+        {
+            MidiStore ms;
+            ms.setQuantizationValue(1);
+            ms.setShortChordThreshold(0.0f);
+            ms.setChordNameSize(renderCase.fontSize);
+            addSong(ms, renderCase.density, 60.0f);
+            moveTo(ms, 10.0);
+
+            ChordView view(ms);
+            view.setSize(renderCase.width, renderCase.height);
+            // The flats and sharps are plain letters until the fonts have been looked up
+            REQUIRE(FontCache::getInstance().waitUntilReady(10000));
+            juce::Image image(juce::Image::RGB, renderCase.width, renderCase.height, true);
+            render(view, image);
+            checkLayout(image);
+
+            juce::File golden = goldenDir.getChildFile(juce::String("chordview-" + renderCase.name + "-" + platformName + ".png"));
+            if (updateGolden)
+            {
+                juce::File updated = outputDir.getChildFile(golden.getFileName());
+                writePng(image, updated);
+                WARN("wrote " << updated.getFullPathName() << "; look it over and copy it to " << goldenDir.getFullPathName());
+                continue;
+            }
+            if (!golden.existsAsFile())
+                FAIL("no golden image " << golden.getFullPathName() << " (make one with MIDICHORDS_UPDATE_GOLDEN=1, "
+                     "look it over and add it)");
+
+            juce::Image expected = juce::ImageFileFormat::loadFrom(golden);
+            REQUIRE(expected.isValid());
+            REQUIRE(expected.getWidth() == image.getWidth());
+            REQUIRE(expected.getHeight() == image.getHeight());
+            int different = countDifferentPixels(image, expected);
+            // What it looks like now, to compare with the golden one
+            if (different > 0)
+                writePng(image, outputDir.getChildFile(golden.getFileNameWithoutExtension() + "-actual.png"));
+            INFO(renderCase.name << ": " << different << " pixels different");
+            REQUIRE(different <= renderCase.width * renderCase.height / 500);
+        }
+    }
+}
+
+// Not run by default (hidden tag). Paints frames of playback at a few sizes, font sizes and densities and
+// reports how long a frame takes (paint only; the display list is built first and not counted).
+TEST_CASE("chord view render benchmark", "[.benchmark]")
+{
+    juce::ScopedJuceInitialiser_GUI gui;
+    const int frames = 600;
+    for (int width : {800, 1920})
+        for (float fontSize : {20.0f, 40.0f})
+            for (float density : {0.5f, 4.0f})
+            {
+                int height = width / 8;
+                MidiStore ms;
+                ms.setQuantizationValue(1);
+                ms.setShortChordThreshold(0.0f);
+                ms.setChordNameSize(fontSize);
+                addSong(ms, density, 120.0f);
+                moveTo(ms, 0.0);
+                ChordView view(ms);
+                view.setSize(width, height);
+                FontCache::getInstance().waitUntilReady(-1);
+                juce::Image image(juce::Image::RGB, width, height, true);
+                render(view, image);
+
+                // Ten seconds of playback at 60 frames a second
+                vector<double> times;
+                times.reserve(frames);
+                for (int i = 0; i < frames; i++)
+                {
+                    moveTo(ms, i / 60.0);
+                    view.update();
+                    juce::Graphics g(image);
+                    auto start = chrono::steady_clock::now();
+                    view.paintEntireComponent(g, false);
+                    times.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+                }
+                sort(times.begin(), times.end());
+                auto percentile = [&](double p) { return times[static_cast<size_t>(p * (frames - 1))]; };
+                WARN(width << "x" << height << ", font " << fontSize << ", " << density << " chords/s: p50 "
+                     << percentile(0.5) << "us, p90 " << percentile(0.9) << "us, p99 " << percentile(0.99)
+                     << "us, max " << times.back() << "us");
+            }
+}
+
+// Not run by default (hidden tag). How long it takes from making the view to its first frame, the first time
+// (the fonts haven't been looked up) and after that. The font lookup happens in the background, so the
+// first open shouldn't be much slower; the time until the symbol font is known is reported separately.
+TEST_CASE("chord view open benchmark", "[.benchmark]")
+{
+    juce::ScopedJuceInitialiser_GUI gui;
+    MidiStore ms;
+    ms.setQuantizationValue(1);
+    ms.setChordNameSize(40.0f);
+    addSong(ms, 1.0f, 120.0f);
+    moveTo(ms, 0.0);
+    juce::Image image(juce::Image::RGB, 1000, 100, true);
+
+    auto open = [&]
+    {
+        auto start = chrono::steady_clock::now();
+        ChordView view(ms);
+        view.setSize(1000, 100);
+        render(view, image);
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+
+    FontCache::getInstance().reset();
+    auto start = chrono::steady_clock::now();
+    double cold = open();
+    FontCache::getInstance().waitUntilReady(-1);
+    double fontsReady = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    vector<double> warm;
+    for (int i = 0; i < 20; i++)
+        warm.push_back(open());
+    sort(warm.begin(), warm.end());
+    WARN("cold open " << cold << "ms (fonts known after " << fontsReady << "ms), warm open p50 " << warm[10]
+         << "ms, max " << warm.back() << "ms");
+}
@@ -0,0 +1,44 @@
+#include <catch2/catch_test_macros.hpp>
+#include "FontCache.h"
+using namespace std;
+
+
+TEST_CASE("font cache", "fonts")
+{
+    FontCache &cache = FontCache::getInstance();
+    atomic<int> probes {0};
+    WaitableEvent letItFinish;
+    cache.reset([&]
+    {
+        probes++;
+        letItFinish.wait(5000);
+        return juce::StringArray({"Helvetica", "Bravura Text", "Arial", "Helvetica"});
+    });
+
+    // Nothing known until it has been looked up
+    REQUIRE(!cache.hasTypeface("Bravura Text").has_value());
+    {
+        WorkerPool::Client client;
+        cache.probeAsync(client);
+        // Another editor opening while the first is still looking doesn't look again
+        WorkerPool::Client another;
+        cache.probeAsync(another);
+        REQUIRE(!cache.isReady());
+        REQUIRE(!cache.hasTypeface("Bravura Text").has_value());
+
+        letItFinish.signal();
+        REQUIRE(cache.waitUntilReady(5000));
+    }
+    REQUIRE(probes == 1);
+    REQUIRE(cache.hasTypeface("Bravura Text") == optional<bool>(true));
+    REQUIRE(cache.hasTypeface("Arial") == optional<bool>(true));
+    REQUIRE(cache.hasTypeface("Comic Sans") == optional<bool>(false));
+
+    // Once known, it stays known
+    WorkerPool::Client client;
+    cache.probeAsync(client);
+    REQUIRE(probes == 1);
+
+    // back to the real fonts for anything after this
+    cache.reset();
+}
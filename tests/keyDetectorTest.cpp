@@ -0,0 +1,118 @@
+#include <catch2/catch_test_macros.hpp>
+#include "KeyDetector.h"
+#include "ChordName.h"
+#include "MidiStore.h"
+using namespace std;
+
+
+// Each chord held for a second
+static int keyOfChords(KeyDetector &keys, const vector<NoteSet> &chords, double &time)
+{
+    for (const NoteSet &chord : chords)
+    {
+        keys.addEvent(time, chord);
+        time += 1.0;
+    }
+    keys.addEvent(time, NoteSet());
+    return keys.getKey();
+}
+
+TEST_CASE("key detection", "keydetect")
+{
+    KeyDetector keys;
+    REQUIRE(keys.getKey() == KeyDetector::noKey);
+    double time = 0.0;
+
+    // I IV V I in C
+    REQUIRE(keyOfChords(keys, {{60, 64, 67}, {60, 65, 69}, {59, 62, 67}, {60, 64, 67}}, time) == 0);
+
+    // I vi IV V I in E major
+    keys.reset();
+    time = 0.0;
+    REQUIRE(keyOfChords(keys, {{64, 68, 71}, {61, 64, 68}, {57, 61, 64}, {59, 63, 66}, {64, 68, 71}}, time) == 4);
+
+    // i iv V i in A minor (the V has the raised 7th)
+    keys.reset();
+    time = 0.0;
+    int key = keyOfChords(keys, {{57, 60, 64}, {62, 65, 69}, {56, 59, 64}, {57, 60, 64}}, time);
+    REQUIRE(key == 12 + 9);
+    REQUIRE(KeyDetector::isMinorKey(key));
+    REQUIRE(KeyDetector::keyTonic(key) == 9);
+}
+
+TEST_CASE("key detection window slides", "keydetect")
+{
+    KeyDetector keys(8.0);
+    double time = 0.0;
+    vector<NoteSet> inC = {{60, 64, 67}, {60, 65, 69}, {59, 62, 67}, {60, 64, 67}};
+    vector<NoteSet> inEb = {{63, 67, 70}, {63, 68, 72}, {62, 65, 70}, {63, 67, 70}};
+    for (int i = 0; i < 5; i++)
+        keyOfChords(keys, inC, time);
+    REQUIRE(keys.getKey() == 0);
+    // once the old key has slid out of the window, only the new one counts
+    for (int i = 0; i < 3; i++)
+        keyOfChords(keys, inEb, time);
+    REQUIRE(keys.getKey() == 3);
+
+    // Time going backwards (e.g., starting over from the top) starts over
+    keys.addEvent(0.0, NoteSet{60, 64, 67});
+    REQUIRE(keys.getKey() == KeyDetector::noKey);
+}
+
+TEST_CASE("chord spelling by key", "keydetect")
+{
+    ChordName cn;
+    ChordId gSharpMinor = cn.chordId(NoteSet{56, 59, 63});
+    REQUIRE(cn.chordIdToName(gSharpMinor) == "Abm");
+    // E major, C# minor
+    REQUIRE(cn.chordIdToName(ChordName::spellForKey(gSharpMinor, 4)) == "G#m");
+    REQUIRE(cn.chordIdToName(ChordName::spellForKey(gSharpMinor, 12 + 1)) == "G#m");
+    // Eb major, no key
+    REQUIRE(cn.chordIdToName(ChordName::spellForKey(gSharpMinor, 3)) == "Abm");
+    REQUIRE(cn.chordIdToName(ChordName::spellForKey(gSharpMinor, KeyDetector::noKey)) == "Abm");
+    // C major has no sharps, so a borrowed Bb stays a Bb
+    REQUIRE(cn.chordIdToName(ChordName::spellForKey(cn.chordId(NoteSet{58, 62, 65}), 0)) == "Bb");
+    // The leading tone in D minor is C#, even though it is a flat key
+    REQUIRE(cn.chordIdToName(ChordName::spellForKey(cn.chordId(NoteSet{49, 55, 57, 64}), 12 + 2)) == "A7/C#");
+    // Respelling doesn't make it a different chord
+    REQUIRE(ChordName::chordIdUnspelled(ChordName::spellForKey(gSharpMinor, 4)) == gSharpMinor);
+    REQUIRE(ChordName::spellForKey(ChordName::noChord, 4) == ChordName::noChord);
+}
+
+TEST_CASE("store spells chords by key", "keydetect")
+{
+    MidiStore ms;
+    ms.setQuantizationValue(1);
+    ms.setShortChordThreshold(0.0);
+    // E B C#m G#m A E, a second each
+    vector<vector<int>> song = {{64, 68, 71}, {59, 63, 66}, {61, 64, 68}, {56, 59, 63}, {57, 61, 64}, {64, 68, 71}};
+    int64 time = 100;
+    for (size_t i = 0; i < song.size(); i++)
+    {
+        if (i > 0)
+        {
+            for (int note : song[i - 1])
+                ms.addNoteEventAtTime(time, note, false);
+        }
+        for (int note : song[i])
+            ms.addNoteEventAtTime(time, note, true);
+        ms.setEventTimeSeconds(time, static_cast<double>(i));
+        time += 100;
+    }
+    for (int note : song.back())
+        ms.addNoteEventAtTime(time, note, false);
+    ms.setEventTimeSeconds(time, static_cast<double>(song.size()));
+
+    REQUIRE_FALSE(ms.getSpellChordsByKey());
+    ms.updateStaticView();
+    auto chords = ms.getChordsInWindow({0.0f, 100.0f});
+    REQUIRE(chords.size() == 6);
+    REQUIRE(chords[3].second == "Abm");
+
+    ms.setSpellChordsByKey(true);
+    ms.updateStaticView();
+    chords = ms.getChordsInWindow({0.0f, 100.0f});
+    REQUIRE(chords.size() == 6);
+    REQUIRE(chords[2].second == "C#m");
+    REQUIRE(chords[3].second == "G#m");
+}
@@ -0,0 +1,104 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "MidiFileImporter.h"
+#include "ChordTimelineWriter.h"
+using namespace std;
+using Catch::Approx;
+
+
+// Notes for a chord from startBeat for a number of beats (960 ticks per beat)
+static void addChord(MidiMessageSequence &track, const vector<int> &notes, double startBeat, double beats, int channel = 1)
+{
+    for (int note : notes)
+    {
+        MidiMessage on = MidiMessage::noteOn(channel, note, (uint8)100);
+        on.setTimeStamp(startBeat * 960.0);
+        track.addEvent(on);
+        MidiMessage off = MidiMessage::noteOff(channel, note);
+        off.setTimeStamp((startBeat + beats) * 960.0);
+        track.addEvent(off);
+    }
+}
+
+static vector<pair<float, string>> importedChords(const MidiFile &midiFile)
+{
+    MidiStore store;
+    MidiFileImporter::importMidiFile(midiFile, store);
+    store.updateStaticView();
+    return store.getChordsInWindow({0.0f, 1000.0f});
+}
+
+TEST_CASE("midi file import", "import")
+{
+    MidiFile midiFile;
+    midiFile.setTicksPerQuarterNote(960);
+
+    // 120 bpm to start with, then 60 from beat 8 on
+    MidiMessageSequence tempoTrack;
+    tempoTrack.addEvent(MidiMessage::tempoMetaEvent(500000));
+    tempoTrack.addEvent(MidiMessage::timeSignatureMetaEvent(4, 4));
+    MidiMessage slower = MidiMessage::tempoMetaEvent(1000000);
+    slower.setTimeStamp(8 * 960.0);
+    tempoTrack.addEvent(slower);
+    midiFile.addTrack(tempoTrack);
+
+    // C, F, G7 and C on one track, the bass on another
+    MidiMessageSequence chords;
+    addChord(chords, {64, 67, 72}, 0, 4);
+    addChord(chords, {65, 69, 72}, 4, 2);
+    addChord(chords, {65, 67, 71}, 6, 2);
+    addChord(chords, {64, 67, 72}, 8, 4);
+    midiFile.addTrack(chords);
+    MidiMessageSequence bass;
+    addChord(bass, {48}, 0, 4);
+    addChord(bass, {41}, 4, 2);
+    addChord(bass, {43}, 6, 2);
+    addChord(bass, {48}, 8, 4);
+    midiFile.addTrack(bass);
+
+    vector<pair<float, string>> expected = {{0.0f, "C"}, {2.0f, "F"}, {3.0f, "G7"}, {4.0f, "C"}};
+    vector<pair<float, string>> imported = importedChords(midiFile);
+    REQUIRE(imported.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        REQUIRE(imported[i].first == Approx(expected[i].first).margin(0.001));
+        REQUIRE(imported[i].second == expected[i].second);
+    }
+
+    // Drums (channel 10) are left out
+    MidiMessageSequence drums;
+    addChord(drums, {36, 42, 46}, 3, 3, MidiFileImporter::drumChannel);
+    midiFile.addTrack(drums);
+    REQUIRE(importedChords(midiFile) == imported);
+}
+
+TEST_CASE("midi file import tempo", "import")
+{
+    MidiFile midiFile;
+    midiFile.setTicksPerQuarterNote(960);
+    // No tempo at all is 120
+    MidiMessageSequence track;
+    addChord(track, {57, 60, 64}, 2, 2);
+    midiFile.addTrack(track);
+
+    MidiStore store;
+    MidiFileImporter::importMidiFile(midiFile, store);
+    REQUIRE(store.getTempoMap().hasTempo());
+    REQUIRE(store.getTempoMap().getTempoAt(2.0) == Approx(120.0));
+    vector<int64> times = store.getEventTimes();
+    REQUIRE(times.size() == 2);
+    REQUIRE(store.getEventTimeInSeconds(times[0]) == Approx(1.0));
+    REQUIRE(store.getEventTimeInPpq(times[0]).value() == Approx(2.0));
+}
+
+TEST_CASE("chord timeline writer", "import")
+{
+    vector<pair<float, string>> chords = {{0.0f, "C"}, {2.5f, "F/A"}};
+    REQUIRE(ChordTimelineWriter::toCsv(chords) == "time,chord\n0.000,C\n2.500,F/A\n");
+    REQUIRE(ChordTimelineWriter::toJson("my \"song\"", chords) ==
+            "{\"name\": \"my \\\"song\\\"\", \"chords\": [\n"
+            "  {\"time\": 0.000, \"chord\": \"C\"},\n"
+            "  {\"time\": 2.500, \"chord\": \"F/A\"}\n"
+            "]}\n");
+    REQUIRE(ChordTimelineWriter::toJson("empty", {}) == "{\"name\": \"empty\", \"chords\": []}\n");
+}
@@ -1,8 +1,12 @@
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include "MidiStore.h"
 #include <algorithm>
 #include <random>
+#include <thread>
 using namespace std;
+using Catch::Approx;
 
 TEST_CASE("midi store basics", "storage")
 {
@@ -181,6 +185,41 @@ TEST_CASE("test chord size prop", "storage")
     REQUIRE(size == 25.0);
 }
 
+TEST_CASE("settings follow the state tree", "storage")
+{
+    MidiStore ms;
+    juce::ValueTree vtn("restored");
+    vtn.setProperty(ms.midiChordsVersionProp, ms.currentVersion, nullptr);
+    vtn.setProperty(ms.viewWidthProp, 12.0f, nullptr);
+    vtn.setProperty(ms.playHeadPositionProp, 40.0f, nullptr);
+    vtn.setProperty(ms.chordNameSizeProp, 500.0f, nullptr);
+    vtn.setProperty(ms.spellByKeyProp, true, nullptr);
+    vtn.setProperty(ms.quantizationValueProp, 10, nullptr);
+
+    // A loaded state sets everything (and whatever is missing or out of range gets the default)
+    ms.setArpeggioWindow(1.0f);
+    REQUIRE(ms.replaceState(vtn));
+    REQUIRE(ms.getTimeWidth() == 12.0f);
+    REQUIRE(ms.getPlayHeadPosition() == 40.0f);
+    REQUIRE(ms.getChordNameSize() == 25.0f);
+    REQUIRE(ms.getSpellChordsByKey());
+    REQUIRE(ms.getQuantizationValue() == 10);
+    REQUIRE(ms.getArpeggioWindow() == 0.0f);
+    REQUIRE(ms.getShortChordThreshold() == 0.5f);
+
+    // and a change goes in the tree too, so it is saved with the rest of the state
+    ms.setTimeWidth(30.0f);
+    ms.setQuantizationValue(0);
+    REQUIRE(ms.getTimeWidth() == 30.0f);
+    REQUIRE(static_cast<float>(ms.getState().getProperty(ms.viewWidthProp)) == 30.0f);
+    REQUIRE(ms.getQuantizationValue() == 1000);
+    juce::ValueTree saved = ms.getState().createCopy();
+    MidiStore restored;
+    REQUIRE(restored.replaceState(saved));
+    REQUIRE(restored.getTimeWidth() == 30.0f);
+    REQUIRE(restored.getPlayHeadPosition() == 40.0f);
+}
+
 
 TEST_CASE("empty note slot", "storage")
 {
@@ -549,6 +588,90 @@ TEST_CASE("short chord removal first", "storage")
 }
 
 
+// Changing the threshold filters the view again without rebuilding it, and gets the same answer as a rebuild
+TEST_CASE("short chord threshold change", "storage")
+{
+    MidiStore ms;
+    MidiStore rebuilt;
+    ms.setQuantizationValue(1);
+    rebuilt.setQuantizationValue(1);
+    ms.setShortChordThreshold(0.0);
+
+    // chords of all sorts of lengths, C F C G ...
+    const int roots[] = {12, 17, 12, 19, 21, 17, 12, 14};
+    double time = 1.0;
+    for (int i = 0; i < 40; i++)
+    {
+        double length = 0.05 * (1 + (i * 7) % 13);
+        addNote(ms, time, length, roots[i % 8]);
+        addNote(rebuilt, time, length, roots[i % 8]);
+        time += length;
+    }
+    size_t allChords = ms.getChordsInWindow({0.0, 100.0}).size();
+
+    for (float threshold : {0.0f, 0.12f, 0.3f, 0.31f, 0.5f, 0.12f, 2.0f, 0.0f})
+    {
+        ms.setShortChordThreshold(threshold);
+        rebuilt.setShortChordThreshold(threshold);
+        rebuilt.updateStaticView();
+        REQUIRE(ms.getChordsInWindow({0.0, 100.0}) == rebuilt.getChordsInWindow({0.0, 100.0}));
+    }
+    REQUIRE(ms.getChordsInWindow({0.0, 100.0}).size() == allChords);
+
+    // A new note isn't in the view until it is rebuilt; changing the threshold doesn't do that
+    ms.addNoteEventAtTime(100000, 21, true);
+    ms.setEventTimeSeconds(100000, 100.0);
+    ms.setShortChordThreshold(0.5);
+    REQUIRE(ms.getChordsInWindow({99.0, 101.0}).empty());
+    ms.updateStaticView();
+    REQUIRE(ms.getChordsInWindow({99.0, 101.0}).size() == 1);
+}
+
+// While recording, only the new chords go through the short chord filter. What is shown has to be the same
+// as filtering all of them at once, including when a note is recorded again back in the song.
+TEST_CASE("short chord filter while recording", "storage")
+{
+    const int roots[] = {12, 17, 12, 19, 21, 17, 12, 14};
+    for (float threshold : {0.0f, 0.2f, 0.35f, 0.6f})
+    {
+        MidiStore recording;
+        MidiStore rebuilt;
+        recording.setQuantizationValue(1);
+        rebuilt.setQuantizationValue(1);
+        recording.setShortChordThreshold(threshold);
+        rebuilt.setShortChordThreshold(threshold);
+
+        double time = 1.0;
+        for (int i = 0; i < 60; i++)
+        {
+            double length = 0.05 * (1 + (i * 7) % 13);
+            // (addNote brings the view up to date after every note)
+            addNote(recording, time, length, roots[i % 8]);
+            addNote(rebuilt, time, length, roots[i % 8]);
+            time += length;
+            if (i % 5 == 0)
+            {
+                // Starting over on the whole thing gets the same chords
+                rebuilt.setShortChordThreshold(threshold + 10.0f);
+                rebuilt.setShortChordThreshold(threshold);
+                REQUIRE(recording.getChordsInWindow({0.0, 100.0}) == rebuilt.getChordsInWindow({0.0, 100.0}));
+            }
+        }
+
+        // Nothing new, nothing changes
+        int version = recording.getViewVersion();
+        recording.updateStaticView();
+        REQUIRE(recording.getViewVersion() == version);
+
+        // A chord recorded back in the middle of the song
+        addNote(recording, 3.0, 0.4, 21);
+        addNote(rebuilt, 3.0, 0.4, 21);
+        rebuilt.setShortChordThreshold(threshold + 10.0f);
+        rebuilt.setShortChordThreshold(threshold);
+        REQUIRE(recording.getChordsInWindow({0.0, 100.0}) == rebuilt.getChordsInWindow({0.0, 100.0}));
+    }
+}
+
 TEST_CASE("get event times", "storage") 
 {
     MidiStore ms;
@@ -591,6 +714,193 @@ TEST_CASE("get event times", "storage")
 }
 
 
+TEST_CASE("transport snapshot", "storage")
+{
+    MidiStore ms;
+    TransportSnapshot snapshot;
+
+    // defaults: nothing known about the transport yet
+    REQUIRE(ms.getBPMinute() == std::nullopt);
+    REQUIRE(ms.getBPMeasure() == std::nullopt);
+    REQUIRE(ms.getIsPlaying() == false);
+
+    snapshot.timeInSamples = 48000;
+    snapshot.timeInSeconds = 1.0;
+    snapshot.bpm = 120.0;
+    snapshot.timeSigNumerator = 3;
+    snapshot.timeSigDenominator = 4;
+    snapshot.isPlaying = true;
+    ms.publishTransport(snapshot);
+    REQUIRE(ms.getLastEventTime() == 48000);
+    REQUIRE(ms.getLastEventTimeInSeconds() == 1.0);
+    REQUIRE(*ms.getBPMinute() == 120.0);
+    REQUIRE(*ms.getBPMeasure() == 3);
+    REQUIRE(ms.getIsPlaying() == true);
+
+    // the individual setters only touch their own field
+    ms.setIsPlaying(false);
+    REQUIRE(ms.getTransport().timeInSamples == 48000);
+    REQUIRE(ms.getTransport().isPlaying == false);
+}
+
+// Hammer the snapshot from an "audio thread" while reading it; every read must be self-consistent
+TEST_CASE("transport snapshot does not tear", "storage")
+{
+    MidiStore ms;
+    atomic<bool> done = false;
+
+    std::thread writer([&]
+    {
+        for (int64 i = 1; i <= 200000; i++)
+        {
+            TransportSnapshot snapshot;
+            snapshot.timeInSamples = i;
+            snapshot.timeInSeconds = static_cast<double>(i);
+            snapshot.ppqPosition = static_cast<double>(i) * 2.0;
+            snapshot.hostTimeNs = i * 3;
+            ms.publishTransport(snapshot);
+        }
+        done = true;
+    });
+
+    int64 lastSeen = 0;
+    bool consistent = true;
+    bool monotonic = true;
+    while (!done)
+    {
+        TransportSnapshot snapshot = ms.getTransport();
+        consistent = consistent && snapshot.timeInSeconds == static_cast<double>(snapshot.timeInSamples) &&
+                     snapshot.ppqPosition == static_cast<double>(snapshot.timeInSamples) * 2.0 &&
+                     snapshot.hostTimeNs == snapshot.timeInSamples * 3;
+        monotonic = monotonic && snapshot.timeInSamples >= lastSeen;
+        lastSeen = snapshot.timeInSamples;
+    }
+    writer.join();
+    REQUIRE(consistent);
+    REQUIRE(monotonic);
+    REQUIRE(ms.getLastEventTime() == 200000);
+}
+
+// Events within a block get their own time in seconds, and re-recording the same passage with the
+// host's blocks landing differently gives the same stored seconds (snapped to the quantized time)
+TEST_CASE("sample accurate event seconds", "storage")
+{
+    MidiStore ms;
+    TransportSnapshot block;
+    block.timeInSamples = 96000;
+    block.timeInSeconds = 2.0;
+
+    REQUIRE(block.secondsAtSampleOffset(0, 48000.0) == 2.0);
+    REQUIRE(block.secondsAtSampleOffset(1200, 48000.0) == Approx(2.025));
+    // no sample rate (not prepared yet) ... block start is the best there is
+    REQUIRE(block.secondsAtSampleOffset(1200, 0.0) == 2.0);
+
+    ms.setQuantizationValue(1000);
+    ms.setSampleRate(48000.0);
+    // first pass: event at 97210 (quantized to 97000)
+    ms.addNoteEventAtTime(97210, 60, true);
+    ms.setEventTimeSeconds(97210, block.secondsAtSampleOffset(1210, 48000.0));
+    REQUIRE(ms.getEventTimeInSeconds(97000) == Approx(97000.0 / 48000.0));
+
+    // second pass: a bit of jitter and a different block start
+    TransportSnapshot block2;
+    block2.timeInSamples = 96512;
+    block2.timeInSeconds = 96512.0 / 48000.0;
+    ms.addNoteEventAtTime(97190, 60, true);
+    double firstPass = ms.getEventTimeInSeconds(97000);
+    ms.setEventTimeSeconds(97190, block2.secondsAtSampleOffset(97190 - 96512, 48000.0));
+    REQUIRE(ms.getEventTimeInSeconds(97000) == firstPass);
+    REQUIRE(ms.getEventTimes().size() == 1);
+}
+
+// A long random "song": at each step one of the three or so upper notes is let go and another one
+// starts, plus a bass note that is held for a long time, so that there are plenty of notes sounding across
+// the places where the view build splits up the events
+static void addRandomSong(MidiStore &ms, int steps)
+{
+    mt19937 gen(1234);
+    const vector<int> scale = {60, 62, 64, 65, 67, 69, 71, 72};
+    uniform_int_distribution<size_t> noteDist(0, scale.size() - 1);
+    vector<int> on;
+    for (int step = 0; step < steps; step++)
+    {
+        int64 time = 1000 + step * 100;
+        if (on.size() >= 3)
+        {
+            size_t off = noteDist(gen) % on.size();
+            ms.addNoteEventAtTime(time, on[off], false);
+            on.erase(on.begin() + static_cast<long>(off));
+        }
+        int note = scale[noteDist(gen)];
+        if (find(on.begin(), on.end(), note) == on.end())
+        {
+            ms.addNoteEventAtTime(time, note, true);
+            on.push_back(note);
+        }
+        if (step % 4999 == 0)
+        {
+            ms.addNoteEventAtTime(time, 36 + (step / 4999) % 12, true);
+            if (step > 0)
+                ms.addNoteEventAtTime(time, 36 + (step / 4999 - 1) % 12, false);
+        }
+        ms.setEventTimeSeconds(time, static_cast<double>(time) / 1000.0);
+    }
+}
+
+static vector<pair<float, string>> buildView(MidiStore &ms)
+{
+    ms.updateStaticView();
+    return ms.getChordsInWindow({0.0f, 100000.0f});
+}
+
+// Building the view on several threads (chunks replayed separately and then patched up from the
+// checkpoints) has to give exactly what the straight replay on one thread does
+TEST_CASE("parallel view build", "storage")
+{
+    MidiStore ms;
+    ms.setQuantizationValue(1);
+    ms.setShortChordThreshold(0.0f);
+    addRandomSong(ms, 20000);
+    vector<pair<float, string>> sequential = buildView(ms);
+    REQUIRE(sequential.size() > 1000);
+
+    WorkerPool::Client client;
+    ms.setWorkerPool(&client);
+    for (int threads : {2, 3, 0})
+    {
+        ms.setMaxViewBuildThreads(threads);
+        REQUIRE(buildView(ms) == sequential);
+    }
+
+    // and the same with the broken chord window and key spelling, which are done after the replay
+    ms.setArpeggioWindow(0.5f);
+    ms.setSpellChordsByKey(true);
+    vector<pair<float, string>> parallel = buildView(ms);
+    ms.setWorkerPool(nullptr);
+    REQUIRE(buildView(ms) == parallel);
+}
+
+// Not run by default (hidden tag). Run the test executable with "[benchmark]" to see the numbers. The
+// shared pool has at most getDefaultNumThreads() workers, so the higher counts only mean something on a
+// machine with enough cores.
+TEST_CASE("parallel view build benchmark", "[.benchmark]")
+{
+    MidiStore ms;
+    ms.setQuantizationValue(1);
+    addRandomSong(ms, 100000);
+    WorkerPool::Client client;
+    ms.setWorkerPool(&client);
+
+    ms.setMaxViewBuildThreads(1);
+    BENCHMARK("1 thread") { return buildView(ms).size(); };
+    ms.setMaxViewBuildThreads(2);
+    BENCHMARK("2 threads") { return buildView(ms).size(); };
+    ms.setMaxViewBuildThreads(4);
+    BENCHMARK("4 threads") { return buildView(ms).size(); };
+    ms.setMaxViewBuildThreads(8);
+    BENCHMARK("8 threads") { return buildView(ms).size(); };
+}
+
 // Test temp stuff ... figuring out how sorted vector of pairs works
 TEST_CASE("tmp", "storage")
 {
@@ -0,0 +1,80 @@
+#include <catch2/catch_test_macros.hpp>
+#include "NoteSet.h"
+#include <random>
+#include <set>
+using namespace std;
+
+
+// The basics work at compile time
+static_assert(NoteSet({60, 64, 67}).size() == 3);
+static_assert(NoteSet({60, 64, 67}).lowest() == 60);
+static_assert(NoteSet({60, 64, 67}).highest() == 67);
+static_assert(NoteSet({0, 12, 127}).pitchClasses() == ((1 << 0) | (1 << 7)));
+static_assert((NoteSet({1, 2, 3}) - NoteSet({2})) == NoteSet({1, 3}));
+static_assert(NoteSet().lowest() == -1);
+
+
+TEST_CASE("note set basics", "noteset")
+{
+    NoteSet notes;
+    REQUIRE(notes.isEmpty());
+    REQUIRE(notes.size() == 0);
+    REQUIRE(notes.begin() == notes.end());
+
+    notes.add(64);
+    notes.add(63);
+    notes.add(0);
+    notes.add(127);
+    // ignored
+    notes.add(128);
+    notes.add(-1);
+    REQUIRE(notes.size() == 4);
+    REQUIRE(notes.contains(63));
+    REQUIRE(notes.contains(64));
+    REQUIRE_FALSE(notes.contains(65));
+    REQUIRE(notes.lowest() == 0);
+    REQUIRE(notes.highest() == 127);
+
+    vector<int> expected = {0, 63, 64, 127};
+    REQUIRE(notes.toVector() == expected);
+    REQUIRE(NoteSet::fromVector(expected) == notes);
+
+    notes.remove(0);
+    notes.set(127, false);
+    REQUIRE(notes.lowest() == 63);
+    REQUIRE(notes.highest() == 64);
+    notes.clear();
+    REQUIRE(notes.isEmpty());
+}
+
+// Same answers as a set<int> for a bunch of random operations
+TEST_CASE("note set matches set", "noteset")
+{
+    mt19937 gen(42);
+    uniform_int_distribution<> noteDist(0, 127);
+    NoteSet notes;
+    set<int> reference;
+
+    for (int i = 0; i < 5000; i++)
+    {
+        int note = noteDist(gen);
+        bool on = (i % 3) != 0;
+        notes.set(note, on);
+        if (on)
+            reference.insert(note);
+        else
+            reference.erase(note);
+
+        uint32_t classes = 0;
+        for (int n : reference)
+            classes |= 1u << (n % 12);
+        REQUIRE(notes.size() == static_cast<int>(reference.size()));
+        REQUIRE(notes.pitchClasses() == classes);
+        if (!reference.empty())
+        {
+            REQUIRE(notes.lowest() == *reference.begin());
+            REQUIRE(notes.highest() == *reference.rbegin());
+        }
+    }
+    REQUIRE(notes.toVector() == vector<int>(reference.begin(), reference.end()));
+}
@@ -0,0 +1,141 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "PlayheadEstimator.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+using namespace std;
+using Catch::Approx;
+
+
+// A host playing from the start with big (2048 sample) blocks, calling the plugin up to 1.5ms early or
+// late, and the UI drawing at about 60 frames a second (give or take 3ms). Time is all simulated.
+struct JitteryHost
+{
+    int64 nowNs = 1000000000;
+    int64 startNs = 1000000000;
+    TransportSnapshot transport;
+    bool stampBlocks = true;
+
+    double blockSeconds = 2048.0 / 44100.0;
+    mt19937 gen {3};
+    uniform_real_distribution<double> blockJitter {-0.0015, 0.0015};
+    uniform_real_distribution<double> frameJitter {-0.003, 0.003};
+
+    double trueTime() const { return static_cast<double>(nowNs - startNs) / 1.0e9; }
+
+    // Run for a while, calling frame() with the estimate and the true position at every frame
+    template <typename Frame> void play(double seconds, Frame frame)
+    {
+        PlayheadEstimator::Clock clock = [this] { return nowNs; };
+        PlayheadEstimator estimator(clock);
+        int block = 0;
+        int64 lastFrameNs = nowNs;
+        double nextBlock = 0.0;
+        double nextFrame = 0.0;
+        while (nextFrame < seconds)
+        {
+            if (nextBlock < nextFrame)
+            {
+                nowNs = startNs + static_cast<int64>(nextBlock * 1.0e9);
+                transport.timeInSeconds = block * blockSeconds;
+                transport.isPlaying = true;
+                transport.hostTimeNs = stampBlocks ? nowNs : 0;
+                block++;
+                nextBlock = block * blockSeconds + blockJitter(gen);
+            }
+            else
+            {
+                nowNs = startNs + static_cast<int64>(nextFrame * 1.0e9);
+                double position = estimator.update(transport, static_cast<double>(nowNs - lastFrameNs) / 1.0e9);
+                lastFrameNs = nowNs;
+                frame(position, trueTime());
+                nextFrame += 1.0 / 60.0 + frameJitter(gen);
+            }
+        }
+    }
+};
+
+TEST_CASE("playhead estimate follows a jittery host", "playhead")
+{
+    JitteryHost host;
+    double maxError = 0.0;
+    double lastPosition = -1.0;
+    double lastTime = 0.0;
+    bool alwaysForward = true;
+    bool noJumps = true;
+    host.play(20.0, [&](double position, double time)
+    {
+        // Once it has had a second to settle, it is within a millisecond
+        if (time > 1.0)
+            maxError = max(maxError, fabs(position - time));
+        if (lastPosition >= 0.0)
+        {
+            alwaysForward = alwaysForward && position >= lastPosition;
+            // never more than a few percent faster or slower than the time going by
+            double step = position - lastPosition;
+            double elapsed = time - lastTime;
+            noJumps = noJumps && (time < 1.0 || fabs(step - elapsed) < 0.05 * elapsed);
+        }
+        lastPosition = position;
+        lastTime = time;
+    });
+    REQUIRE(maxError < 0.001);
+    REQUIRE(alwaysForward);
+    REQUIRE(noJumps);
+}
+
+TEST_CASE("playhead estimate without stamped blocks", "playhead")
+{
+    // Without the stamps it can't know how late the block is, but it still moves smoothly and stays
+    // within a block of where it should be
+    JitteryHost host;
+    host.stampBlocks = false;
+    double maxError = 0.0;
+    double lastPosition = -1.0;
+    bool alwaysForward = true;
+    host.play(20.0, [&](double position, double time)
+    {
+        if (time > 1.0)
+            maxError = max(maxError, fabs(position - time));
+        alwaysForward = alwaysForward && position >= lastPosition;
+        lastPosition = position;
+    });
+    REQUIRE(maxError < host.blockSeconds);
+    REQUIRE(alwaysForward);
+}
+
+TEST_CASE("playhead estimate seeking and stopping", "playhead")
+{
+    int64 nowNs = 5000000000;
+    PlayheadEstimator estimator([&nowNs] { return nowNs; });
+    TransportSnapshot transport;
+
+    // Stopped: it only moves when the host moves the playhead
+    transport.timeInSeconds = 12.0;
+    transport.hostTimeNs = nowNs;
+    REQUIRE(estimator.update(transport, 0.0) == Approx(12.0));
+    nowNs += 100000000;
+    estimator.moveTo(15.0);
+    REQUIRE(estimator.update(transport, 0.1) == Approx(15.0));
+
+    // Starting playback goes straight to the host's position (plus the time since the block)
+    transport.isPlaying = true;
+    transport.hostTimeNs = nowNs;
+    nowNs += 10000000;
+    REQUIRE(estimator.update(transport, 0.01) == Approx(12.01));
+
+    // So does a loop going back to the start
+    transport.timeInSeconds = 2.0;
+    transport.hostTimeNs = nowNs;
+    nowNs += 20000000;
+    REQUIRE(estimator.update(transport, 0.02) == Approx(2.02));
+
+    // A small difference (the host says it is 10ms further along) is steered out over a few frames instead
+    transport.timeInSeconds = 2.03;
+    transport.hostTimeNs = nowNs;
+    nowNs += 16000000;
+    double position = estimator.update(transport, 0.016);
+    REQUIRE(position > 2.036);
+    REQUIRE(position < 2.046);
+}
@@ -0,0 +1,172 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include "ProgressionIndex.h"
+#include "MidiStore.h"
+#include <random>
+using namespace std;
+
+
+static vector<ChordId> chordIds(const vector<string> &names)
+{
+    vector<ChordId> ids;
+    for (const string &name : names)
+        ids.push_back(ChordName::nameToChordId(name));
+    return ids;
+}
+
+// The slow way: try every position
+static vector<size_t> findByScanning(const vector<ChordId> &chords, const vector<ChordId> &progression, bool anyKey)
+{
+    vector<size_t> positions;
+    for (size_t start = 0; start + progression.size() <= chords.size(); start++)
+    {
+        int shift = (ChordName::chordIdRoot(chords[start]) - ChordName::chordIdRoot(progression[0]) + 12) % 12;
+        bool match = true;
+        for (size_t i = 0; i < progression.size() && match; i++)
+        {
+            ChordId wanted = progression[i];
+            if (anyKey)
+                wanted = ChordName::makeChordId(ChordName::chordIdRoot(wanted) + shift, ChordName::chordIdBass(wanted) + shift,
+                                                ChordName::chordIdQuality(wanted), ChordName::chordIdIsSlash(wanted));
+            match = ChordName::chordIdUnspelled(chords[start + i]) == ChordName::chordIdUnspelled(wanted);
+        }
+        if (match)
+            positions.push_back(start);
+    }
+    return positions;
+}
+
+TEST_CASE("progression index", "progression")
+{
+    ProgressionIndex index;
+    vector<ChordId> song = chordIds({"C", "Am", "F", "G", "C", "Am", "F", "G7", "Em", "C", "G", "D", "Em", "C", "G", "D"});
+    index.build(song);
+    REQUIRE(index.size() == song.size());
+
+    REQUIRE(index.find(chordIds({"Am", "F"}), false) == vector<size_t>{1, 5});
+    REQUIRE(index.find(chordIds({"Am", "F", "C", "G"}), false).empty());
+    REQUIRE(index.find(chordIds({"G"}), false) == vector<size_t>{3, 10, 14});
+    // Am F C G is the same progression as Em C G D
+    REQUIRE(index.find(chordIds({"Am", "F", "C", "G"}), true) == vector<size_t>{8, 12});
+    // spelling doesn't matter
+    REQUIRE(index.find(chordIds({"E", "Gbm"}), true) == index.find(chordIds({"E", "F#m"}), true));
+    // with a key change, any major chord is just a major chord
+    REQUIRE(index.find(chordIds({"Bb"}), true).size() == 11);
+    REQUIRE(index.find({}, false).empty());
+    REQUIRE(index.find({ChordName::noChord}, true).empty());
+
+    index.clear();
+    REQUIRE(index.find(chordIds({"C"}), false).empty());
+}
+
+TEST_CASE("progression index matches scanning", "progression")
+{
+    mt19937 gen(7);
+    const vector<ChordId> vocabulary = chordIds({"C", "Dm", "Em", "F", "G", "Am", "G7", "F/C", "Bb", "Eb", "Dm7/C"});
+    uniform_int_distribution<size_t> chordDist(0, vocabulary.size() - 1);
+
+    bool allMatch = true;
+    for (int trial = 0; trial < 200 && allMatch; trial++)
+    {
+        // short songs with a small vocabulary, so that there are plenty of repeats
+        vector<ChordId> song;
+        size_t length = static_cast<size_t>(trial) % 60;
+        for (size_t i = 0; i < length; i++)
+            song.push_back(vocabulary[chordDist(gen) % (static_cast<size_t>(trial) % 4 + 2)]);
+        ProgressionIndex index;
+        index.build(song);
+
+        for (int query = 0; query < 20 && allMatch && !song.empty(); query++)
+        {
+            // mostly pieces of the song itself, so that something is found
+            size_t start = chordDist(gen) % song.size();
+            size_t count = 1 + chordDist(gen) % 4;
+            vector<ChordId> progression(song.begin() + static_cast<long>(start),
+                                        song.begin() + static_cast<long>(min(song.size(), start + count)));
+            if (query % 3 == 0)
+                progression.back() = vocabulary[chordDist(gen)];
+            for (bool anyKey : {false, true})
+                allMatch = allMatch && index.find(progression, anyKey) == findByScanning(song, progression, anyKey);
+        }
+    }
+    REQUIRE(allMatch);
+}
+
+TEST_CASE("find progression in the store", "progression")
+{
+    MidiStore ms;
+    ms.setQuantizationValue(1);
+    ms.setShortChordThreshold(0.0f);
+    // C F G C then D G A D: two seconds each
+    const vector<vector<int>> chords = {{48, 52, 55}, {53, 57, 60}, {55, 59, 62}, {48, 52, 55},
+                                        {50, 54, 57}, {55, 59, 62}, {57, 61, 64}, {50, 54, 57}};
+    int64 time = 0;
+    for (const vector<int> &chord : chords)
+    {
+        for (int note : chord)
+            ms.addNoteEventAtTime(time, note, true);
+        ms.setEventTimeSeconds(time, static_cast<double>(time) / 1000.0);
+        time += 2000;
+        for (int note : chord)
+            ms.addNoteEventAtTime(time - 1, note, false);
+        ms.setEventTimeSeconds(time - 1, static_cast<double>(time - 1) / 1000.0);
+    }
+    ms.updateStaticView();
+
+    vector<pair<float, float>> expected = {{2.0f, 6.0f}};
+    REQUIRE(ms.findProgression("F G") == expected);
+    // (G C D is a I IV V too)
+    expected = {{0.0f, 6.0f}, {4.0f, 10.0f}, {8.0f, 14.0f}};
+    REQUIRE(ms.findProgression("| C | F | G |", true) == expected);
+    // the last one runs to the end of the song
+    expected = {{10.0f, 14.0f}};
+    REQUIRE(ms.findProgression("G, A, D") == expected);
+    REQUIRE(ms.findProgression("C Fmaj9").empty());
+
+    // The index follows the view
+    ms.addNoteEventAtTime(time, 53, true);
+    ms.addNoteEventAtTime(time, 57, true);
+    ms.addNoteEventAtTime(time, 60, true);
+    ms.setEventTimeSeconds(time, static_cast<double>(time) / 1000.0);
+    ms.updateStaticView();
+    expected = {{2.0f, 4.0f}, {16.0f, 16.0f}};
+    REQUIRE(ms.findProgression("F") == expected);
+}
+
+// Not run by default (hidden tag). Run the test executable with "[benchmark]" to see the numbers.
+TEST_CASE("progression search benchmark", "[.benchmark]")
+{
+    // About four hours at a chord every second, from a vocabulary big enough to not be completely repetitive
+    mt19937 gen(11);
+    const vector<string> vocabulary = {"C", "Dm", "Em", "F", "G", "Am", "G7", "F/C", "Bb", "Eb", "Dm7/C", "E7",
+                                       "A7", "Cm", "Fm", "Ab", "Db", "D7", "Bm7b5", "Gsus4"};
+    uniform_int_distribution<size_t> chordDist(0, vocabulary.size() - 1);
+    vector<string> names;
+    for (size_t i = 0; i < 4 * 60 * 60; i++)
+        names.push_back(vocabulary[chordDist(gen)]);
+    vector<ChordId> song = chordIds(names);
+    vector<string> query = {"Am", "F", "C", "G"};
+    vector<ChordId> queryIds = chordIds(query);
+
+    ProgressionIndex index;
+    BENCHMARK("build index (14400 chords)")
+    {
+        index.build(song);
+        return index.size();
+    };
+    BENCHMARK("find Am F C G")
+    {
+        return index.find(queryIds, false).size();
+    };
+    BENCHMARK("find Am F C G in any key")
+    {
+        return index.find(queryIds, true).size();
+    };
+    BENCHMARK("scan the names for Am F C G")
+    {
+        size_t found = 0;
+        for (size_t i = 0; i + query.size() <= names.size(); i++)
+            found += equal(query.begin(), query.end(), names.begin() + static_cast<long>(i)) ? 1u : 0u;
+        return found;
+    };
+}
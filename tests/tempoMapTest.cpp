@@ -0,0 +1,247 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "TempoMap.h"
+#include "MidiStore.h"
+using namespace std;
+using Catch::Approx;
+
+
+TEST_CASE("tempo map constant", "tempomap")
+{
+    TempoMap map;
+    REQUIRE(map.isEmpty());
+    REQUIRE(map.ppqToSeconds(4.0) == 0.0);
+
+    // Blocks of a quarter note each at 120 bpm; only the first one changes anything
+    REQUIRE(map.recordTempo(0.0, 0.25, 120.0));
+    for (int i = 1; i < 100; i++)
+        REQUIRE_FALSE(map.recordTempo(i * 0.25, (i + 1) * 0.25, 120.0));
+    REQUIRE(map.getPoints().size() == 1);
+    REQUIRE(map.ppqToSeconds(4.0) == Approx(2.0));
+    REQUIRE(map.secondsToPpq(2.0) == Approx(4.0));
+    REQUIRE(map.getTempoAt(1000.0) == 120.0);
+}
+
+TEST_CASE("tempo map changes", "tempomap")
+{
+    TempoMap map;
+    // 8 quarter notes at 120 then 60 bpm from then on
+    for (int i = 0; i < 32; i++)
+        map.recordTempo(i * 0.25, (i + 1) * 0.25, 120.0);
+    for (int i = 32; i < 64; i++)
+        map.recordTempo(i * 0.25, (i + 1) * 0.25, 60.0);
+    REQUIRE(map.getPoints().size() == 2);
+    REQUIRE(map.ppqToSeconds(8.0) == Approx(4.0));
+    REQUIRE(map.ppqToSeconds(10.0) == Approx(6.0));
+    REQUIRE(map.secondsToPpq(6.0) == Approx(10.0));
+
+    // Go back and play the first two quarter notes at 60; everything after is known, so it shifts along
+    for (int i = 0; i < 8; i++)
+        map.recordTempo(i * 0.25, (i + 1) * 0.25, 60.0);
+    REQUIRE(map.getPoints().size() == 3);
+    REQUIRE(map.getTempoAt(1.0) == 60.0);
+    REQUIRE(map.getTempoAt(3.0) == 120.0);
+    REQUIRE(map.ppqToSeconds(2.0) == Approx(2.0));
+    REQUIRE(map.ppqToSeconds(8.0) == Approx(5.0));
+    REQUIRE(map.ppqToSeconds(10.0) == Approx(7.0));
+
+    // batch conversion matches the one at a time version, including out of order and missing values
+    vector<double> ppqs = {0.0, 1.0, 2.5, 7.9, 8.0, 12.0, 3.0, numeric_limits<double>::quiet_NaN(), 20.0};
+    vector<double> seconds;
+    map.ppqToSeconds(ppqs, seconds);
+    REQUIRE(seconds.size() == ppqs.size());
+    for (size_t i = 0; i < ppqs.size(); i++)
+    {
+        if (std::isnan(ppqs[i]))
+            REQUIRE(std::isnan(seconds[i]));
+        else
+            REQUIRE(seconds[i] == Approx(map.ppqToSeconds(ppqs[i])));
+    }
+}
+
+TEST_CASE("tempo map serialization", "tempomap")
+{
+    TempoMap map;
+    map.recordTempo(0.0, 1.0, 96.5);
+    map.recordTempo(16.125, 17.0, 140.0);
+    TempoMap restored;
+    REQUIRE(restored.fromString(map.toString()));
+    REQUIRE(restored.toString() == map.toString());
+    REQUIRE(restored.ppqToSeconds(20.0) == Approx(map.ppqToSeconds(20.0)));
+
+    // garbage is rejected and leaves the map alone
+    REQUIRE_FALSE(restored.fromString("1:120;nope"));
+    REQUIRE_FALSE(restored.fromString("1:-5"));
+    REQUIRE(restored.toString() == map.toString());
+}
+
+// The song has an intro at 120 that wasn't played; capture starts at beat 100, where the host says it is 50
+// seconds in and the tempo is 100
+TEST_CASE("tempo map capture starting mid-song", "tempomap")
+{
+    TempoMap map;
+    for (int i = 0; i < 20; i++)
+        map.recordTempo(100.0 + i * 0.5, 100.5 + i * 0.5, 100.0, 50.0 + i * 0.3);
+    REQUIRE(map.getPoints().size() == 1);
+    REQUIRE(map.ppqToSeconds(100.0) == Approx(50.0));
+    REQUIRE(map.ppqToSeconds(110.0) == Approx(56.0));
+    REQUIRE(map.secondsToPpq(56.0) == Approx(110.0));
+
+    // Now the intro gets played too. Nothing after it moves
+    for (int i = 0; i < 200; i++)
+        map.recordTempo(i * 0.5, 0.5 + i * 0.5, 120.0, i * 0.25);
+    REQUIRE(map.getPoints().size() == 2);
+    REQUIRE(map.ppqToSeconds(40.0) == Approx(20.0));
+    REQUIRE(map.ppqToSeconds(110.0) == Approx(56.0));
+
+    // The intro is changed to 60 in the DAW and played again; the rest of the song is 50 seconds later
+    for (int i = 0; i < 200; i++)
+        map.recordTempo(i * 0.5, 0.5 + i * 0.5, 60.0, i * 0.5);
+    REQUIRE(map.ppqToSeconds(100.0) == Approx(100.0));
+    REQUIRE(map.ppqToSeconds(110.0) == Approx(106.0));
+
+    // The anchors are saved too
+    TempoMap restored;
+    REQUIRE(restored.fromString(map.toString()));
+    REQUIRE(restored.toString() == map.toString());
+    REQUIRE(restored.ppqToSeconds(110.0) == Approx(106.0));
+    REQUIRE_FALSE(restored.fromString("0:120@"));
+    REQUIRE_FALSE(restored.fromString("0:120#5"));
+}
+
+// 4 bars of 4/4 at 120, then 3/4 at 60
+static TempoMap meterChangeMap()
+{
+    TempoMap map;
+    for (int i = 0; i < 64; i++)
+    {
+        double ppq = i * 0.5;
+        bool second = ppq >= 16.0;
+        map.recordTempo(ppq, ppq + 0.5, second ? 60.0 : 120.0);
+        map.recordMeter(second ? 16.0 + floor((ppq - 16.0) / 3.0) * 3.0 : floor(ppq / 4.0) * 4.0, second ? 3 : 4, 4);
+    }
+    return map;
+}
+
+TEST_CASE("tempo map bars", "tempomap")
+{
+    TempoMap map = meterChangeMap();
+    REQUIRE(map.getMeterPoints().size() == 2);
+    REQUIRE(map.getMeterPoints()[1].barNumber == 5);
+    REQUIRE_FALSE(map.recordMeter(19.0, 3, 4));
+
+    vector<pair<int, double>> bars;
+    vector<pair<int, double>> expected;
+    map.getBarsInWindow(1.0, 12.0, bars);
+    expected = {{2, 2.0}, {3, 4.0}, {4, 6.0}, {5, 8.0}, {6, 11.0}};
+    REQUIRE(bars == expected);
+
+    // a bar right at the start of the window is not included; one at the end isn't either
+    map.getBarsInWindow(8.0, 14.0, bars);
+    expected = {{6, 11.0}};
+    REQUIRE(bars == expected);
+
+    // before the start of the song, the first meter just keeps going
+    map.getBarsInWindow(-4.5, 1.0, bars);
+    expected = {{-1, -4.0}, {0, -2.0}, {1, 0.0}};
+    REQUIRE(bars == expected);
+
+    // no meter, no bars
+    TempoMap tempoOnly;
+    tempoOnly.recordTempo(0.0, 1.0, 120.0);
+    tempoOnly.getBarsInWindow(0.0, 10.0, bars);
+    REQUIRE(bars.empty());
+
+    TempoMap restored;
+    REQUIRE(restored.fromString(map.toString()));
+    REQUIRE(restored.toString() == map.toString());
+    REQUIRE(restored.getMeterPoints()[1].barNumber == 5);
+    // older saved state without meters still loads
+    REQUIRE(restored.fromString("0:120"));
+    REQUIRE_FALSE(restored.hasMeter());
+}
+
+// A tempo change after the notes were captured moves their seconds without recording them again
+TEST_CASE("store seconds from ppq", "tempomap")
+{
+    MidiStore ms;
+    ms.setQuantizationValue(1);
+    ms.setShortChordThreshold(0.0);
+
+    ms.recordTempo(0.0, 16.0, 120.0);
+    // C at beat 0, F at beat 4, G at beat 8. The stored seconds are deliberately wrong
+    ms.addNoteEventAtTime(100, 60, true);
+    ms.addNoteEventAtTime(100, 64, true);
+    ms.addNoteEventAtTime(100, 67, true);
+    ms.setEventTimeSeconds(100, 99.0);
+    ms.setEventTimePpq(100, 0.0);
+    ms.addNoteEventAtTime(200, 64, false);
+    ms.addNoteEventAtTime(200, 67, false);
+    ms.addNoteEventAtTime(200, 65, true);
+    ms.addNoteEventAtTime(200, 69, true);
+    ms.setEventTimeSeconds(200, 99.0);
+    ms.setEventTimePpq(200, 4.0);
+    ms.addNoteEventAtTime(300, 60, false);
+    ms.addNoteEventAtTime(300, 65, false);
+    ms.addNoteEventAtTime(300, 69, false);
+    ms.addNoteEventAtTime(300, 67, true);
+    ms.addNoteEventAtTime(300, 71, true);
+    ms.addNoteEventAtTime(300, 62, true);
+    ms.setEventTimeSeconds(300, 99.0);
+    ms.setEventTimePpq(300, 8.0);
+    REQUIRE(*ms.getEventTimeInPpq(200) == 4.0);
+    REQUIRE(ms.getEventTimeInPpq(150) == std::nullopt);
+
+    ms.updateStaticView();
+    auto chords = ms.getChordsInWindow({0.0f, 100.0f});
+    REQUIRE(chords.size() == 3);
+    REQUIRE(chords[1].first == Approx(2.0));
+    REQUIRE(chords[2].first == Approx(4.0));
+
+    // The song is now played at 60
+    ms.recordTempo(0.0, 16.0, 60.0);
+    ms.updateStaticView();
+    chords = ms.getChordsInWindow({0.0f, 100.0f});
+    REQUIRE(chords.size() == 3);
+    REQUIRE(chords[1].first == Approx(4.0));
+    REQUIRE(chords[2].first == Approx(8.0));
+
+    // The map goes along with the saved state, but it's only put there when the state is saved
+    REQUIRE_FALSE(ms.getState().hasProperty(MidiStore::tempoMapProp));
+    ms.saveTempoMapToState();
+    REQUIRE(ms.getState().hasProperty(MidiStore::tempoMapProp));
+    MidiStore restored;
+    REQUIRE(restored.replaceState(ms.getState()));
+    REQUIRE(restored.getTempoMap().toString() == ms.getTempoMap().toString());
+    ms.clear();
+    REQUIRE(ms.getTempoMap().isEmpty());
+}
+
+// Capture starts partway into the song; the chords stay where the host said they were
+TEST_CASE("store seconds when capture starts mid-song", "tempomap")
+{
+    MidiStore ms;
+    ms.setQuantizationValue(1);
+    ms.setShortChordThreshold(0.0);
+
+    ms.recordTempo(100.0, 116.0, 100.0, 50.0);
+    ms.addNoteEventAtTime(100, 60, true);
+    ms.addNoteEventAtTime(100, 64, true);
+    ms.addNoteEventAtTime(100, 67, true);
+    ms.setEventTimeSeconds(100, 50.0);
+    ms.setEventTimePpq(100, 100.0);
+    ms.addNoteEventAtTime(200, 60, false);
+    ms.addNoteEventAtTime(200, 64, false);
+    ms.addNoteEventAtTime(200, 67, false);
+    ms.addNoteEventAtTime(200, 65, true);
+    ms.addNoteEventAtTime(200, 69, true);
+    ms.addNoteEventAtTime(200, 72, true);
+    ms.setEventTimeSeconds(200, 52.4);
+    ms.setEventTimePpq(200, 104.0);
+
+    ms.updateStaticView();
+    auto chords = ms.getChordsInWindow({0.0f, 100.0f});
+    REQUIRE(chords.size() == 2);
+    REQUIRE(chords[0].first == Approx(50.0));
+    REQUIRE(chords[1].first == Approx(52.4));
+}
@@ -0,0 +1,109 @@
+#include <catch2/catch_test_macros.hpp>
+#include "WorkerPool.h"
+#include <algorithm>
+using namespace std;
+
+
+TEST_CASE("pool runs jobs", "workerpool")
+{
+    WorkerPool pool(3);
+    CancellationToken token;
+    atomic<int> count = 0;
+
+    // threads are not started until there is work
+    REQUIRE(pool.isStarted() == false);
+    for (int i = 0; i < 100; i++)
+        pool.addJob([&count] { count++; }, token);
+    REQUIRE(pool.isStarted() == true);
+    REQUIRE(pool.waitUntilIdle(5000));
+    REQUIRE(count == 100);
+}
+
+TEST_CASE("pool concurrency is bounded", "workerpool")
+{
+    WorkerPool pool(2);
+    CancellationToken token;
+    atomic<int> running = 0;
+    atomic<int> maxRunning = 0;
+
+    for (int i = 0; i < 20; i++)
+    {
+        pool.addJob([&]
+        {
+            int now = ++running;
+            int prevMax = maxRunning;
+            while (now > prevMax && !maxRunning.compare_exchange_weak(prevMax, now)) {}
+            Thread::sleep(2);
+            running--;
+        }, token);
+    }
+    REQUIRE(pool.waitUntilIdle(5000));
+    REQUIRE(maxRunning <= 2);
+}
+
+// Jobs added from inside a job go on the worker's own queue; the idle workers should steal them
+TEST_CASE("pool nested jobs", "workerpool")
+{
+    WorkerPool pool(4);
+    CancellationToken token;
+    atomic<int> count = 0;
+
+    pool.addJob([&]
+    {
+        for (int i = 0; i < 50; i++)
+            pool.addJob([&count] { Thread::sleep(1); count++; }, token);
+    }, token);
+    REQUIRE(pool.waitUntilIdle(5000));
+    REQUIRE(count == 50);
+}
+
+TEST_CASE("pool cancellation", "workerpool")
+{
+    WorkerPool pool(1);
+    CancellationToken slow;
+    CancellationToken other;
+    atomic<int> slowCount = 0;
+    atomic<int> otherCount = 0;
+    WaitableEvent started;
+
+    // Occupy the single worker so the rest stay queued
+    pool.addJob([&] { started.signal(); Thread::sleep(50); slowCount++; }, slow);
+    started.wait(5000);
+    for (int i = 0; i < 10; i++)
+    {
+        pool.addJob([&slowCount] { slowCount++; }, slow);
+        pool.addJob([&otherCount] { otherCount++; }, other);
+    }
+
+    // This waits for the running job and drops the queued ones for that token only
+    pool.cancelJobs(slow);
+    REQUIRE(slowCount == 1);
+    REQUIRE(slow.isCancelled());
+
+    // cancelled tokens don't accept new work
+    pool.addJob([&slowCount] { slowCount++; }, slow);
+    REQUIRE(pool.waitUntilIdle(5000));
+    REQUIRE(slowCount == 1);
+    REQUIRE(otherCount == 10);
+}
+
+TEST_CASE("shared pool lifetime", "workerpool")
+{
+    REQUIRE(WorkerPool::hasSharedPool() == false);
+    {
+        WorkerPool::Client first;
+        atomic<int> count = 0;
+        {
+            WorkerPool::Client second;
+            REQUIRE(&first.getPool() == &second.getPool());
+            second.addJob([&count] { count++; });
+            REQUIRE(second.getPool().waitUntilIdle(5000));
+        }
+        // still alive with one client
+        REQUIRE(WorkerPool::hasSharedPool() == true);
+        REQUIRE(count == 1);
+        REQUIRE(first.getPool().getNumThreads() == WorkerPool::getDefaultNumThreads());
+    }
+    // last one out shuts it down
+    REQUIRE(WorkerPool::hasSharedPool() == false);
+}